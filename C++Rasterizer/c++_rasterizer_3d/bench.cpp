@@ -0,0 +1,500 @@
+#include "rasterizer.h"
+#include "framebuffer.h"
+#include "sceneloader.h"
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QImage>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+// Command-line benchmark for the software rasterizer.
+//
+// The first part measures what it costs per pixel to get a frame's colors
+// into a QImage. "QImage" goes through QImage::fill, setPixel and pixel the
+// way the renderer used to: every sample of a supersampled image is written
+// with setPixel, and the downscale reads each one back with pixel. "FrameBuffer"
+// writes the same samples into raw aligned memory, resolves them with plain
+// loads and wraps the result in a QImage without copying it.
+//
+// The second part renders a fixed set of scenes, each with 1, 4 and 16
+// samples per pixel, and prints the rasterizer's per-stage timings and its
+// throughput. Every frame is then compared against a golden image so that
+// performance work cannot change the output unnoticed: a pixel fails when a
+// channel differs by more than --tolerance, and a frame fails when more than
+// --max-mismatch percent of its pixels do. The golden images live in
+// scenes/golden; run with --update-golden to write them again after an
+// intended change to the output. The exit code is 1 when any frame fails.
+
+namespace
+{
+const int FRAME_SIZE = 512;
+const int REPEATS = 20;
+const int MSAA_GRIDS[] = {1, 2, 4};
+
+QRgb SampleColor(int x, int y)
+{
+    return qRgb(x & 255, y & 255, (x ^ y) & 255);
+}
+
+// Nanoseconds per output pixel, best of REPEATS
+double QImagePath(int grid)
+{
+    double best = 1e30;
+    for(int repeat = 0; repeat < REPEATS; ++repeat)
+    {
+        QElapsedTimer timer;
+        timer.start();
+
+        int size = FRAME_SIZE * grid;
+        QImage samples(size, size, QImage::Format_RGB32);
+        samples.fill(qRgb(0, 0, 0));
+        for(int y = 0; y < size; ++y)
+        {
+            for(int x = 0; x < size; ++x)
+            {
+                samples.setPixel(x, y, SampleColor(x, y));
+            }
+        }
+
+        QImage result(FRAME_SIZE, FRAME_SIZE, QImage::Format_RGB32);
+        for(int y = 0; y < FRAME_SIZE; ++y)
+        {
+            for(int x = 0; x < FRAME_SIZE; ++x)
+            {
+                int red = 0, green = 0, blue = 0;
+                for(int dy = 0; dy < grid; ++dy)
+                {
+                    for(int dx = 0; dx < grid; ++dx)
+                    {
+                        QRgb color = samples.pixel(x * grid + dx, y * grid + dy);
+                        red += qRed(color);
+                        green += qGreen(color);
+                        blue += qBlue(color);
+                    }
+                }
+                int count = grid * grid;
+                result.setPixel(x, y, qRgb(red / count, green / count, blue / count));
+            }
+        }
+
+        best = std::min(best, static_cast<double>(timer.nsecsElapsed()));
+    }
+    return best / (FRAME_SIZE * FRAME_SIZE);
+}
+
+// Nanoseconds per output pixel, best of REPEATS
+double FrameBufferPath(int grid)
+{
+    FrameBuffer frameBuffer;
+    double best = 1e30;
+    for(int repeat = 0; repeat < REPEATS; ++repeat)
+    {
+        QElapsedTimer timer;
+        timer.start();
+
+        int samples = grid * grid;
+        frameBuffer.Resize(FRAME_SIZE, FRAME_SIZE, samples, false);
+        frameBuffer.ClearRect(0, FRAME_SIZE - 1, 0, FRAME_SIZE - 1, qRgb(0, 0, 0), 0.f, 0);
+        QRgb* sampleColors = frameBuffer.SampleColors();
+        for(int y = 0; y < FRAME_SIZE; ++y)
+        {
+            for(int x = 0; x < FRAME_SIZE; ++x)
+            {
+                QRgb* pixel = sampleColors + (x + y * FRAME_SIZE) * samples;
+                for(int dy = 0; dy < grid; ++dy)
+                {
+                    for(int dx = 0; dx < grid; ++dx)
+                    {
+                        pixel[dx + dy * grid] = SampleColor(x * grid + dx, y * grid + dy);
+                    }
+                }
+            }
+        }
+
+        if(samples > 1)
+        {
+            QRgb* colors = frameBuffer.Colors();
+            for(int i = 0; i < FRAME_SIZE * FRAME_SIZE; ++i)
+            {
+                int red = 0, green = 0, blue = 0;
+                for(int s = 0; s < samples; ++s)
+                {
+                    QRgb color = sampleColors[i * samples + s];
+                    red += qRed(color);
+                    green += qGreen(color);
+                    blue += qBlue(color);
+                }
+                colors[i] = qRgb(red / samples, green / samples, blue / samples);
+            }
+        }
+        QImage result = frameBuffer.TakeImage();
+
+        best = std::min(best, static_cast<double>(timer.nsecsElapsed()));
+    }
+    return best / (FRAME_SIZE * FRAME_SIZE);
+}
+
+// A 256x256 checkerboard of 32 texel squares
+std::shared_ptr<const QImage> MakeChecker(QRgb light, QRgb dark)
+{
+    std::shared_ptr<QImage> checker = std::make_shared<QImage>(256, 256, QImage::Format_RGB32);
+    for(int y = 0; y < checker->height(); ++y)
+    {
+        for(int x = 0; x < checker->width(); ++x)
+        {
+            checker->setPixel(x, y, ((x / 32 + y / 32) % 2) ? light : dark);
+        }
+    }
+    return checker;
+}
+
+// A camera-facing grid of textured quads, cells x cells of them
+Polygon MakeGrid(int cells)
+{
+    Polygon grid(QString("grid"));
+    for(int y = 0; y <= cells; ++y)
+    {
+        for(int x = 0; x <= cells; ++x)
+        {
+            glm::vec2 uv(float(x) / cells, float(y) / cells);
+            glm::vec4 position(uv.x * 8.f - 4.f, uv.y * 8.f - 4.f, 0.f, 1.f);
+            grid.AddVertex(Vertex(position, glm::vec3(255.f), glm::vec4(0.f, 0.f, 1.f, 0.f), uv));
+        }
+    }
+    for(int y = 0; y < cells; ++y)
+    {
+        for(int x = 0; x < cells; ++x)
+        {
+            unsigned int corner = x + y * (cells + 1);
+            Triangle lower = {{corner, corner + 1, corner + cells + 2}};
+            Triangle upper = {{corner, corner + cells + 2, corner + cells + 1}};
+            grid.AddTriangle(lower);
+            grid.AddTriangle(upper);
+        }
+    }
+
+    grid.SetTexture(MakeChecker(qRgb(230, 230, 230), qRgb(40, 90, 160)));
+    return grid;
+}
+
+// layers screen-filling quads, one behind the other and submitted back to
+// front, so every fragment of every layer passes the depth test
+Polygon MakeOverdrawStack(int layers)
+{
+    Polygon stack(QString("overdraw"));
+    for(int layer = 0; layer < layers; ++layer)
+    {
+        float z = -0.25f * (layers - 1 - layer);
+        float shift = 0.05f * layer;
+        unsigned int first = static_cast<unsigned int>(stack.m_verts.size());
+        for(int corner = 0; corner < 4; ++corner)
+        {
+            glm::vec2 position(corner & 1, corner >> 1);
+            glm::vec2 uv = position * 0.5f + glm::vec2(layer % 2, layer / 2 % 2) * 0.25f;
+            stack.AddVertex(Vertex(glm::vec4(position.x * 12.f - 6.f + shift, position.y * 12.f - 6.f - shift, z, 1.f),
+                                   glm::vec3(255.f), glm::vec4(0.f, 0.f, 1.f, 0.f), uv));
+        }
+        Triangle lower = {{first, first + 1, first + 3}};
+        Triangle upper = {{first, first + 3, first + 2}};
+        stack.AddTriangle(lower);
+        stack.AddTriangle(upper);
+    }
+    stack.SetTexture(MakeChecker(qRgb(240, 200, 60), qRgb(150, 40, 40)));
+    return stack;
+}
+
+// A fan of count triangles around the center of the screen. Near the rim each
+// one is a fraction of a pixel wide, so most of its blocks cover nothing.
+Polygon MakeSliverFan(int count)
+{
+    Polygon fan(QString("slivers"));
+    fan.AddVertex(Vertex(glm::vec4(0.f, 0.f, 0.f, 1.f), glm::vec3(255.f), glm::vec4(0.f, 0.f, 1.f, 0.f),
+                         glm::vec2(0.5f)));
+    for(int i = 0; i <= count; ++i)
+    {
+        float angle = 6.2831853f * i / count;
+        glm::vec2 direction(std::cos(angle), std::sin(angle));
+        fan.AddVertex(Vertex(glm::vec4(direction * 5.f, 0.f, 1.f), glm::vec3(255.f), glm::vec4(0.f, 0.f, 1.f, 0.f),
+                             glm::vec2(0.5f) + direction * 0.5f));
+    }
+    for(unsigned int i = 1; i <= static_cast<unsigned int>(count); ++i)
+    {
+        Triangle sliver = {{0, i, i + 1}};
+        fan.AddTriangle(sliver);
+    }
+    fan.SetTexture(MakeChecker(qRgb(90, 200, 120), qRgb(30, 30, 90)));
+    return fan;
+}
+
+// An OBJ of the scenes folder with its texture and, optionally, normal map
+Polygon LoadMesh(const QDir& scenes, TextureCache& textures, const QString& obj, const QString& texture,
+                 const QString& normalMap)
+{
+    Polygon mesh = LoadOBJ(scenes.filePath(obj), obj);
+    textures.Load({scenes.filePath(texture)});
+    mesh.SetTexture(textures.Share(scenes.filePath(texture)));
+    if(!normalMap.isEmpty())
+    {
+        textures.Load({scenes.filePath(normalMap)});
+        mesh.SetNormalMap(textures.Share(scenes.filePath(normalMap)));
+    }
+    return mesh;
+}
+
+// side x side copies of a textured cube spread over the ground. Seen from
+// one corner at eye height, most of them are off screen or hidden.
+std::vector<Polygon> MakeCrowd(const QDir& scenes, TextureCache& textures, int side)
+{
+    Polygon cube = LoadMesh(scenes, textures, "cube.obj", "tex_nor_maps/156.JPG", QString());
+    std::vector<Polygon> crowd;
+    for(int z = 0; z < side; ++z)
+    {
+        for(int x = 0; x < side; ++x)
+        {
+            Polygon copy(cube);
+            copy.m_verts.Translate(glm::vec3(1.5f * (x - side / 2), 0.f, -1.5f * z));
+            crowd.push_back(std::move(copy));
+        }
+    }
+    return crowd;
+}
+
+// side x side small point lights hovering just above the grid, in a cycle
+// of colors, each reaching only a few of the screen's tiles
+std::vector<Light> MakeLightField(int side)
+{
+    const glm::vec3 colors[] = {glm::vec3(0.9f, 0.2f, 0.1f), glm::vec3(0.1f, 0.8f, 0.2f),
+                                glm::vec3(0.2f, 0.3f, 1.f), glm::vec3(0.8f, 0.7f, 0.1f)};
+    std::vector<Light> lights;
+    for(int y = 0; y < side; ++y)
+    {
+        for(int x = 0; x < side; ++x)
+        {
+            glm::vec3 position(8.f * (x + 0.5f) / side - 4.f, 8.f * (y + 0.5f) / side - 4.f, 0.2f);
+            lights.push_back(Light::Point(position, colors[(x + y) % 4], 0.45f));
+        }
+    }
+    return lights;
+}
+
+// A few textured cubes standing on the grid, so the lights that cast
+// shadows have something to cast them from
+std::vector<Polygon> MakeShadowCasters(const QDir& scenes, TextureCache& textures)
+{
+    Polygon cube = LoadMesh(scenes, textures, "cube.obj", "tex_nor_maps/156.JPG", QString());
+    const glm::vec3 offsets[] = {glm::vec3(-1.5f, -1.f, 0.5f), glm::vec3(1.f, -0.5f, 0.5f),
+                                 glm::vec3(0.f, 1.5f, 1.5f), glm::vec3(-2.5f, 2.f, 0.5f)};
+    std::vector<Polygon> casters = {MakeGrid(128)};
+    for(const glm::vec3& offset : offsets)
+    {
+        Polygon copy(cube);
+        copy.m_verts.Translate(offset);
+        casters.push_back(std::move(copy));
+    }
+    return casters;
+}
+
+// A spot light with a single shadow map and a point light with a cube of them
+std::vector<Light> MakeShadowLights()
+{
+    Light spot = Light::Spot(glm::vec3(3.f, 2.f, 6.f), glm::vec3(-3.f, -2.f, -6.f), glm::vec3(40.f), 20.f, 30.f, 40.f);
+    Light point = Light::Point(glm::vec3(-1.f, 0.5f, 1.5f), glm::vec3(2.5f, 1.8f, 1.f), 5.f);
+    spot.castsShadows = true;
+    point.castsShadows = true;
+    return {spot, point};
+}
+
+struct BenchScene
+{
+    QString name;
+    std::vector<Polygon> polygons;
+    std::vector<Light> lights;
+    // Refit the scene before every frame, as if it moved, so nothing that
+    // depends on the geometry is reused from the frame before
+    bool dynamic = false;
+    glm::vec3 eye = glm::vec3(0.f, 0.f, 10.f);
+    glm::vec3 target = glm::vec3(0.f);
+};
+
+std::vector<BenchScene> MakeScenes(const QDir& scenes)
+{
+    // The textured cubes share one image
+    TextureCache textures;
+    std::vector<BenchScene> benchScenes(9);
+    benchScenes[0].name = "wahoo";
+    benchScenes[0].polygons.push_back(LoadMesh(scenes, textures, "wahoo.obj", "tex_nor_maps/wahoo.bmp", QString()));
+    benchScenes[1].name = "grid";
+    benchScenes[1].polygons.push_back(MakeGrid(128));
+    benchScenes[1].eye = glm::vec3(0.f, -6.f, 5.f);
+    benchScenes[2].name = "overdraw";
+    benchScenes[2].polygons.push_back(MakeOverdrawStack(32));
+    benchScenes[3].name = "slivers";
+    benchScenes[3].polygons.push_back(MakeSliverFan(4096));
+    benchScenes[4].name = "textured";
+    benchScenes[4].polygons.push_back(LoadMesh(scenes, textures, "cube.obj", "tex_nor_maps/156.JPG", QString()));
+    benchScenes[4].eye = glm::vec3(1.6f, 1.3f, 2.2f);
+    benchScenes[5].name = "normalmapped";
+    benchScenes[5].polygons.push_back(LoadMesh(scenes, textures, "dodecahedron.obj", "tex_nor_maps/154.JPG",
+                                               "tex_nor_maps/154_norm.JPG"));
+    benchScenes[5].eye = glm::vec3(-2.f, 1.5f, 3.f);
+    benchScenes[6].name = "crowd";
+    benchScenes[6].polygons = MakeCrowd(scenes, textures, 40);
+    benchScenes[6].eye = glm::vec3(-8.f, 0.f, 4.f);
+    benchScenes[6].target = glm::vec3(0.f, 0.f, -20.f);
+    benchScenes[7].name = "lights";
+    benchScenes[7].polygons.push_back(MakeGrid(128));
+    benchScenes[7].lights = MakeLightField(16);
+    benchScenes[7].eye = glm::vec3(0.f, -6.f, 5.f);
+    benchScenes[8].name = "shadows";
+    benchScenes[8].polygons = MakeShadowCasters(scenes, textures);
+    benchScenes[8].lights = MakeShadowLights();
+    benchScenes[8].dynamic = true;
+    benchScenes[8].eye = glm::vec3(0.f, -6.f, 5.f);
+    return benchScenes;
+}
+
+// The number of pixels of image whose channels differ from golden's by more
+// than tolerance; maxDifference is set to the largest difference found
+int CountMismatches(const QImage& image, const QImage& golden, int tolerance, int& maxDifference)
+{
+    maxDifference = 0;
+    int mismatches = 0;
+    for(int y = 0; y < image.height(); ++y)
+    {
+        const QRgb* row = reinterpret_cast<const QRgb*>(image.constScanLine(y));
+        const QRgb* goldenRow = reinterpret_cast<const QRgb*>(golden.constScanLine(y));
+        for(int x = 0; x < image.width(); ++x)
+        {
+            int difference = std::max({std::abs(qRed(row[x]) - qRed(goldenRow[x])),
+                                       std::abs(qGreen(row[x]) - qGreen(goldenRow[x])),
+                                       std::abs(qBlue(row[x]) - qBlue(goldenRow[x]))});
+            maxDifference = std::max(maxDifference, difference);
+            mismatches += difference > tolerance;
+        }
+    }
+    return mismatches;
+}
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("rasterizer_bench");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Times the rasterizer on fixed scenes and checks its output against golden images.");
+    parser.addHelpOption();
+    QCommandLineOption scenesOption("scenes", "The scenes folder.", "dir", RASTERIZER_SCENES);
+    QCommandLineOption goldenOption("golden", "Folder of golden images. Defaults to <scenes>/golden.", "dir");
+    QCommandLineOption updateOption("update-golden", "Replace the golden images with this build's output.");
+    QCommandLineOption toleranceOption("tolerance", "Largest accepted difference per channel.", "value", "8");
+    QCommandLineOption mismatchOption("max-mismatch", "Percentage of pixels allowed beyond the tolerance.", "percent", "0.5");
+    QCommandLineOption skipOption("skip-framebuffer", "Skip timing the QImage and FrameBuffer write paths.");
+    parser.addOptions({scenesOption, goldenOption, updateOption, toleranceOption, mismatchOption, skipOption});
+    parser.process(app);
+
+    QDir scenesDir(parser.value(scenesOption));
+    QDir goldenDir(parser.isSet(goldenOption) ? parser.value(goldenOption) : scenesDir.filePath("golden"));
+    bool update = parser.isSet(updateOption);
+    int tolerance = parser.value(toleranceOption).toInt();
+    double maxMismatch = parser.value(mismatchOption).toDouble();
+    if(update && !goldenDir.mkpath("."))
+    {
+        std::fprintf(stderr, "Could not create %s\n", qPrintable(goldenDir.path()));
+        return 1;
+    }
+
+    if(!parser.isSet(skipOption))
+    {
+        std::printf("Getting a 512x512 frame into a QImage, ns per pixel\n");
+        std::printf("%-8s %12s %12s\n", "samples", "QImage", "FrameBuffer");
+        for(int grid = 1; grid <= 4; grid *= 2)
+        {
+            std::printf("%-8d %12.2f %12.2f\n", grid * grid, QImagePath(grid), FrameBufferPath(grid));
+        }
+        std::printf("\n");
+    }
+
+    std::printf("Rendering each scene, best of %d frames, times in ms\n", REPEATS);
+    std::printf("%-13s %7s %9s %8s %8s %8s %8s %8s %8s %8s %8s %9s %9s  %s\n", "scene", "samples", "triangles",
+                "cull", "vertex", "shadow", "triangle", "raster", "shade", "resolve", "total", "Mtris/s", "Mpixels/s",
+                "golden");
+    int frames = 0, failures = 0;
+    std::vector<BenchScene> benchScenes = MakeScenes(scenesDir);
+    for(const BenchScene& scene : benchScenes)
+    {
+        Rasterizer rasterizer(scene.polygons);
+        rasterizer.lights = scene.lights;
+        rasterizer.GetCamera().LookAt(scene.eye, scene.target, glm::vec3(0.f, 1.f, 0.f));
+        for(int grid : MSAA_GRIDS)
+        {
+            rasterizer.scalingFactor = grid;
+            ++frames;
+            RenderStats best;
+            best.totalMs = 1e30;
+            QImage image;
+            for(int repeat = 0; repeat < REPEATS; ++repeat)
+            {
+                if(scene.dynamic)
+                {
+                    rasterizer.RefitBVH();
+                }
+                image = rasterizer.RenderScene();
+                if(rasterizer.GetRenderStats().totalMs < best.totalMs)
+                {
+                    best = rasterizer.GetRenderStats();
+                }
+            }
+
+            QString goldenFile = goldenDir.filePath(QString("%1_%2x.png").arg(scene.name).arg(grid * grid));
+            QString golden;
+            if(update)
+            {
+                golden = image.save(goldenFile) ? "updated" : "write failed";
+                failures += golden != "updated";
+            }
+            else
+            {
+                QImage expected(goldenFile);
+                if(expected.isNull())
+                {
+                    golden = "missing";
+                    ++failures;
+                }
+                else if(expected.size() != image.size())
+                {
+                    golden = "FAILED, size differs";
+                    ++failures;
+                }
+                else
+                {
+                    int maxDifference;
+                    int mismatches = CountMismatches(image, expected.convertToFormat(QImage::Format_RGB32),
+                                                     tolerance, maxDifference);
+                    bool passed = mismatches * 100.0 <= maxMismatch * image.width() * image.height();
+                    golden = QString("%1, %2 pixels off, by %3 at most").arg(passed ? "ok" : "FAILED")
+                                                                       .arg(mismatches).arg(maxDifference);
+                    failures += !passed;
+                }
+            }
+
+            double seconds = best.totalMs * 1e-3;
+            std::printf("%-13s %7d %9d %8.2f %8.2f %8.2f %8.2f %8.2f %8.2f %8.2f %8.2f %9.2f %9.2f  %s\n",
+                        qPrintable(scene.name), grid * grid, best.triangles, best.cullMs, best.vertexMs,
+                        best.shadowMs, best.triangleMs, best.rasterMs, best.shadeMs, best.resolveMs, best.totalMs,
+                        best.triangles / seconds * 1e-6, best.pixels / seconds * 1e-6, qPrintable(golden));
+        }
+    }
+
+    if(failures > 0)
+    {
+        std::printf("\n%d of %d frames %s\n", failures, frames,
+                    update ? "could not be written" : "do not match their golden image");
+        return 1;
+    }
+    return 0;
+}
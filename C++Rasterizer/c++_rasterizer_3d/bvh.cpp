@@ -0,0 +1,196 @@
+#include "bvh.h"
+#include <algorithm>
+#include <limits>
+
+Bounds::Bounds()
+    : min(std::numeric_limits<float>::max()),
+      max(-std::numeric_limits<float>::max())
+{}
+
+void Bounds::Grow(const glm::vec3& point)
+{
+    min = glm::min(min, point);
+    max = glm::max(max, point);
+}
+
+void Bounds::Grow(const Bounds& other)
+{
+    min = glm::min(min, other.min);
+    max = glm::max(max, other.max);
+}
+
+glm::vec3 Bounds::Center() const
+{
+    return 0.5f * (min + max);
+}
+
+namespace
+{
+// The axis along which a set of points is spread the widest
+int LongestAxis(const Bounds& bounds)
+{
+    glm::vec3 extent = bounds.max - bounds.min;
+    if(extent.x >= extent.y && extent.x >= extent.z)
+    {
+        return 0;
+    }
+    return extent.y >= extent.z ? 1 : 2;
+}
+
+Bounds TriangleBounds(const Polygon& polygon, uint32_t triangle)
+{
+    Bounds bounds;
+    for(int v = 0; v < 3; ++v)
+    {
+        bounds.Grow(polygon.m_verts.Position(polygon.m_tris[triangle].m_indices[v]));
+    }
+    return bounds;
+}
+}
+
+void SceneBVH::Build(const std::vector<Polygon>& polygons)
+{
+    m_clusters.clear();
+    m_clusterTriangles.clear();
+    m_nodes.clear();
+
+    std::vector<glm::vec3> centroids;
+    for(size_t p = 0; p < polygons.size(); ++p)
+    {
+        const Polygon& polygon = polygons[p];
+        size_t begin = m_clusterTriangles.size();
+        centroids.resize(polygon.m_tris.size());
+        for(uint32_t t = 0; t < polygon.m_tris.size(); ++t)
+        {
+            m_clusterTriangles.push_back(t);
+            centroids[t] = TriangleBounds(polygon, t).Center();
+        }
+        SplitPolygon(polygons, static_cast<uint32_t>(p), centroids, begin, m_clusterTriangles.size());
+    }
+
+    std::vector<uint32_t> clusters(m_clusters.size());
+    for(uint32_t c = 0; c < clusters.size(); ++c)
+    {
+        clusters[c] = c;
+    }
+    if(!clusters.empty())
+    {
+        m_nodes.reserve(2 * clusters.size() - 1);
+        BuildNodes(clusters, 0, clusters.size());
+    }
+}
+
+// Halves the triangles in [begin, end) of m_clusterTriangles at the median
+// of their centroids along the longest axis until every part fits in a cluster
+void SceneBVH::SplitPolygon(const std::vector<Polygon>& polygons, uint32_t polygon,
+                            const std::vector<glm::vec3>& centroids, size_t begin, size_t end)
+{
+    if(begin == end)
+    {
+        return;
+    }
+    if(end - begin <= static_cast<size_t>(CLUSTER_SIZE))
+    {
+        // Keep the polygon's own order inside the cluster
+        std::sort(m_clusterTriangles.begin() + begin, m_clusterTriangles.begin() + end);
+        TriangleCluster cluster;
+        cluster.polygon = polygon;
+        cluster.firstTriangle = static_cast<uint32_t>(begin);
+        cluster.triangleCount = static_cast<uint32_t>(end - begin);
+        for(size_t i = begin; i < end; ++i)
+        {
+            cluster.bounds.Grow(TriangleBounds(polygons[polygon], m_clusterTriangles[i]));
+        }
+        m_clusters.push_back(cluster);
+        return;
+    }
+
+    Bounds centroidBounds;
+    for(size_t i = begin; i < end; ++i)
+    {
+        centroidBounds.Grow(centroids[m_clusterTriangles[i]]);
+    }
+    int axis = LongestAxis(centroidBounds);
+    size_t middle = begin + (end - begin) / 2;
+    std::nth_element(m_clusterTriangles.begin() + begin, m_clusterTriangles.begin() + middle,
+                     m_clusterTriangles.begin() + end, [&](uint32_t a, uint32_t b) {
+        return centroids[a][axis] < centroids[b][axis];
+    });
+    SplitPolygon(polygons, polygon, centroids, begin, middle);
+    SplitPolygon(polygons, polygon, centroids, middle, end);
+}
+
+// Appends the subtree over clusters[begin, end) to m_nodes, splitting at
+// the median of the clusters' centers along the longest axis
+void SceneBVH::BuildNodes(std::vector<uint32_t>& clusters, size_t begin, size_t end)
+{
+    uint32_t index = static_cast<uint32_t>(m_nodes.size());
+    m_nodes.push_back(Node());
+    Node node;
+    node.cluster = -1;
+    node.secondChild = 0;
+
+    if(end - begin == 1)
+    {
+        node.cluster = static_cast<int32_t>(clusters[begin]);
+        node.bounds = m_clusters[clusters[begin]].bounds;
+    }
+    else
+    {
+        Bounds centerBounds;
+        for(size_t i = begin; i < end; ++i)
+        {
+            centerBounds.Grow(m_clusters[clusters[i]].bounds.Center());
+        }
+        int axis = LongestAxis(centerBounds);
+        size_t middle = begin + (end - begin) / 2;
+        std::nth_element(clusters.begin() + begin, clusters.begin() + middle, clusters.begin() + end,
+                         [&](uint32_t a, uint32_t b) {
+            return m_clusters[a].bounds.Center()[axis] < m_clusters[b].bounds.Center()[axis];
+        });
+        BuildNodes(clusters, begin, middle);
+        node.secondChild = static_cast<uint32_t>(m_nodes.size());
+        BuildNodes(clusters, middle, end);
+        node.bounds = m_nodes[index + 1].bounds;
+        node.bounds.Grow(m_nodes[node.secondChild].bounds);
+    }
+    node.subtreeEnd = static_cast<uint32_t>(m_nodes.size());
+    m_nodes[index] = node;
+}
+
+void SceneBVH::Refit(const std::vector<Polygon>& polygons)
+{
+    for(TriangleCluster& cluster : m_clusters)
+    {
+        cluster.bounds = Bounds();
+        for(uint32_t i = 0; i < cluster.triangleCount; ++i)
+        {
+            cluster.bounds.Grow(TriangleBounds(polygons[cluster.polygon],
+                                               m_clusterTriangles[cluster.firstTriangle + i]));
+        }
+    }
+    // Children always come after their parent
+    for(size_t i = m_nodes.size(); i-- > 0;)
+    {
+        Node& node = m_nodes[i];
+        if(node.cluster >= 0)
+        {
+            node.bounds = m_clusters[node.cluster].bounds;
+        }
+        else
+        {
+            node.bounds = m_nodes[i + 1].bounds;
+            node.bounds.Grow(m_nodes[node.secondChild].bounds);
+        }
+    }
+}
+
+const std::vector<TriangleCluster>& SceneBVH::Clusters() const
+{
+    return m_clusters;
+}
+
+const std::vector<uint32_t>& SceneBVH::ClusterTriangles() const
+{
+    return m_clusterTriangles;
+}
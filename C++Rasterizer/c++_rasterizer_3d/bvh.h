@@ -0,0 +1,117 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+#include "polygon.h"
+
+// An axis-aligned box in world space. A default constructed box is empty.
+struct Bounds
+{
+    glm::vec3 min;
+    glm::vec3 max;
+
+    Bounds();
+    void Grow(const glm::vec3& point);
+    void Grow(const Bounds& other);
+    glm::vec3 Center() const;
+};
+
+// Up to SceneBVH::CLUSTER_SIZE spatially close triangles of one polygon.
+// Clusters are what the rasterizer culls: a small polygon is a single
+// cluster, while a large mesh is split into many, so the parts of it that
+// are off screen or hidden can be skipped on their own.
+struct TriangleCluster
+{
+    uint32_t polygon;
+    uint32_t firstTriangle; // Into SceneBVH::ClusterTriangles()
+    uint32_t triangleCount;
+    Bounds bounds;
+};
+
+// A bounding volume hierarchy over the triangle clusters of a scene, built
+// once when the scene is loaded. Traversal accepts or rejects whole subtrees
+// at once, so culling costs time in proportion to the visible part of the
+// scene rather than to its size.
+class SceneBVH
+{
+public:
+    static const int CLUSTER_SIZE = 64;
+
+    // Splits every polygon into clusters and builds the hierarchy over them
+    void Build(const std::vector<Polygon>& polygons);
+
+    // Recomputes every box after vertices moved. The clusters keep their
+    // triangles, so adding or removing triangles requires Build instead.
+    void Refit(const std::vector<Polygon>& polygons);
+
+    // Clusters are ordered by polygon, so drawing them in order keeps the
+    // scene's submission order between polygons
+    const std::vector<TriangleCluster>& Clusters() const;
+
+    // The triangles of every cluster, as indices into its polygon's m_tris.
+    // Within a cluster they keep their order in the polygon.
+    const std::vector<uint32_t>& ClusterTriangles() const;
+
+    // Calls visit(cluster index) for every cluster that classify does not
+    // reject. classify takes a Bounds and answers like ClassifyBlock: -1
+    // rejects the box and everything in it, 1 accepts everything in it
+    // without looking further, and 0 descends into its children.
+    template <typename Classify, typename Visit>
+    void Traverse(const Classify& classify, const Visit& visit) const;
+
+private:
+    // Nodes are stored depth first: an inner node's first child follows it
+    // directly, and its whole subtree ends right before subtreeEnd
+    struct Node
+    {
+        Bounds bounds;
+        uint32_t secondChild;
+        uint32_t subtreeEnd;
+        int32_t cluster; // -1 for inner nodes
+    };
+
+    void SplitPolygon(const std::vector<Polygon>& polygons, uint32_t polygon,
+                      const std::vector<glm::vec3>& centroids, size_t begin, size_t end);
+    void BuildNodes(std::vector<uint32_t>& clusters, size_t begin, size_t end);
+
+    std::vector<TriangleCluster> m_clusters;
+    std::vector<uint32_t> m_clusterTriangles;
+    std::vector<Node> m_nodes;
+};
+
+template <typename Classify, typename Visit>
+void SceneBVH::Traverse(const Classify& classify, const Visit& visit) const
+{
+    if(m_nodes.empty())
+    {
+        return;
+    }
+    // Median splits keep the tree balanced, so its depth is about log2 of
+    // the cluster count
+    uint32_t stack[64];
+    int depth = 0;
+    stack[depth++] = 0;
+    while(depth > 0)
+    {
+        uint32_t index = stack[--depth];
+        const Node& node = m_nodes[index];
+        int result = classify(node.bounds);
+        if(result < 0)
+        {
+            continue;
+        }
+        if(result > 0 || node.cluster >= 0)
+        {
+            for(uint32_t inside = index; inside < node.subtreeEnd; ++inside)
+            {
+                if(m_nodes[inside].cluster >= 0)
+                {
+                    visit(static_cast<uint32_t>(m_nodes[inside].cluster));
+                }
+            }
+            continue;
+        }
+        stack[depth++] = node.secondChild;
+        stack[depth++] = index + 1;
+    }
+}
@@ -71,3 +71,13 @@ void Camera::RotateAboutForward(float degrees) {
     up = rotation * up;
     right = rotation * right;
 }
+
+void Camera::LookAt(const glm::vec3& eye, const glm::vec3& target, const glm::vec3& worldUp) {
+    glm::vec3 F = glm::normalize(target - eye);
+    glm::vec3 R = glm::normalize(glm::cross(F, worldUp));
+    glm::vec3 U = glm::cross(R, F);
+    forward = glm::vec4(F, 0.0f);
+    right = glm::vec4(R, 0.0f);
+    up = glm::vec4(U, 0.0f);
+    position = glm::vec4(eye, 1.0f);
+}
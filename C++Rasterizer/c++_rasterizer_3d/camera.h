@@ -18,10 +18,16 @@ public:
     void RotateAboutUp(float degrees);
     void RotateAboutForward(float degrees);
 
+    // Places the camera at eye, looking at target. worldUp picks the roll and
+    // must not be parallel to the viewing direction.
+    void LookAt(const glm::vec3& eye, const glm::vec3& target, const glm::vec3& worldUp);
+
     glm::vec3 GetForward() { return { forward.x, forward.y, forward.z }; }
 
     glm::vec3 GetPosition() { return { position.x, position.y, position.z }; }
 
+    float GetNearClip() const { return nearClip; }
+
 private:
     glm::vec4 forward;
     glm::vec4 right;
@@ -0,0 +1,250 @@
+#include "rasterizer.h"
+#include "sceneloader.h"
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QThreadPool>
+#include <algorithm>
+#include <cstdio>
+
+// Headless batch renderer: loads a scene, moves the camera along a path and
+// writes every frame to disk. It only needs QtCore and QtGui's image code,
+// so it runs on machines without a display.
+//
+// A camera path is a JSON file with a "keyframes" array. Each keyframe has
+// an "eye" and a "target" position and optionally an "up" vector:
+//
+//     { "keyframes": [ { "eye": [0, 0, 10], "target": [0, 0, 0], "up": [0, 1, 0] }, ... ] }
+//
+// The requested number of frames is spread evenly over the path, blending
+// linearly between neighbouring keyframes.
+
+namespace
+{
+struct CameraKey
+{
+    glm::vec3 eye;
+    glm::vec3 target;
+    glm::vec3 up;
+};
+
+glm::vec3 ReadVec3(const QJsonValue& value, const glm::vec3& fallback)
+{
+    QJsonArray array = value.toArray();
+    if(array.size() != 3)
+    {
+        return fallback;
+    }
+    return glm::vec3(array[0].toDouble(), array[1].toDouble(), array[2].toDouble());
+}
+
+bool LoadCameraPath(const QString& filename, std::vector<CameraKey>& keys, QString& error)
+{
+    QFile file(filename);
+    if(!file.open(QIODevice::ReadOnly))
+    {
+        error = QString("Could not open the camera path %1.").arg(filename);
+        return false;
+    }
+    QJsonParseError parseError;
+    QJsonDocument jdoc(QJsonDocument::fromJson(file.readAll(), &parseError));
+    if(jdoc.isNull())
+    {
+        error = QString("%1: %2").arg(filename, parseError.errorString());
+        return false;
+    }
+
+    QJsonArray keyframes = jdoc.object()["keyframes"].toArray();
+    for(int i = 0; i < keyframes.size(); i++)
+    {
+        QJsonObject keyframe = keyframes[i].toObject();
+        CameraKey key;
+        key.eye = ReadVec3(keyframe["eye"], glm::vec3(0.f, 0.f, 10.f));
+        key.target = ReadVec3(keyframe["target"], glm::vec3(0.f));
+        key.up = ReadVec3(keyframe["up"], glm::vec3(0.f, 1.f, 0.f));
+        keys.push_back(key);
+    }
+    if(keys.empty())
+    {
+        error = QString("%1 has no keyframes.").arg(filename);
+        return false;
+    }
+    return true;
+}
+
+// The camera of frame `frame` out of `frames`, spread evenly over the path
+CameraKey CameraAt(const std::vector<CameraKey>& keys, int frame, int frames)
+{
+    if(keys.size() == 1 || frames <= 1)
+    {
+        return keys[0];
+    }
+    float t = static_cast<float>(frame) / (frames - 1) * (keys.size() - 1);
+    int first = std::min(static_cast<int>(t), static_cast<int>(keys.size()) - 2);
+    float blend = t - first;
+    const CameraKey& a = keys[first];
+    const CameraKey& b = keys[first + 1];
+    CameraKey key;
+    key.eye = glm::mix(a.eye, b.eye, blend);
+    key.target = glm::mix(a.target, b.target, blend);
+    key.up = glm::normalize(glm::mix(a.up, b.up, blend));
+    return key;
+}
+
+// Raw frames are the pixels exactly as they sit in memory: width * height
+// 32-bit 0xffRRGGBB values, row by row, with no header
+bool WriteRaw(const QImage& image, const QString& filename)
+{
+    QFile file(filename);
+    if(!file.open(QIODevice::WriteOnly))
+    {
+        return false;
+    }
+    int rowBytes = image.width() * 4;
+    for(int y = 0; y < image.height(); ++y)
+    {
+        if(file.write(reinterpret_cast<const char*>(image.constScanLine(y)), rowBytes) != rowBytes)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool ParseChoice(const QString& value, const QStringList& choices, int& index)
+{
+    index = choices.indexOf(value.toLower());
+    return index >= 0;
+}
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("rasterizer_cli");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Renders a scene along a camera path without a display.");
+    parser.addHelpOption();
+    parser.addPositionalArgument("scene", "The JSON scene file to render.");
+    QCommandLineOption cameraOption({"c", "camera"}, "JSON camera path. Without one the default camera is used.", "file");
+    QCommandLineOption framesOption({"n", "frames"}, "Number of frames to render. Defaults to one per keyframe.", "count");
+    QCommandLineOption outputOption({"o", "output"}, "Output file prefix; frames are named <prefix>_0000.<format>.", "prefix", "frame");
+    QCommandLineOption formatOption({"f", "format"}, "png, bmp, raw or none.", "format", "png");
+    QCommandLineOption msaaOption("msaa", "Samples per pixel along each axis, 1 to 4.", "grid", "1");
+    QCommandLineOption pathOption("render-path", "forward, prepass or visibility.", "path", "forward");
+    QCommandLineOption filterOption("filter", "Texture filter: nearest, bilinear or trilinear.", "filter", "trilinear");
+    QCommandLineOption shadingOption("shading", "phong or blinnphong.", "model", "blinnphong");
+    QCommandLineOption cullOption("cull", "Cull back faces. Only correct for closed meshes.");
+    QCommandLineOption noOcclusionOption("no-occlusion", "Draw clusters even when the depth buffer hides them.");
+    QCommandLineOption threadsOption({"j", "threads"}, "Worker threads. Defaults to every core.", "count");
+    parser.addOptions({cameraOption, framesOption, outputOption, formatOption, msaaOption,
+                       pathOption, filterOption, shadingOption, cullOption, noOcclusionOption, threadsOption});
+    parser.process(app);
+
+    if(parser.positionalArguments().size() != 1)
+    {
+        parser.showHelp(1);
+    }
+
+    int renderPath, textureFilter, shading, format;
+    if(!ParseChoice(parser.value(pathOption), {"forward", "prepass", "visibility"}, renderPath)
+       || !ParseChoice(parser.value(filterOption), {"nearest", "bilinear", "trilinear"}, textureFilter)
+       || !ParseChoice(parser.value(shadingOption), {"phong", "blinnphong"}, shading)
+       || !ParseChoice(parser.value(formatOption), {"png", "bmp", "raw", "none"}, format))
+    {
+        std::fprintf(stderr, "Unknown --render-path, --filter, --shading or --format value.\n");
+        return 1;
+    }
+    if(parser.isSet(threadsOption))
+    {
+        // The thread calling ParallelFor works alongside the pool
+        QThreadPool::globalInstance()->setMaxThreadCount(std::max(parser.value(threadsOption).toInt() - 1, 0));
+    }
+
+    std::vector<Polygon> polygons;
+    std::vector<Light> lights;
+    QString error;
+    if(!LoadScene(parser.positionalArguments()[0], polygons, &error, nullptr, &lights))
+    {
+        std::fprintf(stderr, "%s\n", qPrintable(error));
+        return 1;
+    }
+
+    std::vector<CameraKey> keys;
+    if(parser.isSet(cameraOption))
+    {
+        if(!LoadCameraPath(parser.value(cameraOption), keys, error))
+        {
+            std::fprintf(stderr, "%s\n", qPrintable(error));
+            return 1;
+        }
+    }
+    int frames = parser.isSet(framesOption) ? parser.value(framesOption).toInt()
+                                            : std::max(static_cast<int>(keys.size()), 1);
+
+    Rasterizer rasterizer(std::move(polygons));
+    rasterizer.lights = std::move(lights);
+    rasterizer.scalingFactor = parser.value(msaaOption).toInt();
+    rasterizer.setRenderPath(static_cast<RenderPath>(renderPath));
+    rasterizer.setTextureFilter(static_cast<TextureFilter>(textureFilter));
+    rasterizer.setShadingModel(static_cast<ShadingModel>(shading));
+    rasterizer.backfaceCulling = parser.isSet(cullOption);
+    rasterizer.occlusionCulling = !parser.isSet(noOcclusionOption);
+
+    // Frames are written by a thread of their own while the next one renders
+    QThreadPool writer;
+    writer.setMaxThreadCount(1);
+    const char* extensions[] = {"png", "bmp", "raw"};
+    bool writeFailed = false;
+
+    std::printf("frame     total      cull    vertex  triangle    raster     shade   resolve  triangles  clusters\n");
+    double totalMs = 0, slowestMs = 0;
+    QElapsedTimer wallClock;
+    wallClock.start();
+    for(int frame = 0; frame < frames; ++frame)
+    {
+        if(!keys.empty())
+        {
+            CameraKey key = CameraAt(keys, frame, frames);
+            rasterizer.GetCamera().LookAt(key.eye, key.target, key.up);
+        }
+
+        QImage image = rasterizer.RenderScene();
+        const RenderStats& stats = rasterizer.GetRenderStats();
+        std::printf("%5d %9.2f %9.2f %9.2f %9.2f %9.2f %9.2f %9.2f %10d %9d\n", frame, stats.totalMs, stats.cullMs,
+                    stats.vertexMs, stats.triangleMs, stats.rasterMs, stats.shadeMs, stats.resolveMs, stats.setups,
+                    stats.clusters);
+        totalMs += stats.totalMs;
+        slowestMs = std::max(slowestMs, stats.totalMs);
+
+        if(format < 3)
+        {
+            QString filename = QString("%1_%2.%3").arg(parser.value(outputOption))
+                                                  .arg(frame, 4, 10, QChar('0'))
+                                                  .arg(extensions[format]);
+            bool raw = format == 2;
+            writer.start([image, filename, raw, &writeFailed]() {
+                bool written = raw ? WriteRaw(image, filename) : image.save(filename);
+                if(!written)
+                {
+                    std::fprintf(stderr, "Could not write %s\n", qPrintable(filename));
+                    writeFailed = true;
+                }
+            });
+        }
+    }
+    writer.waitForDone();
+
+    if(frames > 0)
+    {
+        std::printf("%d frames in %.1f ms: %.2f ms per frame on average, %.2f ms at most, %.1f frames/s\n",
+                    frames, wallClock.nsecsElapsed() * 1e-6, totalMs / frames, slowestMs,
+                    frames * 1000.0 / std::max(totalMs, 1e-3));
+    }
+    return writeFailed ? 1 : 0;
+}
@@ -0,0 +1,100 @@
+#include "clipper.h"
+#include <utility>
+
+unsigned char FrustumOutcode(const glm::vec3& pos, float nearW)
+{
+    unsigned char code = 0;
+    if(pos.z < nearW)  code |= CLIP_NEAR;
+    if(pos.x < -pos.z) code |= CLIP_LEFT;
+    if(pos.x > pos.z)  code |= CLIP_RIGHT;
+    if(pos.y < -pos.z) code |= CLIP_BOTTOM;
+    if(pos.y > pos.z)  code |= CLIP_TOP;
+    return code;
+}
+
+unsigned char GuardBandOutcode(const glm::vec3& pos, float nearW, float guardBand)
+{
+    float limit = guardBand * pos.z;
+    unsigned char code = 0;
+    if(pos.z < nearW)  code |= CLIP_NEAR;
+    if(pos.x < -limit) code |= CLIP_LEFT;
+    if(pos.x > limit)  code |= CLIP_RIGHT;
+    if(pos.y < -limit) code |= CLIP_BOTTOM;
+    if(pos.y > limit)  code |= CLIP_TOP;
+    return code;
+}
+
+namespace {
+// Signed distance to a clip plane; the visible side is positive
+float PlaneDistance(ClipPlane plane, const glm::vec3& pos, float nearW, float guardBand)
+{
+    switch(plane)
+    {
+    case CLIP_NEAR:   return pos.z - nearW;
+    case CLIP_LEFT:   return guardBand * pos.z + pos.x;
+    case CLIP_RIGHT:  return guardBand * pos.z - pos.x;
+    case CLIP_BOTTOM: return guardBand * pos.z + pos.y;
+    case CLIP_TOP:    return guardBand * pos.z - pos.y;
+    }
+    return 0.f;
+}
+}
+
+int ClipTriangle(const ClipVertex in[3], unsigned char planeMask, float nearW, float guardBand,
+                 ClipVertex out[MAX_CLIPPED_VERTICES])
+{
+    // Each plane can add at most one vertex, so two buffers of the final size suffice
+    ClipVertex buffer[MAX_CLIPPED_VERTICES];
+    ClipVertex* src = buffer;
+    ClipVertex* dst = out;
+    int count = 3;
+    for(int i = 0; i < 3; ++i)
+    {
+        src[i] = in[i];
+    }
+
+    const ClipPlane planes[] = {CLIP_NEAR, CLIP_LEFT, CLIP_RIGHT, CLIP_BOTTOM, CLIP_TOP};
+    for(ClipPlane plane : planes)
+    {
+        if(!(planeMask & plane))
+        {
+            continue;
+        }
+
+        int kept = 0;
+        for(int i = 0; i < count; ++i)
+        {
+            const ClipVertex& a = src[i];
+            const ClipVertex& b = src[(i + 1) % count];
+            float da = PlaneDistance(plane, a.pos, nearW, guardBand);
+            float db = PlaneDistance(plane, b.pos, nearW, guardBand);
+            if(da >= 0)
+            {
+                dst[kept++] = a;
+            }
+            if((da >= 0) != (db >= 0))
+            {
+                float t = da / (da - db);
+                dst[kept].pos = glm::mix(a.pos, b.pos, t);
+                dst[kept].bary = glm::mix(a.bary, b.bary, t);
+                ++kept;
+            }
+        }
+
+        count = kept;
+        if(count == 0)
+        {
+            return 0;
+        }
+        std::swap(src, dst);
+    }
+
+    if(src != out)
+    {
+        for(int i = 0; i < count; ++i)
+        {
+            out[i] = src[i];
+        }
+    }
+    return count;
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include <glm/glm.hpp>
+
+// A vertex in homogeneous clip space. Only x, y and w are kept: the rasterizer
+// interpolates the view depth, which is what w holds. bary locates the vertex
+// inside the triangle it was clipped from, so the attributes of vertices
+// created by clipping can be reconstructed from the original three.
+struct ClipVertex
+{
+    glm::vec3 pos; // (x, y, w)
+    glm::vec3 bary;
+};
+
+// Outcode bits, one per clip plane a vertex can be outside of
+enum ClipPlane : unsigned char
+{
+    CLIP_NEAR   = 1 << 0,
+    CLIP_LEFT   = 1 << 1,
+    CLIP_RIGHT  = 1 << 2,
+    CLIP_BOTTOM = 1 << 3,
+    CLIP_TOP    = 1 << 4
+};
+
+// A triangle clipped against the near plane and the four guard band planes
+// has at most this many vertices
+const int MAX_CLIPPED_VERTICES = 8;
+
+// Which of the view frustum's planes the vertex lies outside of. A triangle
+// whose three vertices share a bit cannot be seen.
+unsigned char FrustumOutcode(const glm::vec3& pos, float nearW);
+
+// Which planes the rasterizer cannot handle the vertex beyond: the near plane
+// (where w approaches zero) and the guard band, a region guardBand times as
+// wide as the screen in normalized device coordinates. Triangles that only
+// cross the screen edges inside the guard band are not clipped at all; their
+// bounding boxes are simply clamped to the screen.
+unsigned char GuardBandOutcode(const glm::vec3& pos, float nearW, float guardBand);
+
+// Clips a triangle against the planes in planeMask using Sutherland-Hodgman
+// in homogeneous space. Writes the resulting convex polygon to out and
+// returns its vertex count, which is 0 when nothing is left.
+int ClipTriangle(const ClipVertex in[3], unsigned char planeMask, float nearW, float guardBand,
+                 ClipVertex out[MAX_CLIPPED_VERTICES]);
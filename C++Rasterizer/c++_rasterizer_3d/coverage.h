@@ -0,0 +1,84 @@
+#pragma once
+#include <glm/glm.hpp>
+#include "simd.h"
+
+// The rasterizer works on 8x8 pixel blocks: a whole block is rejected when
+// one of the triangle's edge functions is negative at all four of its
+// corners, and the surviving rows are tested eight pixels at a time.
+const int COVERAGE_BLOCK_SIZE = 8;
+
+// Index of the lowest set bit of a non-zero coverage mask
+inline int CountTrailingZeros(unsigned int mask)
+{
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return static_cast<int>(index);
+#else
+    return __builtin_ctz(mask);
+#endif
+}
+
+// Tests a row of eight pixels against a triangle. `base` holds the three
+// barycentric coordinates of the first pixel in the row and `step` how much
+// they change from one pixel to the next. Bit i of the result is set when
+// pixel i lies inside the triangle, i.e. all three coordinates are >= 0.
+inline int CoverageMask8(const glm::vec3& base, const glm::vec3& step)
+{
+#if defined(RASTERIZER_AVX2)
+    const __m256 lane = _mm256_setr_ps(0.f, 1.f, 2.f, 3.f, 4.f, 5.f, 6.f, 7.f);
+    const __m256 zero = _mm256_setzero_ps();
+    __m256 alpha = _mm256_add_ps(_mm256_set1_ps(base.x), _mm256_mul_ps(lane, _mm256_set1_ps(step.x)));
+    __m256 beta = _mm256_add_ps(_mm256_set1_ps(base.y), _mm256_mul_ps(lane, _mm256_set1_ps(step.y)));
+    __m256 gamma = _mm256_add_ps(_mm256_set1_ps(base.z), _mm256_mul_ps(lane, _mm256_set1_ps(step.z)));
+    __m256 inside = _mm256_and_ps(_mm256_and_ps(_mm256_cmp_ps(alpha, zero, _CMP_GE_OQ),
+                                                _mm256_cmp_ps(beta, zero, _CMP_GE_OQ)),
+                                  _mm256_cmp_ps(gamma, zero, _CMP_GE_OQ));
+    return _mm256_movemask_ps(inside);
+#elif defined(RASTERIZER_SSE2)
+    const __m128 zero = _mm_setzero_ps();
+    int mask = 0;
+    for(int half = 0; half < 2; ++half)
+    {
+        const float first = 4.f * half;
+        const __m128 lane = _mm_setr_ps(first, first + 1.f, first + 2.f, first + 3.f);
+        __m128 alpha = _mm_add_ps(_mm_set1_ps(base.x), _mm_mul_ps(lane, _mm_set1_ps(step.x)));
+        __m128 beta = _mm_add_ps(_mm_set1_ps(base.y), _mm_mul_ps(lane, _mm_set1_ps(step.y)));
+        __m128 gamma = _mm_add_ps(_mm_set1_ps(base.z), _mm_mul_ps(lane, _mm_set1_ps(step.z)));
+        __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(alpha, zero), _mm_cmpge_ps(beta, zero)),
+                                   _mm_cmpge_ps(gamma, zero));
+        mask |= _mm_movemask_ps(inside) << (4 * half);
+    }
+    return mask;
+#else
+    int mask = 0;
+    for(int i = 0; i < 8; ++i)
+    {
+        glm::vec3 b = base + static_cast<float>(i) * step;
+        if(b.x >= 0 && b.y >= 0 && b.z >= 0)
+        {
+            mask |= 1 << i;
+        }
+    }
+    return mask;
+#endif
+}
+
+// Classifies a block against a triangle from the barycentric coordinates at
+// its four corners. Returns -1 when the block is entirely outside, 1 when it
+// is entirely inside and 0 when its rows need to be tested individually.
+inline int ClassifyBlock(const glm::vec3& c00, const glm::vec3& c10,
+                         const glm::vec3& c01, const glm::vec3& c11)
+{
+    glm::vec3 lo = glm::min(glm::min(c00, c10), glm::min(c01, c11));
+    if(lo.x >= 0 && lo.y >= 0 && lo.z >= 0)
+    {
+        return 1;
+    }
+    glm::vec3 hi = glm::max(glm::max(c00, c10), glm::max(c01, c11));
+    if(hi.x < 0 || hi.y < 0 || hi.z < 0)
+    {
+        return -1;
+    }
+    return 0;
+}
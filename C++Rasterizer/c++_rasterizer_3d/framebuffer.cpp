@@ -0,0 +1,145 @@
+#include "framebuffer.h"
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+#if defined(_WIN32)
+#include <malloc.h>
+#endif
+
+namespace
+{
+void* AllocateAligned(size_t bytes)
+{
+#if defined(_WIN32)
+    void* memory = _aligned_malloc(bytes, FrameBuffer::ALIGNMENT);
+#else
+    void* memory = nullptr;
+    if(posix_memalign(&memory, FrameBuffer::ALIGNMENT, bytes) != 0)
+    {
+        memory = nullptr;
+    }
+#endif
+    if(memory == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return memory;
+}
+
+void FreeAligned(void* memory)
+{
+#if defined(_WIN32)
+    _aligned_free(memory);
+#else
+    free(memory);
+#endif
+}
+
+// Grows a buffer to hold at least count elements. The old contents are dropped.
+template <typename T>
+void Reserve(T*& buffer, size_t& capacity, size_t count)
+{
+    if(count <= capacity)
+    {
+        return;
+    }
+    FreeAligned(buffer);
+    buffer = nullptr;
+    capacity = 0;
+    buffer = static_cast<T*>(AllocateAligned(count * sizeof(T)));
+    capacity = count;
+}
+}
+
+FrameBuffer::FrameBuffer()
+    : m_width(0), m_height(0), m_samples(1), m_withVisibility(false),
+      m_sampleColorCapacity(0), m_depthCapacity(0), m_visibilityCapacity(0),
+      m_colors(nullptr), m_sampleColors(nullptr), m_depth(nullptr), m_visibility(nullptr)
+{}
+
+FrameBuffer::FrameBuffer(const FrameBuffer&)
+    : FrameBuffer()
+{}
+
+FrameBuffer& FrameBuffer::operator=(const FrameBuffer& other)
+{
+    if(this != &other)
+    {
+        Release();
+    }
+    return *this;
+}
+
+FrameBuffer::~FrameBuffer()
+{
+    Release();
+}
+
+void FrameBuffer::Release()
+{
+    FreeAligned(m_colors);
+    FreeAligned(m_sampleColors);
+    FreeAligned(m_depth);
+    FreeAligned(m_visibility);
+    m_width = m_height = 0;
+    m_samples = 1;
+    m_withVisibility = false;
+    m_sampleColorCapacity = m_depthCapacity = m_visibilityCapacity = 0;
+    m_colors = m_sampleColors = nullptr;
+    m_depth = nullptr;
+    m_visibility = nullptr;
+}
+
+void FrameBuffer::Resize(int width, int height, int samples, bool withVisibility)
+{
+    size_t pixels = static_cast<size_t>(width) * height;
+    size_t sampleCount = pixels * samples;
+
+    // The previous frame's colors went to Qt with TakeImage
+    if(m_colors == nullptr || width != m_width || height != m_height)
+    {
+        FreeAligned(m_colors);
+        m_colors = nullptr;
+        m_colors = static_cast<QRgb*>(AllocateAligned(pixels * sizeof(QRgb)));
+    }
+    if(samples > 1)
+    {
+        Reserve(m_sampleColors, m_sampleColorCapacity, sampleCount);
+    }
+    Reserve(m_depth, m_depthCapacity, sampleCount);
+    if(withVisibility)
+    {
+        Reserve(m_visibility, m_visibilityCapacity, sampleCount);
+    }
+
+    m_width = width;
+    m_height = height;
+    m_samples = samples;
+    m_withVisibility = withVisibility;
+}
+
+void FrameBuffer::ClearRect(int minX, int maxX, int minY, int maxY, QRgb color, float depth, uint32_t id)
+{
+    size_t begin = static_cast<size_t>(minX) * m_samples;
+    size_t end = static_cast<size_t>(maxX + 1) * m_samples;
+    QRgb* colors = SampleColors();
+    for(int y = minY; y <= maxY; ++y)
+    {
+        size_t row = static_cast<size_t>(y) * m_width * m_samples;
+        std::fill(colors + row + begin, colors + row + end, color);
+        std::fill(m_depth + row + begin, m_depth + row + end, depth);
+        if(m_withVisibility)
+        {
+            std::fill(m_visibility + row + begin, m_visibility + row + end, id);
+        }
+    }
+}
+
+QImage FrameBuffer::TakeImage()
+{
+    QImage image(reinterpret_cast<uchar*>(m_colors), m_width, m_height,
+                 m_width * static_cast<int>(sizeof(QRgb)), QImage::Format_RGB32,
+                 FreeAligned, m_colors);
+    m_colors = nullptr;
+    return image;
+}
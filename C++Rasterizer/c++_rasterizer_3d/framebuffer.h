@@ -0,0 +1,63 @@
+#pragma once
+#include <QImage>
+#include <cstddef>
+#include <cstdint>
+
+// The render targets of a frame, kept by the Rasterizer so that rendering
+// does not allocate and clear them through QImage every frame. Every pixel
+// owns `samples` consecutive entries in the sample buffers. The resolved
+// colors are handed to Qt once per frame as a QImage that wraps them
+// without a copy.
+class FrameBuffer
+{
+public:
+    // Start of every buffer; wide enough for any SIMD load or store
+    static const size_t ALIGNMENT = 64;
+
+    FrameBuffer();
+    // The buffers are scratch space that every frame overwrites, so a copy
+    // starts out empty and allocates its own on the next Resize
+    FrameBuffer(const FrameBuffer&);
+    FrameBuffer& operator=(const FrameBuffer&);
+    ~FrameBuffer();
+
+    // Makes room for a width x height frame with the given samples per pixel.
+    // The contents are undefined until ClearRect is called on them.
+    void Resize(int width, int height, int samples, bool withVisibility);
+
+    int Width() const { return m_width; }
+    int Height() const { return m_height; }
+    int Samples() const { return m_samples; }
+
+    // The resolved color of every pixel, in rows of Width() entries
+    QRgb* Colors() { return m_colors; }
+    // Per sample colors. Without multisampling these are the resolved colors.
+    QRgb* SampleColors() { return m_samples > 1 ? m_sampleColors : m_colors; }
+    float* Depth() { return m_depth; }
+    const float* Depth() const { return m_depth; }
+    // Null unless Resize was asked for a visibility buffer
+    uint32_t* Visibility() { return m_withVisibility ? m_visibility : nullptr; }
+
+    // Resets every sample of the pixels in the rectangle
+    void ClearRect(int minX, int maxX, int minY, int maxY, QRgb color, float depth, uint32_t id);
+
+    // Wraps the resolved colors in a QImage that takes ownership of them.
+    // The next Resize allocates new ones, so the image stays valid however
+    // long the caller keeps it.
+    QImage TakeImage();
+
+private:
+    void Release();
+
+    int m_width;
+    int m_height;
+    int m_samples;
+    bool m_withVisibility;
+    size_t m_sampleColorCapacity;
+    size_t m_depthCapacity;
+    size_t m_visibilityCapacity;
+    QRgb* m_colors;
+    QRgb* m_sampleColors;
+    float* m_depth;
+    uint32_t* m_visibility;
+};
@@ -0,0 +1,83 @@
+#include "hizbuffer.h"
+#include "simd.h"
+#include <algorithm>
+#include <limits>
+
+HiZBuffer::HiZBuffer()
+    : m_width(0), m_height(0), m_samples(1), m_blocksX(0), m_blocksY(0), m_min(), m_max()
+{}
+
+HiZBuffer::HiZBuffer(int width, int height, int samples, float clearDepth)
+    : m_width(width), m_height(height), m_samples(samples),
+      m_blocksX((width + BLOCK_SIZE - 1) / BLOCK_SIZE),
+      m_blocksY((height + BLOCK_SIZE - 1) / BLOCK_SIZE),
+      m_min(m_blocksX * m_blocksY, clearDepth),
+      m_max(m_blocksX * m_blocksY, clearDepth)
+{}
+
+float HiZBuffer::BlockMin(int blockX, int blockY) const
+{
+    return m_min[blockX + blockY * m_blocksX];
+}
+
+float HiZBuffer::BlockMax(int blockX, int blockY) const
+{
+    return m_max[blockX + blockY * m_blocksX];
+}
+
+float HiZBuffer::MaxDepth(int minX, int maxX, int minY, int maxY) const
+{
+    float result = -std::numeric_limits<float>::max();
+    for(int blockY = minY / BLOCK_SIZE; blockY <= maxY / BLOCK_SIZE; ++blockY)
+    {
+        for(int blockX = minX / BLOCK_SIZE; blockX <= maxX / BLOCK_SIZE; ++blockX)
+        {
+            result = std::max(result, m_max[blockX + blockY * m_blocksX]);
+        }
+    }
+    return result;
+}
+
+void HiZBuffer::Refresh(const float* zBuffer, int blockX, int blockY)
+{
+    int x0 = blockX * BLOCK_SIZE;
+    int y0 = blockY * BLOCK_SIZE;
+    int x1 = std::min(x0 + BLOCK_SIZE, m_width);
+    int y1 = std::min(y0 + BLOCK_SIZE, m_height);
+    int rowLength = m_width * m_samples;
+
+    float lo = std::numeric_limits<float>::max();
+    float hi = -std::numeric_limits<float>::max();
+#if defined(RASTERIZER_SSE2)
+    __m128 lo4 = _mm_set1_ps(lo);
+    __m128 hi4 = _mm_set1_ps(hi);
+#endif
+    for(int y = y0; y < y1; ++y)
+    {
+        const float* row = zBuffer + y * rowLength;
+        int x = x0 * m_samples;
+        int end = x1 * m_samples;
+#if defined(RASTERIZER_SSE2)
+        for(; x + 4 <= end; x += 4)
+        {
+            __m128 depth = _mm_loadu_ps(row + x);
+            lo4 = _mm_min_ps(lo4, depth);
+            hi4 = _mm_max_ps(hi4, depth);
+        }
+#endif
+        for(; x < end; ++x)
+        {
+            lo = std::min(lo, row[x]);
+            hi = std::max(hi, row[x]);
+        }
+    }
+#if defined(RASTERIZER_SSE2)
+    float lanes[4];
+    _mm_storeu_ps(lanes, lo4);
+    lo = std::min({lo, lanes[0], lanes[1], lanes[2], lanes[3]});
+    _mm_storeu_ps(lanes, hi4);
+    hi = std::max({hi, lanes[0], lanes[1], lanes[2], lanes[3]});
+#endif
+    m_min[blockX + blockY * m_blocksX] = lo;
+    m_max[blockX + blockY * m_blocksX] = hi;
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include <vector>
+
+// A coarse level on top of a flat z-buffer. For every 8x8 block of pixels it
+// keeps the nearest and the farthest depth currently stored in the block,
+// which lets the rasterizer discard whole triangles and blocks that are
+// hidden before it interpolates a single attribute. With multisampling the
+// z-buffer holds several depth samples per pixel, stored next to each other,
+// and a block's bounds cover all of them.
+class HiZBuffer
+{
+public:
+    // Blocks line up with the rasterizer's coverage blocks
+    static const int BLOCK_SIZE = 8;
+
+    HiZBuffer();
+    HiZBuffer(int width, int height, int samples, float clearDepth);
+
+    float BlockMin(int blockX, int blockY) const;
+    float BlockMax(int blockX, int blockY) const;
+
+    // The farthest depth stored anywhere in the given pixel rectangle.
+    // A triangle that is nowhere nearer than this is completely occluded.
+    float MaxDepth(int minX, int maxX, int minY, int maxY) const;
+
+    // Recomputes one block's bounds after its pixels of zBuffer changed
+    void Refresh(const float* zBuffer, int blockX, int blockY);
+
+private:
+    int m_width;
+    int m_height;
+    int m_samples;
+    int m_blocksX;
+    int m_blocksY;
+    std::vector<float> m_min;
+    std::vector<float> m_max;
+};
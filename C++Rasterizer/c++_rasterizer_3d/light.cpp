@@ -0,0 +1,221 @@
+#include "light.h"
+#include "clipper.h"
+#include "shadowmap.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace
+{
+// The tiles of a grid a light's area covers
+struct TileRect
+{
+    int minX, maxX, minY, maxY;
+};
+
+// The tiles the box around a sphere covers on screen. Returns false when the
+// box is entirely outside the view frustum. A box reaching behind the near
+// plane has no bounded projection and covers every tile.
+bool SphereTiles(const glm::vec3& center, float radius, const glm::mat4& viewProj, float nearW,
+                 int width, int height, int tileSize, TileRect& rect)
+{
+    unsigned char outsideAll = 0xff;
+    bool crossesNear = false;
+    glm::vec2 lo(std::numeric_limits<float>::max());
+    glm::vec2 hi(-std::numeric_limits<float>::max());
+    for(int corner = 0; corner < 8; ++corner)
+    {
+        glm::vec3 offset((corner & 1) ? radius : -radius, (corner & 2) ? radius : -radius,
+                         (corner & 4) ? radius : -radius);
+        glm::vec4 clip = viewProj * glm::vec4(center + offset, 1.f);
+        outsideAll &= FrustumOutcode(glm::vec3(clip.x, clip.y, clip.w), nearW);
+        if(clip.w <= nearW)
+        {
+            crossesNear = true;
+            continue;
+        }
+        glm::vec2 pixel((clip.x / clip.w + 1) * 0.5f * width, (1 - clip.y / clip.w) * 0.5f * height);
+        lo = glm::min(lo, pixel);
+        hi = glm::max(hi, pixel);
+    }
+    if(outsideAll != 0)
+    {
+        return false;
+    }
+    if(crossesNear)
+    {
+        return true;
+    }
+    // Clamped in floating point, since the box may project far beyond the screen
+    glm::vec2 lastTile(rect.maxX, rect.maxY);
+    glm::vec2 first = glm::clamp(glm::floor(lo / static_cast<float>(tileSize)), glm::vec2(0.f), lastTile);
+    glm::vec2 last = glm::clamp(glm::floor(hi / static_cast<float>(tileSize)), glm::vec2(0.f), lastTile);
+    rect.minX = static_cast<int>(first.x);
+    rect.maxX = static_cast<int>(last.x);
+    rect.minY = static_cast<int>(first.y);
+    rect.maxY = static_cast<int>(last.y);
+    return true;
+}
+}
+
+Light Light::Directional(const glm::vec3& direction, const glm::vec3& color)
+{
+    return {LightType::Directional, color, glm::vec3(0.f), direction, 0.f, 0.f, 0.f, false};
+}
+
+Light Light::Point(const glm::vec3& position, const glm::vec3& color, float range)
+{
+    return {LightType::Point, color, position, glm::vec3(0.f, 0.f, -1.f), range, 0.f, 0.f, false};
+}
+
+Light Light::Spot(const glm::vec3& position, const glm::vec3& direction, const glm::vec3& color, float range,
+                  float innerCone, float outerCone)
+{
+    return {LightType::Spot, color, position, direction, range, innerCone, outerCone, false};
+}
+
+bool operator==(const Light& a, const Light& b)
+{
+    return a.type == b.type && a.color == b.color && a.position == b.position && a.direction == b.direction
+        && a.range == b.range && a.innerCone == b.innerCone && a.outerCone == b.outerCone
+        && a.castsShadows == b.castsShadows;
+}
+
+bool operator!=(const Light& a, const Light& b)
+{
+    return !(a == b);
+}
+
+LightGrid::LightGrid()
+    : m_tileSize(1), m_tilesX(0)
+{}
+
+void LightGrid::Build(const std::vector<Light>& lights, const std::vector<const ShadowMap*>& shadowMaps,
+                      const glm::mat4& viewProj, float nearW, int width, int height, int tileSize)
+{
+    m_tileSize = tileSize;
+    m_tilesX = (width + tileSize - 1) / tileSize;
+    int tilesY = (height + tileSize - 1) / tileSize;
+    int tileCount = m_tilesX * tilesY;
+
+    m_lights.clear();
+    std::vector<TileRect> rects;
+    for(size_t i = 0; i < lights.size(); ++i)
+    {
+        const Light& light = lights[i];
+        TileRect rect = {0, m_tilesX - 1, 0, tilesY - 1};
+        if(light.type != LightType::Directional
+           && (light.range <= 0.f
+               || !SphereTiles(light.position, light.range, viewProj, nearW, width, height, tileSize, rect)))
+        {
+            continue;
+        }
+
+        Prepared prepared;
+        prepared.type = light.type;
+        prepared.color = light.color;
+        prepared.position = light.position;
+        prepared.direction = glm::normalize(light.direction);
+        prepared.toLight = -prepared.direction;
+        prepared.range = light.range;
+        float cosInner = std::cos(glm::radians(light.innerCone));
+        prepared.cosOuter = std::cos(glm::radians(light.outerCone));
+        prepared.invConeBlend = 1.f / std::max(cosInner - prepared.cosOuter, 1e-4f);
+        prepared.shadowMap = i < shadowMaps.size() ? shadowMaps[i] : nullptr;
+        m_lights.push_back(prepared);
+        rects.push_back(rect);
+    }
+
+    // Count each tile's lights first, so every tile's list is one contiguous
+    // run and lights keep their order within it
+    m_tileStart.assign(tileCount + 1, 0);
+    for(const TileRect& rect : rects)
+    {
+        for(int ty = rect.minY; ty <= rect.maxY; ++ty)
+        {
+            for(int tx = rect.minX; tx <= rect.maxX; ++tx)
+            {
+                ++m_tileStart[tx + ty * m_tilesX + 1];
+            }
+        }
+    }
+    for(int tile = 0; tile < tileCount; ++tile)
+    {
+        m_tileStart[tile + 1] += m_tileStart[tile];
+    }
+
+    m_tileLights.resize(m_tileStart[tileCount]);
+    std::vector<uint32_t> next(m_tileStart.begin(), m_tileStart.end() - 1);
+    for(uint32_t light = 0; light < rects.size(); ++light)
+    {
+        const TileRect& rect = rects[light];
+        for(int ty = rect.minY; ty <= rect.maxY; ++ty)
+        {
+            for(int tx = rect.minX; tx <= rect.maxX; ++tx)
+            {
+                m_tileLights[next[tx + ty * m_tilesX]++] = light;
+            }
+        }
+    }
+}
+
+void LightGrid::TileLights(int x, int y, const uint32_t*& first, const uint32_t*& last) const
+{
+    int tile = x / m_tileSize + (y / m_tileSize) * m_tilesX;
+    first = m_tileLights.data() + m_tileStart[tile];
+    last = m_tileLights.data() + m_tileStart[tile + 1];
+}
+
+bool LightGrid::Illuminate(uint32_t light, const glm::vec3& point, const glm::vec3& normal,
+                           glm::vec3& toLight, glm::vec3& radiance) const
+{
+    const Prepared& l = m_lights[light];
+    if(l.type == LightType::Directional)
+    {
+        float visibility = l.shadowMap != nullptr ? l.shadowMap->Visibility(point, normal) : 1.f;
+        toLight = l.toLight;
+        radiance = l.color * visibility;
+        return visibility > 0.f;
+    }
+
+    glm::vec3 offset = l.position - point;
+    float distanceSq = glm::dot(offset, offset);
+    float rangeSq = l.range * l.range;
+    if(distanceSq >= rangeSq || distanceSq == 0.f)
+    {
+        return false;
+    }
+    toLight = offset / std::sqrt(distanceSq);
+
+    // Inverse square falloff, kept finite next to the light and windowed so
+    // it reaches exactly zero at the range
+    float window = 1.f - (distanceSq / rangeSq) * (distanceSq / rangeSq);
+    float attenuation = window * window / (1.f + distanceSq);
+    if(l.type == LightType::Spot)
+    {
+        float cone = glm::clamp((glm::dot(-toLight, l.direction) - l.cosOuter) * l.invConeBlend, 0.f, 1.f);
+        if(cone == 0.f)
+        {
+            return false;
+        }
+        attenuation *= cone * cone * (3.f - 2.f * cone);
+    }
+    // Shadows last, since the lookup is the most expensive test
+    float visibility = l.shadowMap != nullptr ? l.shadowMap->Visibility(point, normal) : 1.f;
+    if(visibility == 0.f)
+    {
+        return false;
+    }
+    radiance = l.color * (attenuation * visibility);
+    return true;
+}
+
+int LightGrid::VisibleLights() const
+{
+    return static_cast<int>(m_lights.size());
+}
+
+size_t LightGrid::Entries() const
+{
+    return m_tileLights.size();
+}
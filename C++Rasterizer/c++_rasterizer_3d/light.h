@@ -0,0 +1,92 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+
+class ShadowMap;
+
+enum class LightType : uint8_t
+{
+    Directional, // Infinitely far away, so it lights everything from one direction
+    Point,       // Shines in every direction from its position
+    Spot         // A point light limited to a cone around its direction
+};
+
+// A light of the scene, in world space. The color multiplies the surface
+// color, so (1, 1, 1) is a white light at full strength. Point and spot
+// lights fall off with the square of the distance and fade out completely
+// at their range, which is what lets the rasterizer skip them everywhere
+// else on screen. Lights that cast shadows get a shadow map rendered from
+// their point of view.
+struct Light
+{
+    LightType type;
+    glm::vec3 color;
+    glm::vec3 position;  // Point and spot lights
+    glm::vec3 direction; // The way the light travels, for directional and spot lights
+    float range;         // Point and spot lights
+    float innerCone;     // Spot lights: half-angle in degrees of the fully lit cone
+    float outerCone;     // Spot lights: half-angle in degrees beyond which nothing is lit
+    bool castsShadows;
+
+    // The factories make lights that cast no shadows
+    static Light Directional(const glm::vec3& direction, const glm::vec3& color);
+    static Light Point(const glm::vec3& position, const glm::vec3& color, float range);
+    static Light Spot(const glm::vec3& position, const glm::vec3& direction, const glm::vec3& color, float range,
+                      float innerCone, float outerCone);
+};
+
+bool operator==(const Light& a, const Light& b);
+bool operator!=(const Light& a, const Light& b);
+
+// The lights of a frame, binned into square screen tiles. Point and spot
+// lights go into the tiles their bounding sphere covers on screen, so a pixel
+// only evaluates the lights that can reach its tile and many small lights
+// cost little more than a few large ones. Directional lights reach every tile.
+class LightGrid
+{
+public:
+    LightGrid();
+
+    // Bins lights for a width x height screen split into tiles of tileSize
+    // pixels. Lights entirely outside the view frustum are dropped.
+    // shadowMaps holds each light's shadow map, or null for lights that cast
+    // none; it may be left empty when no light does.
+    void Build(const std::vector<Light>& lights, const std::vector<const ShadowMap*>& shadowMaps,
+               const glm::mat4& viewProj, float nearW, int width, int height, int tileSize);
+
+    // The lights that may reach pixel (x, y), as indices for Illuminate
+    void TileLights(int x, int y, const uint32_t*& first, const uint32_t*& last) const;
+
+    // The direction from point toward a light and the light that arrives
+    // there, on a surface facing normal. Returns false when the light does
+    // not reach point at all.
+    bool Illuminate(uint32_t light, const glm::vec3& point, const glm::vec3& normal,
+                    glm::vec3& toLight, glm::vec3& radiance) const;
+
+    // Lights in view, and how many tile entries they took up
+    int VisibleLights() const;
+    size_t Entries() const;
+
+private:
+    // A light with the values shading needs precomputed
+    struct Prepared
+    {
+        LightType type;
+        glm::vec3 color;
+        glm::vec3 position;
+        glm::vec3 toLight; // Directional lights: the reverse of their direction
+        glm::vec3 direction;
+        float range;
+        float cosOuter;     // Spot lights: the cosine of the outer cone's half-angle,
+        float invConeBlend; // and one over how much larger the inner cone's is
+        const ShadowMap* shadowMap;
+    };
+
+    std::vector<Prepared> m_lights;
+    int m_tileSize;
+    int m_tilesX;
+    // Tile t's lights are m_tileLights[m_tileStart[t]] up to m_tileLights[m_tileStart[t + 1]]
+    std::vector<uint32_t> m_tileStart;
+    std::vector<uint32_t> m_tileLights;
+};
@@ -2,16 +2,13 @@
 #include "ui_mainwindow.h"
 #include <QPixmap>
 #include <QFileDialog>
-#include <QTextStream>
-#include <QJsonObject>
-#include <QJsonDocument>
-#include <QJsonArray>
 #include <iostream>
 #include <QApplication>
 #include <QKeyEvent>
 #include <QImageWriter>
 #include <QDebug>
-#include <tiny_obj_loader.h>
+#include "sceneloader.h"
+#include <algorithm>
 
 //Poke around in this file if you want, but it's virtually uncommented!
 //You won't need to modify anything in here to complete the assignment.
@@ -24,65 +21,79 @@ void MainWindow::keyPressEvent(QKeyEvent *e)
     //editor. This one was implemented as a key press event for illustration purposes.
     case Qt::Key_Escape : on_actionQuit_Esc_triggered();  break;
     case Qt::Key_W:
-        rasterizer.GetCamera().TranslateForward(0.5);
+        camera.TranslateForward(0.5);
         break;
     case Qt::Key_S:
-        rasterizer.GetCamera().TranslateForward(-0.5);
+        camera.TranslateForward(-0.5);
         break;
     case Qt::Key_A:
-        rasterizer.GetCamera().TranslateRight(-0.5);
+        camera.TranslateRight(-0.5);
         break;
     case Qt::Key_D:
-        rasterizer.GetCamera().TranslateRight(0.5);
+        camera.TranslateRight(0.5);
         break;
     case Qt::Key_Q:
-        rasterizer.GetCamera().TranslateUp(-0.5);
+        camera.TranslateUp(-0.5);
         break;
     case Qt::Key_E:
-        rasterizer.GetCamera().TranslateUp(0.5);
+        camera.TranslateUp(0.5);
         break;
     case Qt::Key_Up:
-        rasterizer.GetCamera().RotateAboutRight(-5);
+        camera.RotateAboutRight(-5);
         break;
     case Qt::Key_Down:
-        rasterizer.GetCamera().RotateAboutRight(5);
+        camera.RotateAboutRight(5);
         break;
     case Qt::Key_Left:
-        rasterizer.GetCamera().RotateAboutUp(5);
+        camera.RotateAboutUp(5);
         break;
     case Qt::Key_Right:
-        rasterizer.GetCamera().RotateAboutUp(-5);
+        camera.RotateAboutUp(-5);
         break;
     case Qt::Key_Z:
-        rasterizer.GetCamera().RotateAboutForward(5);
+        camera.RotateAboutForward(5);
         break;
     case Qt::Key_X:
-        rasterizer.GetCamera().RotateAboutForward(-5);
+        camera.RotateAboutForward(-5);
         break;
     }
 
-    rendered_image = rasterizer.RenderScene();
-    DisplayQImage(rendered_image);
+    //Show where the camera went at once, then the real frame tile by tile
+    QImage preview = ReprojectFrame(lastFrame, camera);
+    if(!preview.isNull())
+    {
+        DisplayQImage(preview);
+    }
+    StartRender(preview);
 }
 
 
 MainWindow::MainWindow(QWidget *parent) :
     QMainWindow(parent),
     ui(new Ui::MainWindow),
-    rasterizer(std::vector<Polygon>())
+    rasterizer(std::vector<Polygon>()),
+    scalingFactor(1),
+    renderPending(false),
+    partialChanged(false),
+    partialFrame(0)
 {
+    //About as often as a display refreshes
+    refreshTimer.setInterval(16);
+    connect(&refreshTimer, &QTimer::timeout, this, &MainWindow::onRefreshTimeout);
     ui->setupUi(this);
     setFocusPolicy(Qt::StrongFocus);
 }
 
 MainWindow::~MainWindow()
 {
+    StopRender();
     delete ui;
 }
 
 void MainWindow::DisplayQImage(QImage &i)
 {
     QPixmap pixmap(QPixmap::fromImage(i));
+    graphics_scene.clear();
     graphics_scene.addPixmap(pixmap);
     graphics_scene.setSceneRect(pixmap.rect());
     ui->scene_display->setScene(&graphics_scene);
@@ -91,146 +102,30 @@ void MainWindow::DisplayQImage(QImage &i)
 void MainWindow::on_actionLoad_Scene_triggered()
 {
     std::vector<Polygon> polygons;
+    std::vector<Light> lights;
 
     QString filename = QFileDialog::getOpenFileName(0, QString("Load Scene File"), QDir::currentPath().append(QString("../..")), QString("*.json"));
-    int i = filename.length() - 1;
-    while(QString::compare(filename.at(i), QChar('/')) != 0)
+    if(filename.isEmpty())
     {
-        i--;
-    }
-    QString local_path = filename.left(i+1);
-
-    QFile file(filename);
-    if(!file.open(QIODevice::ReadOnly)){
-        qWarning("Could not open the JSON file.");
         return;
     }
-    QByteArray file_data = file.readAll();
-
-    QJsonDocument jdoc(QJsonDocument::fromJson(file_data));
-    //Read the mesh data in the file
-    QJsonArray objects = jdoc.object()["objects"].toArray();
-    for(int i = 0; i < objects.size(); i++)
+    QString error;
+    if(!LoadScene(filename, polygons, &error, &textures, &lights))
     {
-        std::vector<glm::vec4> vert_pos;
-        std::vector<glm::vec3> vert_col;
-        QJsonObject obj = objects[i].toObject();
-        QString type = obj["type"].toString();
-        //Custom Polygon case
-        if(QString::compare(type, QString("custom")) == 0)
-        {
-            QString name = obj["name"].toString();
-            QJsonArray pos = obj["vertexPos"].toArray();
-            for(int j = 0; j < pos.size(); j++)
-            {
-                QJsonArray arr = pos[j].toArray();
-                glm::vec4 p(arr[0].toDouble(), arr[1].toDouble(), arr[2].toDouble(), 1);
-                vert_pos.push_back(p);
-            }
-            QJsonArray col = obj["vertexCol"].toArray();
-            for(int j = 0; j < col.size(); j++)
-            {
-                QJsonArray arr = col[j].toArray();
-                glm::vec3 c(arr[0].toDouble(), arr[1].toDouble(), arr[2].toDouble());
-                vert_col.push_back(c);
-            }
-            Polygon p(name, vert_pos, vert_col);
-            polygons.push_back(p);
-        }
-        //Regular Polygon case
-        else if(QString::compare(type, QString("regular")) == 0)
-        {
-            QString name = obj["name"].toString();
-            int sides = obj["sides"].toInt();
-            QJsonArray colorA = obj["color"].toArray();
-            glm::vec3 color(colorA[0].toDouble(), colorA[1].toDouble(), colorA[2].toDouble());
-            QJsonArray posA = obj["pos"].toArray();
-            glm::vec4 pos(posA[0].toDouble(), posA[1].toDouble(), posA[2].toDouble(),1);
-            float rot = obj["rot"].toDouble();
-            QJsonArray scaleA = obj["scale"].toArray();
-            glm::vec4 scale(scaleA[0].toDouble(), scaleA[1].toDouble(), scaleA[2].toDouble(),1);
-            Polygon p(name, sides, color, pos, rot, scale);
-            polygons.push_back(p);
-        }
-        //OBJ file case
-        else if(QString::compare(type, QString("obj")) == 0)
-        {
-            QString name = obj["name"].toString();
-            QString filename = local_path;
-            filename.append(obj["filename"].toString());
-            Polygon p = LoadOBJ(filename, name);
-            QString texPath = local_path;
-            texPath.append(obj["texture"].toString());
-            p.SetTexture(new QImage(texPath));
-            if(obj.contains(QString("normalMap")))
-            {
-                p.SetNormalMap(new QImage(local_path.append(obj["normalMap"].toString())));
-            }
-            polygons.push_back(p);
-        }
+        qWarning("%s", qPrintable(error));
+        return;
     }
 
-    rasterizer = Rasterizer(polygons);
+    StopRender();
+    rasterizer = Rasterizer(std::move(polygons));
+    rasterizer.lights = std::move(lights);
+    // The previous scene is gone now, and with it the last users of the
+    // textures the new one does not share
+    textures.Prune();
 
-    rendered_image = rasterizer.RenderScene();
-    DisplayQImage(rendered_image);
-}
-
-
-Polygon MainWindow::LoadOBJ(const QString &file, const QString &polyName)
-{
-    Polygon p(polyName);
-    QString filepath = file;
-    std::vector<tinyobj::shape_t> shapes; std::vector<tinyobj::material_t> materials;
-    std::string errors = tinyobj::LoadObj(shapes, materials, filepath.toStdString().c_str());
-    std::cout << errors << std::endl;
-    if(errors.size() == 0)
-    {
-        int min_idx = 0;
-        //Read the information from the vector of shape_ts
-        for(unsigned int i = 0; i < shapes.size(); i++)
-        {
-            std::vector<glm::vec4> pos, nor;
-            std::vector<glm::vec2> uv;
-            std::vector<float> &positions = shapes[i].mesh.positions;
-            std::vector<float> &normals = shapes[i].mesh.normals;
-            std::vector<float> &uvs = shapes[i].mesh.texcoords;
-            for(unsigned int j = 0; j < positions.size()/3; j++)
-            {
-                pos.push_back(glm::vec4(positions[j*3], positions[j*3+1], positions[j*3+2],1));
-            }
-            for(unsigned int j = 0; j < normals.size()/3; j++)
-            {
-                nor.push_back(glm::vec4(normals[j*3], normals[j*3+1], normals[j*3+2],0));
-            }
-            for(unsigned int j = 0; j < uvs.size()/2; j++)
-            {
-                uv.push_back(glm::vec2(uvs[j*2], uvs[j*2+1]));
-            }
-            for(unsigned int j = 0; j < pos.size(); j++)
-            {
-                p.AddVertex(Vertex(pos[j], glm::vec3(255,255,255), nor[j], uv[j]));
-            }
-
-            std::vector<unsigned int> indices = shapes[i].mesh.indices;
-            for(unsigned int j = 0; j < indices.size(); j += 3)
-            {
-                Triangle t;
-                t.m_indices[0] = indices[j] + min_idx;
-                t.m_indices[1] = indices[j+1] + min_idx;
-                t.m_indices[2] = indices[j+2] + min_idx;
-                p.AddTriangle(t);
-            }
-
-            min_idx += pos.size();
-        }
-    }
-    else
-    {
-        //An error loading the OBJ occurred!
-        std::cout << errors << std::endl;
-    }
-    return p;
+    camera = rasterizer.GetCamera();
+    lastFrame = FrameSnapshot();
+    StartRender();
 }
 
 
@@ -273,12 +168,14 @@ void MainWindow::on_actionEquilateral_Triangle_triggered()
     }
 
     p.AddTriangle(t);
-    std::vector<Polygon> vec; vec.push_back(p);
+    std::vector<Polygon> vec; vec.push_back(std::move(p));
 
-    rasterizer = Rasterizer(vec);
+    StopRender();
+    rasterizer = Rasterizer(std::move(vec));
 
-    rendered_image = rasterizer.RenderScene();
-    DisplayQImage(rendered_image);
+    camera = rasterizer.GetCamera();
+    lastFrame = FrameSnapshot();
+    StartRender();
 }
 
 void MainWindow::on_actionQuit_Esc_triggered()
@@ -288,19 +185,117 @@ void MainWindow::on_actionQuit_Esc_triggered()
 
 void MainWindow::on_comboBox_currentIndexChanged(int index)
 {
-    int scalingFactor = 1;
-
     switch (index) {
     case 0: scalingFactor = 1; break;
-    case 1: scalingFactor = 4; break;
-    case 2: scalingFactor = 9; break;
-    case 3: scalingFactor = 16; break;
+    case 1: scalingFactor = 2; break;
+    case 2: scalingFactor = 3; break;
+    case 3: scalingFactor = 4; break;
 
     }
 
+    StartRender(rendered_image);
+}
+
+void MainWindow::StartRender(const QImage& base)
+{
+    if(renderTask)
+    {
+        //The frame in flight shows a camera that is already out of date.
+        //Waiting for it here would freeze the window until it notices.
+        renderTask->Cancel();
+        renderPending = true;
+        pendingBase = base;
+        //Nothing more of the old frame is shown
+        std::lock_guard<std::mutex> lock(partialMutex);
+        ++partialFrame;
+        partialChanged = false;
+        return;
+    }
+    BeginRender(base);
+}
+
+void MainWindow::BeginRender(const QImage& base)
+{
+    rasterizer.GetCamera() = camera;
     rasterizer.scalingFactor = scalingFactor;
+    int frame;
+    {
+        std::lock_guard<std::mutex> lock(partialMutex);
+        partialImage = base;
+        partialChanged = false;
+        frame = ++partialFrame;
+    }
+    renderTask.reset(new RenderTask(rasterizer, [this, frame](const RenderedTile& tile) {
+        std::lock_guard<std::mutex> lock(partialMutex);
+        if(frame != partialFrame)
+        {
+            return;
+        }
+        if(partialImage.width() != tile.frameWidth || partialImage.height() != tile.frameHeight)
+        {
+            partialImage = QImage(tile.frameWidth, tile.frameHeight, QImage::Format_RGB32);
+            partialImage.fill(qRgb(0, 0, 0));
+        }
+        for(int y = tile.minY; y <= tile.maxY; ++y)
+        {
+            const QRgb* source = tile.pixels + (y - tile.minY) * tile.stride;
+            std::copy(source, source + tile.maxX - tile.minX + 1,
+                      reinterpret_cast<QRgb*>(partialImage.scanLine(y)) + tile.minX);
+        }
+        partialChanged = true;
+    }));
+    refreshTimer.start();
+}
 
-    rendered_image = rasterizer.RenderScene();
-    DisplayQImage(rendered_image);
+void MainWindow::StopRender()
+{
+    refreshTimer.stop();
+    renderPending = false;
+    pendingBase = QImage();
+    renderTask.reset();
 }
 
+void MainWindow::onRefreshTimeout()
+{
+    if(!renderTask)
+    {
+        refreshTimer.stop();
+        return;
+    }
+    if(renderTask->IsFinished())
+    {
+        //Finished, so this does not block
+        QImage image = renderTask->Wait();
+        renderTask.reset();
+        if(!image.isNull())
+        {
+            //Even a frame cancelled too late to stop is a better base for
+            //previews than the one before it
+            lastFrame.image = image;
+            lastFrame.depth = rasterizer.FrameDepth();
+            lastFrame.camera = rasterizer.GetCamera();
+            rendered_image = image;
+        }
+        if(renderPending)
+        {
+            renderPending = false;
+            QImage base;
+            base.swap(pendingBase);
+            BeginRender(base);
+            return;
+        }
+        refreshTimer.stop();
+        if(!image.isNull())
+        {
+            DisplayQImage(rendered_image);
+        }
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(partialMutex);
+    if(partialChanged)
+    {
+        partialChanged = false;
+        DisplayQImage(partialImage);
+    }
+}
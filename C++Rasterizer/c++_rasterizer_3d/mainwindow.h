@@ -4,8 +4,14 @@
 #include <QMainWindow>
 #include <QImage>
 #include <QGraphicsScene>
+#include <QTimer>
 #include <polygon.h>
 #include <rasterizer.h>
+#include <rendertask.h>
+#include <reprojection.h>
+#include <sceneloader.h>
+#include <memory>
+#include <mutex>
 
 namespace Ui {
 class MainWindow;
@@ -34,19 +40,59 @@ private slots:
 
     void on_comboBox_currentIndexChanged(int index);
 
+    void onRefreshTimeout();
+
 private:
+    //Starts rendering the current camera in the background. Until its tiles
+    //arrive, the display shows base. A frame in flight is cancelled, and the
+    //new one starts from onRefreshTimeout once the old one is done.
+    void StartRender(const QImage& base = QImage());
+    //Hands the rasterizer to a new frame; no frame may be in flight
+    void BeginRender(const QImage& base);
+    //Cancels the frame in flight, if any, and blocks until it lets go of the
+    //rasterizer. Only for replacing the rasterizer itself.
+    void StopRender();
+
     Ui::MainWindow *ui;
-    Polygon LoadOBJ(const QString &file, const QString &polyName);
 
     //This is used to display the QImage produced by RenderScene in the GUI
     QGraphicsScene graphics_scene;
 
-    //This is the image rendered by your program when it loads a scene
+    //This is the last image rendered at full quality, which Save Image writes
     QImage rendered_image;
 
-    //The instance of the Rasterizer used to render our scene
+    //The instance of the Rasterizer used to render our scene. While a frame
+    //renders it belongs to renderTask.
     Rasterizer rasterizer;
 
+    //Where the user navigated to, and the anti-aliasing they picked. The
+    //rasterizer only follows when a frame starts, since it may be rendering
+    //with the old ones.
+    Camera camera;
+    int scalingFactor;
+
+    //The frame in flight, if any
+    std::unique_ptr<RenderTask> renderTask;
+    //Set while a cancelled frame finishes; the frame asked for in its place
+    //then starts over pendingBase
+    bool renderPending;
+    QImage pendingBase;
+    //Shows the tiles of the frame in flight as they arrive, and the frame
+    //itself once it is done
+    QTimer refreshTimer;
+    //The frame in flight as far as it got. The rasterizer's workers copy
+    //finished tiles into it while the GUI thread shows it. Tiles of any
+    //frame but the partialFrame-th are from a cancelled one and dropped.
+    std::mutex partialMutex;
+    QImage partialImage;
+    bool partialChanged;
+    int partialFrame;
+    //The last full quality frame, which previews are made from
+    FrameSnapshot lastFrame;
+
+    //Textures of the scenes loaded so far, shared with the polygons that use them
+    TextureCache textures;
+
 };
 
 #endif // MAINWINDOW_H
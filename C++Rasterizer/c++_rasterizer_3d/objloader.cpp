@@ -0,0 +1,731 @@
+#include "objloader.h"
+#include "parallel.h"
+#include <QFile>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+
+namespace
+{
+// Chunks are at least this large, so small files are not split into pieces
+// that cost more to schedule than to parse
+const size_t MIN_CHUNK_BYTES = 64 * 1024;
+// Enough chunks per worker that one slow chunk does not hold up the rest
+const int CHUNKS_PER_WORKER = 8;
+// Triangles are renumbered after merging vertices in blocks of this many
+const size_t REMAP_BLOCK = 64 * 1024;
+// Tangents are finished and packed in blocks of this many vertices
+const size_t TANGENT_BLOCK = 64 * 1024;
+
+// One corner of a face, as 0-based indices into the file-wide position, uv
+// and normal arrays. Missing uvs and normals are -1.
+struct Corner
+{
+    int64_t position;
+    int64_t uv;
+    int64_t normal;
+
+    bool operator==(const Corner& other) const
+    {
+        return position == other.position && uv == other.uv && normal == other.normal;
+    }
+};
+
+struct CornerHash
+{
+    size_t operator()(const Corner& corner) const
+    {
+        uint64_t h = static_cast<uint64_t>(corner.position) * 0x9E3779B97F4A7C15ull;
+        h ^= static_cast<uint64_t>(corner.uv) + 0x7F4A7C159E3779B9ull + (h << 6) + (h >> 2);
+        h ^= static_cast<uint64_t>(corner.normal) + 0x9E3779B97F4A7C15ull + (h << 6) + (h >> 2);
+        return static_cast<size_t>(h);
+    }
+};
+
+enum class LineType : uint8_t
+{
+    Position,
+    UV,
+    Normal,
+    Face,
+    Other
+};
+
+// Everything one chunk of the file contributes
+struct Chunk
+{
+    const char* begin;
+    const char* end;
+
+    // Counted by the first pass
+    int64_t positionCount = 0;
+    int64_t uvCount = 0;
+    int64_t normalCount = 0;
+    int64_t lineCount = 0;
+
+    // Where this chunk's records start in the file-wide arrays
+    int64_t firstPosition = 0;
+    int64_t firstUV = 0;
+    int64_t firstNormal = 0;
+    int64_t firstLine = 0;
+
+    // The faces, as runs of corners
+    std::vector<Corner> corners;
+    std::vector<uint32_t> faceSizes;
+
+    // The chunk's own vertices and triangles, indexed from 0
+    std::vector<Vertex> vertices;
+    std::vector<Triangle> triangles;
+    // For every vertex without a normal in the file, its position index
+    std::vector<std::pair<uint32_t, int64_t>> generatedNormals;
+
+    // The first problem found, by line within the chunk
+    int64_t errorLine = -1;
+    QString error;
+
+    void Fail(int64_t line, const QString& message)
+    {
+        if(errorLine < 0)
+        {
+            errorLine = line;
+            error = message;
+        }
+    }
+};
+
+bool IsSpace(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+const char* SkipSpaces(const char* p, const char* end)
+{
+    while(p < end && IsSpace(*p))
+    {
+        ++p;
+    }
+    return p;
+}
+
+const char* LineEnd(const char* p, const char* end)
+{
+    const char* newline = static_cast<const char*>(std::memchr(p, '\n', end - p));
+    return newline ? newline : end;
+}
+
+// Classifies the line starting at p and moves p past its keyword
+LineType ReadKeyword(const char*& p, const char* end)
+{
+    p = SkipSpaces(p, end);
+    if(end - p < 2)
+    {
+        return LineType::Other;
+    }
+    if(p[0] == 'f' && IsSpace(p[1]))
+    {
+        p += 1;
+        return LineType::Face;
+    }
+    if(p[0] != 'v')
+    {
+        return LineType::Other;
+    }
+    if(IsSpace(p[1]))
+    {
+        p += 1;
+        return LineType::Position;
+    }
+    if(end - p >= 3 && IsSpace(p[2]))
+    {
+        if(p[1] == 't')
+        {
+            p += 2;
+            return LineType::UV;
+        }
+        if(p[1] == 'n')
+        {
+            p += 2;
+            return LineType::Normal;
+        }
+    }
+    return LineType::Other;
+}
+
+// Reads a decimal number such as -1.25e-3 without going through the C
+// locale. Digits past the 19th only move the decimal point, which is far
+// beyond what a float can hold. The number must end at a space or the end
+// of the line, so 1.5abc is malformed rather than 1.5.
+bool ReadFloat(const char*& p, const char* end, float& value)
+{
+    static const double POWERS[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                                    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+    p = SkipSpaces(p, end);
+    bool negative = p < end && *p == '-';
+    if(p < end && (*p == '-' || *p == '+'))
+    {
+        ++p;
+    }
+
+    uint64_t mantissa = 0;
+    int digits = 0, exponent = 0;
+    bool any = false;
+    for(; p < end && *p >= '0' && *p <= '9'; ++p, any = true)
+    {
+        if(digits < 19)
+        {
+            mantissa = mantissa * 10 + (*p - '0');
+            digits += mantissa != 0;
+        }
+        else
+        {
+            ++exponent;
+        }
+    }
+    if(p < end && *p == '.')
+    {
+        for(++p; p < end && *p >= '0' && *p <= '9'; ++p, any = true)
+        {
+            if(digits < 19)
+            {
+                mantissa = mantissa * 10 + (*p - '0');
+                digits += mantissa != 0;
+                --exponent;
+            }
+        }
+    }
+    if(!any)
+    {
+        return false;
+    }
+    if(p < end && (*p == 'e' || *p == 'E'))
+    {
+        const char* q = p + 1;
+        bool negativeExponent = q < end && *q == '-';
+        if(q < end && (*q == '-' || *q == '+'))
+        {
+            ++q;
+        }
+        if(q < end && *q >= '0' && *q <= '9')
+        {
+            int e = 0;
+            for(; q < end && *q >= '0' && *q <= '9'; ++q)
+            {
+                e = std::min(e * 10 + (*q - '0'), 10000);
+            }
+            exponent += negativeExponent ? -e : e;
+            p = q;
+        }
+    }
+    if(p < end && !IsSpace(*p))
+    {
+        return false;
+    }
+
+    // Up to 2^53 and 10^22 both the mantissa and the power are exact
+    // doubles, so the one multiplication or division rounds only once.
+    // Longer mantissas round once more on conversion, and exponents past 22
+    // go through pow; both stay far within a float's precision.
+    double result = static_cast<double>(mantissa);
+    if(exponent >= 0 && exponent <= 22)
+    {
+        result *= POWERS[exponent];
+    }
+    else if(exponent < 0 && exponent >= -22)
+    {
+        result /= POWERS[-exponent];
+    }
+    else
+    {
+        result *= std::pow(10.0, exponent);
+    }
+    value = static_cast<float>(negative ? -result : result);
+    return true;
+}
+
+bool ReadInt(const char*& p, const char* end, int64_t& value)
+{
+    bool negative = p < end && *p == '-';
+    if(negative)
+    {
+        ++p;
+    }
+    if(p == end || *p < '0' || *p > '9')
+    {
+        return false;
+    }
+    value = 0;
+    for(; p < end && *p >= '0' && *p <= '9'; ++p)
+    {
+        value = std::min<int64_t>(value * 10 + (*p - '0'), INT64_C(1) << 40);
+    }
+    if(negative)
+    {
+        value = -value;
+    }
+    return true;
+}
+
+// OBJ indices count from 1, and negative ones count back from the last
+// record read before the face. Either way they may only refer to records
+// that come before the face.
+bool ResolveIndex(int64_t index, int64_t countSoFar, int64_t& resolved)
+{
+    resolved = index > 0 ? index - 1 : countSoFar + index;
+    return index != 0 && resolved >= 0 && resolved < countSoFar;
+}
+
+// Reads one corner: v, v/vt, v//vn or v/vt/vn
+bool ReadCorner(const char*& p, const char* end, const Chunk& chunk, int64_t positions, int64_t uvs,
+                int64_t normals, Corner& corner)
+{
+    int64_t index;
+    corner.uv = -1;
+    corner.normal = -1;
+    if(!ReadInt(p, end, index) || !ResolveIndex(index, chunk.firstPosition + positions, corner.position))
+    {
+        return false;
+    }
+    if(p == end || *p != '/')
+    {
+        return true;
+    }
+    ++p;
+    if(p < end && *p != '/')
+    {
+        if(!ReadInt(p, end, index) || !ResolveIndex(index, chunk.firstUV + uvs, corner.uv))
+        {
+            return false;
+        }
+    }
+    if(p == end || *p != '/')
+    {
+        return true;
+    }
+    ++p;
+    return ReadInt(p, end, index) && ResolveIndex(index, chunk.firstNormal + normals, corner.normal);
+}
+
+// First pass: how many of each record the chunk holds
+void CountRecords(Chunk& chunk)
+{
+    for(const char* line = chunk.begin; line < chunk.end;)
+    {
+        const char* lineEnd = LineEnd(line, chunk.end);
+        const char* p = line;
+        switch(ReadKeyword(p, lineEnd))
+        {
+        case LineType::Position: ++chunk.positionCount; break;
+        case LineType::UV: ++chunk.uvCount; break;
+        case LineType::Normal: ++chunk.normalCount; break;
+        default: break;
+        }
+        ++chunk.lineCount;
+        line = lineEnd + 1;
+    }
+}
+
+// Second pass: fills the chunk's part of the file-wide attribute arrays and
+// collects its faces
+void ParseRecords(Chunk& chunk, std::vector<glm::vec3>& positions, std::vector<glm::vec2>& uvs,
+                  std::vector<glm::vec3>& normals)
+{
+    int64_t positionCount = 0, uvCount = 0, normalCount = 0, lineNumber = 0;
+    for(const char* line = chunk.begin; line < chunk.end; ++lineNumber)
+    {
+        const char* lineEnd = LineEnd(line, chunk.end);
+        const char* p = line;
+        bool valid = true;
+        switch(ReadKeyword(p, lineEnd))
+        {
+        case LineType::Position:
+        {
+            glm::vec3& position = positions[chunk.firstPosition + positionCount++];
+            valid = ReadFloat(p, lineEnd, position.x) && ReadFloat(p, lineEnd, position.y)
+                    && ReadFloat(p, lineEnd, position.z);
+            break;
+        }
+        case LineType::UV:
+        {
+            // v may be left out, and a third (w) coordinate is allowed and
+            // ignored
+            glm::vec2& uv = uvs[chunk.firstUV + uvCount++];
+            valid = ReadFloat(p, lineEnd, uv.x);
+            p = SkipSpaces(p, lineEnd);
+            if(p == lineEnd || *p == '#')
+            {
+                uv.y = 0.f;
+            }
+            else if(valid)
+            {
+                valid = ReadFloat(p, lineEnd, uv.y);
+            }
+            break;
+        }
+        case LineType::Normal:
+        {
+            glm::vec3& normal = normals[chunk.firstNormal + normalCount++];
+            valid = ReadFloat(p, lineEnd, normal.x) && ReadFloat(p, lineEnd, normal.y)
+                    && ReadFloat(p, lineEnd, normal.z);
+            break;
+        }
+        case LineType::Face:
+        {
+            uint32_t size = 0;
+            for(p = SkipSpaces(p, lineEnd); p < lineEnd && *p != '#'; p = SkipSpaces(p, lineEnd), ++size)
+            {
+                Corner corner;
+                if(!ReadCorner(p, lineEnd, chunk, positionCount, uvCount, normalCount, corner)
+                   || (p < lineEnd && !IsSpace(*p)))
+                {
+                    chunk.Fail(lineNumber, "a face corner is malformed or refers to a missing vertex");
+                    break;
+                }
+                chunk.corners.push_back(corner);
+            }
+            if(chunk.errorLine < 0 && size < 3)
+            {
+                chunk.Fail(lineNumber, "a face needs at least three corners");
+            }
+            if(chunk.errorLine >= 0)
+            {
+                // Nothing after the first error is used
+                return;
+            }
+            chunk.faceSizes.push_back(size);
+            break;
+        }
+        case LineType::Other:
+            break;
+        }
+        if(!valid)
+        {
+            chunk.Fail(lineNumber, "a number is missing or malformed");
+            return;
+        }
+        line = lineEnd + 1;
+    }
+}
+
+// Third pass: merges identical corners into vertices and fans every face
+// into triangles
+void BuildVertices(Chunk& chunk, const std::vector<glm::vec3>& positions, const std::vector<glm::vec2>& uvs,
+                   const std::vector<glm::vec3>& normals)
+{
+    std::unordered_map<Corner, uint32_t, CornerHash> vertexOf;
+    vertexOf.reserve(chunk.corners.size());
+    std::vector<uint32_t> faceVertices;
+    size_t corner = 0;
+    for(uint32_t size : chunk.faceSizes)
+    {
+        faceVertices.clear();
+        for(uint32_t i = 0; i < size; ++i, ++corner)
+        {
+            const Corner& c = chunk.corners[corner];
+            auto inserted = vertexOf.insert(std::make_pair(c, static_cast<uint32_t>(chunk.vertices.size())));
+            if(inserted.second)
+            {
+                glm::vec2 uv = c.uv >= 0 ? uvs[c.uv] : glm::vec2(0.f);
+                glm::vec4 normal = c.normal >= 0 ? glm::vec4(normals[c.normal], 0.f) : glm::vec4(0.f);
+                if(c.normal < 0)
+                {
+                    chunk.generatedNormals.push_back(std::make_pair(inserted.first->second, c.position));
+                }
+                chunk.vertices.push_back(Vertex(glm::vec4(positions[c.position], 1.f),
+                                                glm::vec3(255.f, 255.f, 255.f), normal, uv));
+            }
+            faceVertices.push_back(inserted.first->second);
+        }
+        for(uint32_t i = 1; i + 1 < size; ++i)
+        {
+            Triangle t;
+            t.m_indices[0] = faceVertices[0];
+            t.m_indices[1] = faceVertices[i];
+            t.m_indices[2] = faceVertices[i + 1];
+            chunk.triangles.push_back(t);
+        }
+    }
+    // The corners are not needed any more
+    std::vector<Corner>().swap(chunk.corners);
+}
+
+// Splits [data, data + size) into chunks that end right after a newline
+std::vector<Chunk> SplitLines(const char* data, size_t size)
+{
+    size_t chunkCount = std::max<size_t>(1, std::min<size_t>(size / MIN_CHUNK_BYTES,
+                                                             WorkerCount() * CHUNKS_PER_WORKER));
+    std::vector<Chunk> chunks;
+    const char* end = data + size;
+    const char* begin = data;
+    for(size_t i = 1; i <= chunkCount && begin < end; ++i)
+    {
+        const char* split = i == chunkCount ? end : std::max(begin, data + size / chunkCount * i);
+        if(split < end)
+        {
+            split = LineEnd(split, end);
+            split = split < end ? split + 1 : end;
+        }
+        if(split > begin)
+        {
+            Chunk chunk;
+            chunk.begin = begin;
+            chunk.end = split;
+            chunks.push_back(std::move(chunk));
+        }
+        begin = split;
+    }
+    return chunks;
+}
+}
+
+bool ParseOBJ(const char* data, size_t size, std::vector<Vertex>& vertices, std::vector<Triangle>& triangles,
+              QString* error)
+{
+    std::vector<Chunk> chunks = SplitLines(data, size);
+    int chunkCount = static_cast<int>(chunks.size());
+    ParallelFor(chunkCount, [&](int c) {
+        CountRecords(chunks[c]);
+    });
+
+    int64_t positionCount = 0, uvCount = 0, normalCount = 0, lineCount = 0;
+    for(Chunk& chunk : chunks)
+    {
+        chunk.firstPosition = positionCount;
+        chunk.firstUV = uvCount;
+        chunk.firstNormal = normalCount;
+        chunk.firstLine = lineCount;
+        positionCount += chunk.positionCount;
+        uvCount += chunk.uvCount;
+        normalCount += chunk.normalCount;
+        lineCount += chunk.lineCount;
+    }
+
+    std::vector<glm::vec3> positions(positionCount);
+    std::vector<glm::vec2> uvs(uvCount);
+    std::vector<glm::vec3> normals(normalCount);
+    ParallelFor(chunkCount, [&](int c) {
+        ParseRecords(chunks[c], positions, uvs, normals);
+    });
+    ParallelFor(chunkCount, [&](int c) {
+        if(chunks[c].errorLine < 0)
+        {
+            BuildVertices(chunks[c], positions, uvs, normals);
+        }
+    });
+
+    for(const Chunk& chunk : chunks)
+    {
+        if(chunk.errorLine >= 0)
+        {
+            if(error)
+            {
+                *error = QString("line %1: %2").arg(static_cast<int>(chunk.firstLine + chunk.errorLine + 1))
+                                               .arg(chunk.error);
+            }
+            return false;
+        }
+    }
+
+    // Vertices without normals get the average of the faces around their
+    // position. Faces on either side of a chunk boundary share positions,
+    // so the sums are gathered over the whole file before any is used.
+    bool generateNormals = false;
+    for(const Chunk& chunk : chunks)
+    {
+        generateNormals |= !chunk.generatedNormals.empty();
+    }
+    if(generateNormals)
+    {
+        std::vector<glm::vec3> faceNormalSums(positionCount, glm::vec3(0.f));
+        std::vector<int64_t> positionOf;
+        for(const Chunk& chunk : chunks)
+        {
+            positionOf.assign(chunk.vertices.size(), -1);
+            for(const std::pair<uint32_t, int64_t>& generated : chunk.generatedNormals)
+            {
+                positionOf[generated.first] = generated.second;
+            }
+            for(const Triangle& t : chunk.triangles)
+            {
+                const glm::vec4& a = chunk.vertices[t.m_indices[0]].m_pos;
+                const glm::vec4& b = chunk.vertices[t.m_indices[1]].m_pos;
+                const glm::vec4& c = chunk.vertices[t.m_indices[2]].m_pos;
+                // Twice the triangle's area long, so large faces weigh more
+                glm::vec3 normal = glm::cross(glm::vec3(b - a), glm::vec3(c - a));
+                for(int v = 0; v < 3; ++v)
+                {
+                    if(positionOf[t.m_indices[v]] >= 0)
+                    {
+                        faceNormalSums[positionOf[t.m_indices[v]]] += normal;
+                    }
+                }
+            }
+        }
+        ParallelFor(chunkCount, [&](int c) {
+            for(const std::pair<uint32_t, int64_t>& generated : chunks[c].generatedNormals)
+            {
+                const glm::vec3& sum = faceNormalSums[generated.second];
+                float length = glm::length(sum);
+                chunks[c].vertices[generated.first].m_normal = length > 0.f ? glm::vec4(sum / length, 0.f)
+                                                                             : glm::vec4(0.f, 0.f, 1.f, 0.f);
+            }
+        });
+    }
+
+    size_t vertexCount = 0, triangleCount = 0;
+    std::vector<size_t> firstVertex(chunkCount), firstTriangle(chunkCount);
+    for(int c = 0; c < chunkCount; ++c)
+    {
+        firstVertex[c] = vertexCount;
+        firstTriangle[c] = triangleCount;
+        vertexCount += chunks[c].vertices.size();
+        triangleCount += chunks[c].triangles.size();
+    }
+    vertices.assign(vertexCount, Vertex(glm::vec4(), glm::vec3(), glm::vec4(), glm::vec2()));
+    triangles.resize(triangleCount);
+    ParallelFor(chunkCount, [&](int c) {
+        Chunk& chunk = chunks[c];
+        std::copy(chunk.vertices.begin(), chunk.vertices.end(), vertices.begin() + firstVertex[c]);
+        uint32_t offset = static_cast<uint32_t>(firstVertex[c]);
+        for(size_t i = 0; i < chunk.triangles.size(); ++i)
+        {
+            Triangle& t = triangles[firstTriangle[c] + i];
+            for(int v = 0; v < 3; ++v)
+            {
+                t.m_indices[v] = chunk.triangles[i].m_indices[v] + offset;
+            }
+        }
+    });
+    return true;
+}
+
+bool LoadOBJFile(const QString& filename, VertexBuffer& vertices, std::vector<Triangle>& triangles,
+                 VertexPrecision precision, QString* error)
+{
+    QFile file(filename);
+    if(!file.open(QIODevice::ReadOnly))
+    {
+        if(error)
+        {
+            *error = QString("Could not open the OBJ file %1.").arg(filename);
+        }
+        return false;
+    }
+
+    // Mapping lets the workers read straight from the page cache instead of
+    // waiting for the whole file to be copied into memory first
+    QByteArray contents;
+    const char* data = reinterpret_cast<const char*>(file.map(0, file.size()));
+    size_t size = static_cast<size_t>(file.size());
+    if(!data)
+    {
+        contents = file.readAll();
+        data = contents.constData();
+        size = static_cast<size_t>(contents.size());
+    }
+
+    QString parseError;
+    std::vector<Vertex> parsed;
+    std::vector<Triangle> parsedTriangles;
+    if(!ParseOBJ(data, size, parsed, parsedTriangles, &parseError))
+    {
+        if(error)
+        {
+            *error = QString("%1: %2").arg(filename, parseError);
+        }
+        return false;
+    }
+
+    vertices.Assign(parsed, precision);
+    std::vector<Vertex>().swap(parsed);
+    std::vector<uint32_t> remap = vertices.Deduplicate();
+    if(!remap.empty())
+    {
+        int blocks = static_cast<int>((parsedTriangles.size() + REMAP_BLOCK - 1) / REMAP_BLOCK);
+        ParallelFor(blocks, [&](int block) {
+            size_t end = std::min(parsedTriangles.size(), (block + 1) * REMAP_BLOCK);
+            for(size_t t = block * REMAP_BLOCK; t < end; ++t)
+            {
+                for(unsigned int& index : parsedTriangles[t].m_indices)
+                {
+                    index = remap[index];
+                }
+            }
+        });
+    }
+    triangles.swap(parsedTriangles);
+    ComputeTangents(vertices, triangles);
+    return true;
+}
+
+void ComputeTangents(VertexBuffer& vertices, const std::vector<Triangle>& triangles)
+{
+    std::vector<glm::vec3> tangentSums(vertices.size(), glm::vec3(0.f));
+    std::vector<glm::vec3> bitangentSums(vertices.size(), glm::vec3(0.f));
+    for(const Triangle& t : triangles)
+    {
+        glm::vec3 positions[3];
+        glm::vec2 uvs[3];
+        for(int v = 0; v < 3; ++v)
+        {
+            positions[v] = vertices.Position(t.m_indices[v]);
+            uvs[v] = vertices.UV(t.m_indices[v]);
+        }
+        // Solves edge = du * tangent + dv * bitangent for both edges from
+        // the first corner
+        glm::vec3 edge1 = positions[1] - positions[0], edge2 = positions[2] - positions[0];
+        glm::vec2 delta1 = uvs[1] - uvs[0], delta2 = uvs[2] - uvs[0];
+        float det = delta1.x * delta2.y - delta2.x * delta1.y;
+        if(det == 0.f)
+        {
+            continue;
+        }
+        glm::vec3 faceTangent = (edge1 * delta2.y - edge2 * delta1.y) / det;
+        glm::vec3 faceBitangent = (edge2 * delta1.x - edge1 * delta2.x) / det;
+        float bitangentLength = glm::length(faceBitangent);
+
+        for(int v = 0; v < 3; ++v)
+        {
+            unsigned int index = t.m_indices[v];
+            glm::vec3 toNext = positions[(v + 1) % 3] - positions[v];
+            glm::vec3 toPrevious = positions[(v + 2) % 3] - positions[v];
+            float lengths = glm::length(toNext) * glm::length(toPrevious);
+            if(lengths == 0.f)
+            {
+                continue;
+            }
+            // By angle, so a face counts the same however it was split into triangles
+            float angle = std::acos(glm::clamp(glm::dot(toNext, toPrevious) / lengths, -1.f, 1.f));
+            glm::vec3 normal = vertices.Normal(index);
+            glm::vec3 tangent = faceTangent - normal * glm::dot(normal, faceTangent);
+            float tangentLength = glm::length(tangent);
+            if(tangentLength > 0.f)
+            {
+                tangentSums[index] += tangent * (angle / tangentLength);
+            }
+            if(bitangentLength > 0.f)
+            {
+                bitangentSums[index] += faceBitangent * (angle / bitangentLength);
+            }
+        }
+    }
+
+    int blocks = static_cast<int>((vertices.size() + TANGENT_BLOCK - 1) / TANGENT_BLOCK);
+    ParallelFor(blocks, [&](int block) {
+        size_t end = std::min(vertices.size(), (block + 1) * TANGENT_BLOCK);
+        for(size_t i = block * TANGENT_BLOCK; i < end; ++i)
+        {
+            glm::vec3 normal = vertices.Normal(i);
+            glm::vec3 tangent = tangentSums[i] - normal * glm::dot(normal, tangentSums[i]);
+            float length = glm::length(tangent);
+            if(normal == glm::vec3(0.f) || length == 0.f)
+            {
+                vertices.SetTangent(i, glm::vec4(0.f));
+                continue;
+            }
+            float sign = glm::dot(glm::cross(normal, tangent), bitangentSums[i]) < 0.f ? -1.f : 1.f;
+            vertices.SetTangent(i, glm::vec4(tangent / length, sign));
+        }
+    });
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include <QString>
+#include <vector>
+#include "polygon.h"
+
+// Parses Wavefront OBJ geometry: v, vt and vn records and f records with any
+// number of corners, which are fanned into triangles. Other records (groups,
+// materials, smoothing) are ignored. Corners that share the same position,
+// uv and normal become one Vertex. Vertices without a normal get the
+// area-weighted average of the faces around them.
+//
+// The text is split into chunks at line boundaries and the chunks are parsed
+// in parallel. A first pass counts each chunk's records so every chunk knows
+// where its positions, uvs and normals land in the file-wide arrays, which
+// is what OBJ's absolute and relative indices refer to. Vertices are merged
+// within a chunk, so a corner shared by faces on both sides of a chunk
+// boundary is stored twice, with identical attributes.
+bool ParseOBJ(const char* data, size_t size, std::vector<Vertex>& vertices, std::vector<Triangle>& triangles,
+              QString* error = nullptr);
+
+// Maps the file into memory, parses it with ParseOBJ and packs the vertices
+// at the given precision. Vertices that pack to the same values are merged
+// afterwards, which also joins the copies made at chunk boundaries. Tangents
+// are computed last, from the merged mesh.
+bool LoadOBJFile(const QString& filename, VertexBuffer& vertices, std::vector<Triangle>& triangles,
+                 VertexPrecision precision = VertexPrecision::Quantized, QString* error = nullptr);
+
+// Gives every vertex the tangent its uvs imply, in the manner of MikkTSpace:
+// each face's directions of increasing u and v are projected into the
+// vertex's tangent plane and averaged over the faces around it, weighted by
+// the angle of their corners. The tangent is then made perpendicular to the
+// normal, and w records whether v increases along cross(normal, tangent) or
+// against it. Vertices without a normal, or whose faces all have degenerate
+// uvs, are left without a tangent.
+void ComputeTangents(VertexBuffer& vertices, const std::vector<Triangle>& triangles);
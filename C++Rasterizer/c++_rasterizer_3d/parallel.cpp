@@ -0,0 +1,79 @@
+#include "parallel.h"
+#include <QThreadPool>
+#include <atomic>
+#include <algorithm>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+
+namespace {
+// Shared between the caller and its helper tasks. Helpers that only get
+// scheduled after the caller has returned find the loop closed and exit
+// without touching the (by then destroyed) loop body.
+struct ParallelLoop
+{
+    const std::function<void(int)>* body;
+    int count;
+    std::atomic<int> next;
+    std::mutex mutex;
+    std::condition_variable idle;
+    int running;
+    bool closed;
+
+    ParallelLoop(const std::function<void(int)>* body, int count)
+        : body(body), count(count), next(0), mutex(), idle(), running(0), closed(false)
+    {}
+
+    void Drain()
+    {
+        for(int i = next++; i < count; i = next++)
+        {
+            (*body)(i);
+        }
+    }
+};
+}
+
+int WorkerCount()
+{
+    // The calling thread works alongside the pool
+    return QThreadPool::globalInstance()->maxThreadCount() + 1;
+}
+
+void ParallelFor(int count, const std::function<void(int)>& body)
+{
+    if(count <= 0)
+    {
+        return;
+    }
+
+    auto loop = std::make_shared<ParallelLoop>(&body, count);
+    int helpers = std::min(count, WorkerCount()) - 1;
+    for(int i = 0; i < helpers; ++i)
+    {
+        QThreadPool::globalInstance()->start([loop]() {
+            {
+                std::lock_guard<std::mutex> lock(loop->mutex);
+                if(loop->closed)
+                {
+                    return;
+                }
+                ++loop->running;
+            }
+            loop->Drain();
+            std::lock_guard<std::mutex> lock(loop->mutex);
+            if(--loop->running == 0)
+            {
+                loop->idle.notify_all();
+            }
+        });
+    }
+
+    loop->Drain();
+
+    // Never wait on helpers that have not started yet; the pool may be busy
+    // with the very task that called us.
+    std::unique_lock<std::mutex> lock(loop->mutex);
+    loop->closed = true;
+    loop->idle.wait(lock, [&]() { return loop->running == 0; });
+}
@@ -0,0 +1,12 @@
+#pragma once
+#include <functional>
+
+// Runs body(0) ... body(count - 1) on the global QThreadPool and blocks until
+// every index has been processed. Indices are handed out one at a time, so
+// uneven work items (e.g. screen tiles with different triangle counts)
+// balance themselves across the workers. The calling thread takes part in
+// the work, so this is also safe to call from inside a pool thread.
+void ParallelFor(int count, const std::function<void(int)>& body);
+
+// The number of threads ParallelFor spreads its work over
+int WorkerCount();
@@ -4,6 +4,10 @@
 void Polygon::Triangulate()
 {
     //TODO: Populate list of triangles
+    if (m_verts.size() < 3) {
+        return;
+    }
+    m_tris.reserve(m_tris.size() + m_verts.size() - 2);
     for (unsigned i = 0; i < m_verts.size() - 2; i++) {
         m_tris.push_back({{0, i + 1, i + 2}});
     }
@@ -89,32 +93,14 @@ Polygon::Polygon()
     : m_tris(), m_verts(), m_name("Polygon"), mp_texture(nullptr), mp_normalMap(nullptr)
 {}
 
-Polygon::Polygon(const Polygon& p)
-    : m_tris(p.m_tris), m_verts(p.m_verts), m_name(p.m_name), mp_texture(nullptr), mp_normalMap(nullptr)
-{
-    if(p.mp_texture != nullptr)
-    {
-        mp_texture = new QImage(*p.mp_texture);
-    }
-    if(p.mp_normalMap != nullptr)
-    {
-        mp_normalMap = new QImage(*p.mp_normalMap);
-    }
-}
-
-Polygon::~Polygon()
+void Polygon::SetTexture(std::shared_ptr<const QImage> i)
 {
-    delete mp_texture;
+    mp_texture = std::move(i);
 }
 
-void Polygon::SetTexture(QImage* i)
+void Polygon::SetNormalMap(std::shared_ptr<const QImage> i)
 {
-    mp_texture = i;
-}
-
-void Polygon::SetNormalMap(QImage* i)
-{
-    mp_normalMap = i;
+    mp_normalMap = std::move(i);
 }
 
 void Polygon::AddTriangle(const Triangle& t)
@@ -142,11 +128,6 @@ Triangle Polygon::TriAt(unsigned int i) const
     return m_tris[i];
 }
 
-Vertex &Polygon::VertAt(unsigned int i)
-{
-    return m_verts[i];
-}
-
 Vertex Polygon::VertAt(unsigned int i) const
 {
     return m_verts[i];
@@ -1,24 +1,11 @@
 #pragma once
 #include <glm/glm.hpp>
+#include <memory>
 #include <vector>
 #include <QString>
 #include <QImage>
 #include <QColor>
-
-// A Vertex is a point in space that defines one corner of a polygon.
-// Each Vertex has several attributes that determine how they contribute to the
-// appearance of their Polygon, such as coloration.
-struct Vertex
-{
-    glm::vec4 m_pos;    // The position of the vertex. In hw02, this is in pixel space.
-    glm::vec3 m_color;  // The color of the vertex. X corresponds to Red, Y corresponds to Green, and Z corresponds to Blue.
-    glm::vec4 m_normal; // The surface normal of the vertex (not yet used)
-    glm::vec2 m_uv;     // The texture coordinates of the vertex (not yet used)
-
-    Vertex(glm::vec4 p, glm::vec3 c, glm::vec4 n, glm::vec2 u)
-        : m_pos(p), m_color(c), m_normal(n), m_uv(u)
-    {}
-};
+#include "vertexbuffer.h"
 
 // Each Polygon can be decomposed into triangles that fill its area.
 struct Triangle
@@ -47,33 +34,41 @@ public:
     // TODO: Populate this list of triangles in Triangulate()
     std::vector<Triangle> m_tris;
     // The list of Vertices that define this polygon. This is already filled by the Polygon constructor.
-    std::vector<Vertex> m_verts;
+    // Meshes loaded from OBJ files keep them quantized (see VertexBuffer).
+    VertexBuffer m_verts;
     // The name of this polygon, primarily to help you debug
     QString m_name;
     // The image that can be read to determine pixel color when used in conjunction with UV coordinates
     // Not used until homework 3.
-    QImage* mp_texture;
+    // Images are shared, not owned: every polygon textured with the same file
+    // points at the same QImage (see TextureCache), and copying a Polygon only
+    // copies the handle. The image is freed with the last polygon holding it.
+    std::shared_ptr<const QImage> mp_texture;
     // The image that can be read to determine surface normal offset when used in conjunction with UV coordinates
     // Not used until homework 3
-    QImage* mp_normalMap;
+    std::shared_ptr<const QImage> mp_normalMap;
 
     // Polygon class constructors
     Polygon(const QString& name, const std::vector<glm::vec4>& pos, const std::vector<glm::vec3> &col);
     Polygon(const QString& name, int sides, glm::vec3 color, glm::vec4 pos, float rot, glm::vec4 scale);
     Polygon(const QString& name);
     Polygon();
-    Polygon(const Polygon& p);
-    ~Polygon();
+    // Copies duplicate the vertices and triangles but share the images.
+    // Moves take everything, so a growing std::vector<Polygon> never copies.
+    Polygon(const Polygon& p) = default;
+    Polygon(Polygon&& p) = default;
+    Polygon& operator=(const Polygon& p) = default;
+    Polygon& operator=(Polygon&& p) = default;
 
     // TODO: Complete the body of Triangulate() in polygon.cpp
     // Creates a set of triangles that, when combined, fill the area of this convex polygon.
     void Triangulate();
 
-    // Copies the input QImage into this Polygon's texture
-    void SetTexture(QImage*);
+    // Shares the input QImage as this Polygon's texture
+    void SetTexture(std::shared_ptr<const QImage>);
 
-    // Copies the input QImage into this Polygon's normal map
-    void SetNormalMap(QImage*);
+    // Shares the input QImage as this Polygon's normal map
+    void SetNormalMap(std::shared_ptr<const QImage>);
 
     // Various getter, setter, and adder functions
     void AddVertex(const Vertex&);
@@ -83,7 +78,6 @@ public:
     Triangle& TriAt(unsigned int);
     Triangle TriAt(unsigned int) const;
 
-    Vertex& VertAt(unsigned int);
     Vertex VertAt(unsigned int) const;
 };
 
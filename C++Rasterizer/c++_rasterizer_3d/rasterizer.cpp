@@ -3,15 +3,43 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtx/string_cast.hpp>
+#include "parallel.h"
+#include "coverage.h"
+#include "hizbuffer.h"
+#include "vertexstage.h"
+#include "clipper.h"
+#include <QElapsedTimer>
+#include <algorithm>
 #include <iostream>
+#include <map>
+#include <cmath>
 
 // Helper Function
-glm::vec3 BarycentricCoords(const glm::vec2& P, const glm::vec2& P1, const glm::vec2& P2, const glm::vec2& P3) {
+// The barycentric coordinates of a pixel are affine functions of its position,
+// so instead of solving for them at every pixel we compute their value at one
+// pixel and how much they change per step in x and in y. Each step rounds,
+// so the stepped values differ from solving at the pixel in the last few
+// bits: colors may move by a few levels and samples exactly on an edge may
+// change sides. Returns false for triangles with no area.
+bool BarycentricGradients(const glm::vec2& origin, const glm::vec2& P1, const glm::vec2& P2, const glm::vec2& P3,
+                          glm::vec3& atOrigin, glm::vec3& dx, glm::vec3& dy) {
+    float denom = (P2.y - P3.y) * (P1.x - P3.x) + (P3.x - P2.x) * (P1.y - P3.y);
+    if (denom == 0.f || !std::isfinite(denom)) {
+        return false;
+    }
+    float invDenom = 1.f / denom;
+
+    dx.x = (P2.y - P3.y) * invDenom;
+    dy.x = (P3.x - P2.x) * invDenom;
+    dx.y = (P3.y - P1.y) * invDenom;
+    dy.y = (P1.x - P3.x) * invDenom;
+    dx.z = -dx.x - dx.y;
+    dy.z = -dy.x - dy.y;
 
-    float alpha = ((P2.y - P3.y) * (P.x - P3.x) + (P3.x - P2.x) * (P.y - P3.y)) / ((P2.y - P3.y) * (P1.x - P3.x) + (P3.x - P2.x) * (P1.y - P3.y));
-    float beta = ((P3.y - P1.y) * (P.x - P3.x) + (P1.x - P3.x) * (P.y - P3.y)) / ((P2.y - P3.y) * (P1.x - P3.x) + (P3.x - P2.x) * (P1.y - P3.y));
-    float gamma = 1.0f - alpha - beta;
-    return glm::vec3(alpha, beta, gamma);
+    atOrigin.x = ((P2.y - P3.y) * (origin.x - P3.x) + (P3.x - P2.x) * (origin.y - P3.y)) * invDenom;
+    atOrigin.y = ((P3.y - P1.y) * (origin.x - P3.x) + (P1.x - P3.x) * (origin.y - P3.y)) * invDenom;
+    atOrigin.z = 1.0f - atOrigin.x - atOrigin.y;
+    return true;
 }
 
 glm::vec3 createZInv(const glm::vec3 Zvalue) {
@@ -25,19 +53,81 @@ float InterpolateZ(const glm::vec3& zInv,
     return 1.f / (glm::dot(zInv, BarycentricCoords));
 }
 
-Rasterizer::Rasterizer(const std::vector<Polygon>& polygons)
-    : m_polygons(polygons)
-{}
+Rasterizer::Rasterizer(std::vector<Polygon> polygons)
+    : m_polygons(std::move(polygons)), m_geometryVersion(0)
+{
+    BuildTextures();
+    m_bvh.Build(m_polygons);
+}
+
+// Builds the sampling-ready textures of every polygon. Copies of a QImage
+// share its data and its cache key, so polygons that were given the same
+// image, or copies of it, also share one Texture.
+void Rasterizer::BuildTextures()
+{
+    std::map<qint64, std::shared_ptr<const Texture>> built;
+    auto textureFor = [&](const std::shared_ptr<const QImage>& image) {
+        std::shared_ptr<const Texture> texture;
+        if (image != nullptr) {
+            std::shared_ptr<const Texture>& cached = built[image->cacheKey()];
+            if (!cached) {
+                cached = std::make_shared<const Texture>(*image);
+            }
+            texture = cached;
+        }
+        return texture;
+    };
+
+    m_textures.clear();
+    m_normalMaps.clear();
+    for (const Polygon& polygon : m_polygons) {
+        m_textures.push_back(textureFor(polygon.mp_texture));
+        m_normalMaps.push_back(textureFor(polygon.mp_normalMap));
+    }
+}
 
 Camera& Rasterizer::GetCamera() {
     return m_camera;
 }
 
+const RenderStats& Rasterizer::GetRenderStats() const {
+    return m_stats;
+}
+
+int Rasterizer::PolygonCount() const {
+    return static_cast<int>(m_polygons.size());
+}
+
+Polygon& Rasterizer::GetPolygon(int index) {
+    return m_polygons[index];
+}
+
+void Rasterizer::RefitBVH() {
+    m_bvh.Refit(m_polygons);
+    ++m_geometryVersion;
+}
+
+void Rasterizer::RebuildBVH() {
+    m_bvh.Build(m_polygons);
+    m_wasVisible.clear();
+    ++m_geometryVersion;
+}
+
 void Rasterizer::setShadingModel(ShadingModel inShadingModel)
 {
     shadingModel = inShadingModel;
 }
 
+void Rasterizer::setRenderPath(RenderPath inRenderPath)
+{
+    renderPath = inRenderPath;
+}
+
+void Rasterizer::setTextureFilter(TextureFilter inTextureFilter)
+{
+    textureFilter = inTextureFilter;
+}
+
 glm::vec2 interpolateUV(const glm::vec2& UV1, const glm::vec2& UV2, const glm::vec2& UV3,
                         const glm::vec3& bcCoords,
                         const glm::vec3 zInv,
@@ -48,14 +138,10 @@ glm::vec2 interpolateUV(const glm::vec2& UV1, const glm::vec2& UV2, const glm::v
     return z * (uvs * (zInv * bcCoords));
 }
 
-glm::vec3 interpolateNormal(const glm::vec4& normal1, const glm::vec4& normal2, const glm::vec4& normal3,
+glm::vec3 interpolateNormal(const glm::vec3& n1, const glm::vec3& n2, const glm::vec3& n3,
                             const glm::vec3& bcCoords,
                             const glm::vec3 zInv,
                             const float z) {
-    glm::vec3 n1 = glm::vec3(normal1);
-    glm::vec3 n2 = glm::vec3(normal2);
-    glm::vec3 n3 = glm::vec3(normal3);
-
     const glm::mat3x3 normals(n1, n2, n3);
 
     return z * (normals * (zInv * bcCoords));
@@ -67,205 +153,1234 @@ QRgb ClampColor(const glm::vec3& color) {
                 glm::clamp(color.z, 0.f, 255.f));
 }
 
-glm::mat3 createTangentMatrix(glm::vec3 normal) {
-    glm::vec3 tangent = glm::cross(glm::vec3(0, 1, 0), normal);
-    if (glm::length(tangent) < 0.0001f)
-        tangent = glm::cross(glm::vec3(1, 0, 0), normal);
-    tangent = glm::normalize(tangent);
+glm::vec3 getTangentNormal(glm::vec2 uv, const glm::vec2& dUVdx, const glm::vec2& dUVdy,
+                           const Texture& normalMap, TextureFilter filter) {
+    glm::vec3 color = normalMap.Sample(uv, dUVdx, dUVdy, filter);
+    glm::vec3 tangentNormal = glm::vec3(
+        (color.x / 255.0f) * 2.0f - 1.0f,
+        (color.y / 255.0f) * 2.0f - 1.0f,
+        (color.z / 255.0f) * 2.0f - 1.0f
+        );
+    tangentNormal = glm::normalize(tangentNormal);
 
-    glm::vec3 bitangent = glm::cross(normal, tangent);
-    bitangent = glm::normalize(bitangent);
+    return tangentNormal;
+}
 
-    glm::mat3 result = {
-                        tangent,
-                        bitangent,
-                        normal
-                        };
+// A triangle after projection, as produced by the binning front end.
+// Its pixel bounds are already clamped to the screen; tiles clip them further.
+struct TriangleSetup {
+    const Polygon* polygon;
+    const Triangle* triangle;
+    // The polygon's images, ready for sampling; null when it has none
+    const Texture* texture;
+    const Texture* normalMap;
+    // The corners' attributes, unpacked from the polygon's vertex buffer once
+    // per triangle rather than once per pixel
+    glm::mat3x2 uvs;
+    glm::mat3 normals;
+    // The corners' tangent frames, when the triangle is normal mapped; the
+    // bitangents already carry the sign of the tangents' w
+    glm::mat3 tangents;
+    glm::mat3 bitangents;
+    glm::vec2 pixelSpaceVertices[3];
+    glm::vec3 zInv;
+    int minX, maxX, minY, maxY;
+    // Barycentric coordinates at pixel (minX, minY) and their per-pixel steps
+    glm::vec3 baryOrigin;
+    glm::vec3 baryDX;
+    glm::vec3 baryDY;
+    // Range of the interpolated depth. Clipping keeps every corner in front
+    // of the camera, so the corners' depths bound every pixel's depth.
+    float minZ, maxZ;
+    // Index of this setup within the frame; this is what the visibility
+    // buffer stores to identify the polygon and triangle seen in a pixel
+    uint32_t id;
+    // Set when this is a piece of a triangle that was cut by clipping. The
+    // columns of sourceBary then locate its corners inside the original
+    // triangle, whose vertices still provide the attributes.
+    bool clipped;
+    glm::mat3 sourceBary;
+};
 
+// How far past the screen edges, in normalized device coordinates, triangles
+// may reach before they are clipped. Inside this band the edge functions stay
+// precise and bounding boxes are clamped to the screen anyway.
+const float GUARD_BAND = 8.f;
 
-    return result;
+// Marks visibility buffer samples that no triangle covers
+const uint32_t NO_TRIANGLE = std::numeric_limits<uint32_t>::max();
+
+// Anti-aliasing takes up to a 4x4 grid of coverage and depth samples per pixel
+const int MAX_SAMPLE_GRID = 4;
+const int MAX_SAMPLES = MAX_SAMPLE_GRID * MAX_SAMPLE_GRID;
+
+// Everything the tile workers need to know about the frame being rendered
+struct FrameContext {
+    glm::vec3 eye;
+    // The world-space offset from the eye to view depth 1 along the ray
+    // through pixel (0, 0), and how it changes per pixel in x and in y
+    glm::vec3 rayOrigin;
+    glm::vec3 rayDX;
+    glm::vec3 rayDY;
+    const LightGrid* lights;
+    glm::vec3 ambient;
+    float shininess;
+    ShadingModel shadingModel;
+    TextureFilter textureFilter;
+    int width;
+    int height;
+    // Every pixel owns `samples` consecutive entries in the color, depth and
+    // visibility buffers. sampleOffsets locate the samples relative to the
+    // pixel's position, and none of them is further than sampleReach from it
+    // along either axis.
+    int samples;
+    glm::vec2 sampleOffsets[MAX_SAMPLES];
+    float sampleReach;
+    QRgb* colors;
+    float* zBuffer;
+    HiZBuffer* hiZ;
+    uint32_t* visibility;
+};
+
+// The pixels of one screen tile, plus which of their samples the shading pass
+// of the depth pre-pass path has already shaded
+struct TileContext {
+    int minX, maxX, minY, maxY;
+    std::vector<bool> shaded;
+};
+
+// What RasterizeTriangle does with the pixels a triangle covers
+enum class RasterPass : uint8_t
+{
+    DepthAndShade, // Depth test, then shade the pixels with samples that pass
+    DepthOnly,     // Depth test and write depth; no attribute work at all
+    ShadeVisible,  // Shade exactly the samples whose final depth this triangle produced
+    DepthAndId     // Depth test and record which triangle is visible; shading happens later
+};
+
+// Sets up a triangle from its pixel-space corners and view depths. Returns
+// false when its clamped bounding box does not cover any pixel, or when it
+// faces away from the camera and backfaces are culled. The bounding box is
+// grown by sampleReach so it includes every pixel with a sample inside.
+bool SetupTriangle(const glm::vec2 pixelSpaceVertices[3], const glm::vec3& ZValue,
+                   int width, int height, float sampleReach, bool cullBackFaces,
+                   TriangleSetup& setup) {
+    for (int i = 0; i < 3; ++i) {
+        setup.pixelSpaceVertices[i] = pixelSpaceVertices[i];
+    }
+
+    // Counter-clockwise in normalized device coordinates is front facing;
+    // pixel space flips y, which flips the sign
+    if (cullBackFaces) {
+        const glm::vec2* v = pixelSpaceVertices;
+        float area = (v[1].x - v[0].x) * (v[2].y - v[0].y) - (v[2].x - v[0].x) * (v[1].y - v[0].y);
+        if (area >= 0) {
+            return false;
+        }
+    }
+
+    setup.zInv = createZInv(ZValue);
+
+    setup.minZ = std::min({ZValue[0], ZValue[1], ZValue[2]});
+    setup.maxZ = std::max({ZValue[0], ZValue[1], ZValue[2]});
+
+    const glm::vec2* v = setup.pixelSpaceVertices;
+
+    // Bounding Box
+    float minX = std::min({v[0].x, v[1].x, v[2].x});
+    float maxX = std::max({v[0].x, v[1].x, v[2].x});
+    float minY = std::min({v[0].y, v[1].y, v[2].y});
+    float maxY = std::max({v[0].y, v[1].y, v[2].y});
+
+    // Clamp to screen bounds
+    minX = std::max(minX - sampleReach, 0.0f);
+    maxX = std::min(maxX + sampleReach, static_cast<float>(width - 1));
+    minY = std::max(minY - sampleReach, 0.0f);
+    maxY = std::min(maxY + sampleReach, static_cast<float>(height - 1));
+
+    setup.minX = static_cast<int>(minX);
+    setup.maxX = static_cast<int>(maxX);
+    setup.minY = static_cast<int>(minY);
+    setup.maxY = static_cast<int>(maxY);
+
+    if (setup.minX > setup.maxX || setup.minY > setup.maxY) {
+        return false;
+    }
+
+    return BarycentricGradients(glm::vec2(setup.minX, setup.minY), v[0], v[1], v[2],
+                                setup.baryOrigin, setup.baryDX, setup.baryDY);
 }
 
-glm::vec3 getTangentNormal(glm::vec2 uv, QImage* normalMap) {
-    int X = glm::min(normalMap->width() * uv.x, normalMap->width() - 1.0f);
-    int Y = glm::min(normalMap->height() * (1.0f - uv.y), normalMap->height() - 1.0f);
-    QColor color = normalMap->pixel(X, Y);
-    glm::vec3 tangentNormal = glm::vec3(
-        (color.red() / 255.0f) * 2.0f - 1.0f,
-        (color.green() / 255.0f) * 2.0f - 1.0f,
-        (color.blue() / 255.0f) * 2.0f - 1.0f
-        );
-    tangentNormal = glm::normalize(tangentNormal);
+// How much perspective-correct UVs change per pixel step. uvs * weights / z
+// is the UV itself, and weightStep is how the weights change over the step.
+glm::vec2 UVDerivative(const glm::mat3x2& uvs, const glm::vec2& uv, const glm::vec3& weightStep, float z) {
+    return z * (uvs * weightStep - uv * (weightStep.x + weightStep.y + weightStep.z));
+}
 
-    return tangentNormal;
+// Computes the color of a covered pixel whose depth test has already passed
+QRgb ShadeFragment(const TriangleSetup& setup, const FrameContext& frame,
+                   int x, int y, const glm::vec3& pieceBarycentricCoords, float z) {
+    glm::vec3 barycentricCoords = pieceBarycentricCoords;
+    glm::vec3 zInv = setup.zInv;
+    // Perspective-correct interpolation weights change by these per pixel
+    glm::vec3 weightDX = zInv * setup.baryDX;
+    glm::vec3 weightDY = zInv * setup.baryDY;
+    if (setup.clipped) {
+        // Map to the original triangle; the perspective division is folded
+        // into the weights, so the attributes are interpolated with unit zInv
+        barycentricCoords = setup.sourceBary * (zInv * pieceBarycentricCoords);
+        weightDX = setup.sourceBary * weightDX;
+        weightDY = setup.sourceBary * weightDY;
+        zInv = glm::vec3(1.f);
+    }
+
+    const glm::mat3x2& uvs = setup.uvs;
+    glm::vec2 uv = interpolateUV(uvs[0], uvs[1], uvs[2],
+                                 barycentricCoords, zInv, z);
+
+    // The UV footprint of the pixel, which selects the textures' mip levels
+    glm::vec2 dUVdx = UVDerivative(uvs, uv, weightDX, z);
+    glm::vec2 dUVdy = UVDerivative(uvs, uv, weightDY, z);
+
+    const glm::mat3& normals = setup.normals;
+    glm::vec3 normal = interpolateNormal(normals[0], normals[1], normals[2],
+                                         barycentricCoords, zInv, z);
+
+    // Using Normal Map
+    if(setup.normalMap != nullptr) {
+        // The tangent frame is interpolated like the normal, so turning the
+        // map's normal into it takes one multiply
+        glm::vec3 weights = z * (zInv * barycentricCoords);
+        glm::mat3 tangentSpaceMatrix(setup.tangents * weights, setup.bitangents * weights, normal);
+        glm::vec3 normalTangentSpace = getTangentNormal(uv, dUVdx, dUVdy, *setup.normalMap, frame.textureFilter);
+        normal = glm::normalize(tangentSpaceMatrix * normalTangentSpace);
+    }
+
+    // The pixel's world-space position, from its view depth along the camera ray through it
+    glm::vec3 position = frame.eye + z * (frame.rayOrigin + static_cast<float>(x) * frame.rayDX
+                                                          + static_cast<float>(y) * frame.rayDY);
+
+    glm::vec3 viewDir = glm::normalize(frame.eye - position);
+
+    // get color from texture
+    glm::vec3 color = setup.texture != nullptr
+                    ? setup.texture->Sample(uv, dUVdx, dUVdy, frame.textureFilter)
+                    : glm::vec3(255.f, 255.f, 255.f);
+
+    glm::vec3 diffuse = glm::vec3(0.0f);
+    glm::vec3 specular = glm::vec3(0.0f);
+
+    // Only the lights binned into this pixel's tile can reach it
+    const uint32_t* light;
+    const uint32_t* lastLight;
+    frame.lights->TileLights(x, y, light, lastLight);
+    for (; light != lastLight; ++light) {
+        glm::vec3 lightDir, radiance;
+        if (!frame.lights->Illuminate(*light, position, normal, lightDir, radiance)) {
+            continue;
+        }
+
+        // Lambert law
+        diffuse += std::max(glm::dot(normal, lightDir), 0.0f) * radiance;
+
+        if (frame.shadingModel == ShadingModel::BlinnPhong)
+        {
+            glm::vec3 halfwayDir = glm::normalize(viewDir + lightDir);
+            specular += std::pow(std::max(glm::dot(normal, halfwayDir), 0.0f), frame.shininess) * radiance;
+        }
+        else if (frame.shadingModel == ShadingModel::Phong)
+        {
+            glm::vec3 reflectDir = glm::reflect(-lightDir, normal);
+            specular += std::pow(std::max(glm::dot(viewDir, reflectDir), 0.0f), frame.shininess) * radiance;
+        }
+    }
+
+    color *= (diffuse + frame.ambient + specular);
+
+    return ClampColor(color);
 }
 
-// Rasterization Main Logic
-QImage Rasterizer::RenderScene() {
-    int scalingResolution = 512 * scalingFactor;
+// How much a triangle's barycentric coordinates change from a pixel's
+// position to the sample at the given offset from it
+glm::vec3 SampleStep(const TriangleSetup& setup, const glm::vec2& offset) {
+    return offset.x * setup.baryDX + offset.y * setup.baryDY;
+}
 
-    QImage result(scalingResolution, scalingResolution, QImage::Format_RGB32);
-    result.fill(qRgb(0, 0, 0)); // Fill with black
-    std::vector<float> zBuffer(result.width() * result.height(), std::numeric_limits<float>::max());
+// The barycentric coordinates of a sample, evaluated with exactly the same
+// operations the block walk in RasterizeTriangle uses, so shading a sample
+// later yields the same values as shading it during rasterization
+glm::vec3 BarycentricAt(const TriangleSetup& setup, int x, int y, const glm::vec2& sampleOffset) {
+    int blockX = x - x % COVERAGE_BLOCK_SIZE;
+    int blockY = y - y % COVERAGE_BLOCK_SIZE;
+    glm::vec3 corner = setup.baryOrigin
+                     + static_cast<float>(blockX - setup.minX) * setup.baryDX
+                     + static_cast<float>(blockY - setup.minY) * setup.baryDY;
+    glm::vec3 rowStart = corner + static_cast<float>(y - blockY) * setup.baryDY;
+    glm::vec3 sampleRow = rowStart + SampleStep(setup, sampleOffset);
+    return sampleRow + static_cast<float>(x - blockX) * setup.baryDX;
+}
 
-    glm::mat4 projectionMatrix = m_camera.GetPerspectiveMatrix();
-    glm::mat4 viewMatrix = m_camera.GetViewMatrix();
+static_assert(COVERAGE_BLOCK_SIZE == HiZBuffer::BLOCK_SIZE, "Coverage blocks and HiZ blocks must line up");
+
+// Rasterizes the part of one triangle that falls inside the given tile.
+// The tile is walked in 8x8 blocks. Blocks the triangle misses are skipped
+// from their corners alone, blocks the hierarchical z-buffer proves hidden
+// are skipped before any per-pixel work, and the remaining rows are tested
+// eight pixels at a time with the incrementally stepped edge functions.
+// Coverage and depth are resolved per sample, but a pixel is shaded at most
+// once per triangle and its color is stored in every sample the triangle won.
+template <RasterPass pass>
+void RasterizeTriangle(const TriangleSetup& setup, const FrameContext& frame, TileContext& tile) {
+    int minX = std::max(setup.minX, tile.minX);
+    int maxX = std::min(setup.maxX, tile.maxX);
+    int minY = std::max(setup.minY, tile.minY);
+    int maxY = std::min(setup.maxY, tile.maxY);
+
+    // Reject the whole triangle when it is behind everything already in this
+    // part of the tile. When shading visible pixels, a triangle exactly at the
+    // stored depth may still own some of them.
+    float hiddenBeyond = frame.hiZ->MaxDepth(minX, maxX, minY, maxY);
+    if (pass == RasterPass::ShadeVisible ? setup.minZ > hiddenBeyond : setup.minZ >= hiddenBeyond) {
+        return;
+    }
+
+    const glm::vec3& dx = setup.baryDX;
+    const glm::vec3& dy = setup.baryDY;
+    const glm::vec3& zInv = setup.zInv;
+    const int last = COVERAGE_BLOCK_SIZE - 1;
+    const int samples = frame.samples;
+    const int tileWidth = tile.maxX - tile.minX + 1;
+
+    glm::vec3 sampleStep[MAX_SAMPLES];
+    for (int s = 0; s < samples; ++s) {
+        sampleStep[s] = SampleStep(setup, frame.sampleOffsets[s]);
+    }
+    // The block's corners, pushed out to where its outermost samples lie
+    const float outerFirst = -frame.sampleReach;
+    const float outerLast = last + frame.sampleReach;
+
+    // Blocks are aligned to the block grid so neighbouring triangles agree on them
+    for (int blockY = minY - minY % COVERAGE_BLOCK_SIZE; blockY <= maxY; blockY += COVERAGE_BLOCK_SIZE) {
+        int y0 = std::max(blockY, minY);
+        int y1 = std::min(blockY + last, maxY);
+        for (int blockX = minX - minX % COVERAGE_BLOCK_SIZE; blockX <= maxX; blockX += COVERAGE_BLOCK_SIZE) {
+            int x0 = std::max(blockX, minX);
+            int x1 = std::min(blockX + last, maxX);
+
+            int hiZX = blockX / COVERAGE_BLOCK_SIZE;
+            int hiZY = blockY / COVERAGE_BLOCK_SIZE;
+            float blockMax = frame.hiZ->BlockMax(hiZX, hiZY);
+            if (pass == RasterPass::ShadeVisible ? setup.minZ > blockMax : setup.minZ >= blockMax) {
+                continue;
+            }
+            // In front of everything in the block: every covered sample passes
+            bool inFront = pass != RasterPass::ShadeVisible && setup.maxZ < frame.hiZ->BlockMin(hiZX, hiZY);
 
-    auto lightDir = -m_camera.GetForward();
-    // glm::vec3 forwardInCameraSpace = -m_camera.GetForward(); // This is your camera forward vector in camera space
-    // glm::mat4 inverseViewMatrix = glm::inverse(viewMatrix);
-
-    // // Convert the forward vector to a 4D vector for matrix multiplication, assuming no translation component
-    // glm::vec4 forwardInCameraSpace4D = glm::vec4(forwardInCameraSpace, 0.0f);
-
-    // // Transform the forward vector back to world space
-    // glm::vec4 forwardInWorldSpace4D = inverseViewMatrix * forwardInCameraSpace4D;
-
-    // // Convert back to a 3D vector
-    // glm::vec3 lightDir = glm::vec3(forwardInWorldSpace4D);
-
-    auto eye = m_camera.GetPosition();
-
-    glm::vec3 ambient(0.3f);
-    glm::vec3 lightColor(1.0f);
-    float shininess = 32.0f;
-
-    for (const auto& polygon : m_polygons) {
-        for (const auto& triangle : polygon.m_tris) {
-            std::vector<glm::vec4> pixelSpaceVertices(3);
-            glm::vec3 ZValue;
-            for (int i = 0; i < 3; ++i) {
-                glm::vec4 cameraSpace = viewMatrix * polygon.VertAt(triangle.m_indices[i]).m_pos;
-                glm::vec4 screenSpace = projectionMatrix * cameraSpace;
-                screenSpace.w = cameraSpace.z;
-                glm::vec3 pixelSpace = glm::vec3(screenSpace) / screenSpace.w;
-                pixelSpaceVertices[i].x = (pixelSpace.x + 1) * 0.5f * result.width();
-                pixelSpaceVertices[i].y = (1 - pixelSpace.y) * 0.5f * result.height();
-                ZValue[i] = screenSpace.w;
+            glm::vec3 corner = setup.baryOrigin
+                             + static_cast<float>(blockX - setup.minX) * dx
+                             + static_cast<float>(blockY - setup.minY) * dy;
+            int coverage = ClassifyBlock(corner + outerFirst * (dx + dy), corner + outerLast * dx + outerFirst * dy,
+                                         corner + outerFirst * dx + outerLast * dy, corner + outerLast * (dx + dy));
+            if (coverage < 0) {
+                continue;
             }
 
-            glm::vec3 zInv = createZInv(ZValue);
+            // Only the pixels of this block that lie within the tile and the bounding box
+            int columns = ((1 << (x1 - x0 + 1)) - 1) << (x0 - blockX);
+            bool depthWritten = false;
 
-            // Bounding Box
-            float minX = std::min({pixelSpaceVertices[0].x, pixelSpaceVertices[1].x, pixelSpaceVertices[2].x});
-            float maxX = std::max({pixelSpaceVertices[0].x, pixelSpaceVertices[1].x, pixelSpaceVertices[2].x});
-            float minY = std::min({pixelSpaceVertices[0].y, pixelSpaceVertices[1].y, pixelSpaceVertices[2].y});
-            float maxY = std::max({pixelSpaceVertices[0].y, pixelSpaceVertices[1].y, pixelSpaceVertices[2].y});
+            for (int y = y0; y <= y1; ++y) {
+                float* depthLine = frame.zBuffer + y * frame.width * samples;
+                glm::vec3 rowStart = corner + static_cast<float>(y - blockY) * dy;
 
-            // Clamp to screen bounds
-            minX = std::max(minX, 0.0f);
-            maxX = std::min(maxX, static_cast<float>(result.width() - 1));
-            minY = std::max(minY, 0.0f);
-            maxY = std::min(maxY, static_cast<float>(result.height() - 1));
+                // One coverage mask over the row's eight pixels per sample position
+                glm::vec3 sampleRow[MAX_SAMPLES];
+                int sampleMask[MAX_SAMPLES];
+                int mask = 0;
+                for (int s = 0; s < samples; ++s) {
+                    sampleRow[s] = rowStart + sampleStep[s];
+                    sampleMask[s] = columns;
+                    if (coverage == 0) {
+                        sampleMask[s] &= CoverageMask8(sampleRow[s], dx);
+                    }
+                    mask |= sampleMask[s];
+                }
 
-            // Rasterize
-            for (int y = static_cast<int>(minY); y <= static_cast<int>(maxY); ++y) {
-                for (int x = static_cast<int>(minX); x <= static_cast<int>(maxX); ++x) {
-                    // Create pixel P
-                    glm::vec2 P(x, y);
-                    glm::vec3 barycentricCoords = BarycentricCoords(P, glm::vec2(pixelSpaceVertices[0]), glm::vec2(pixelSpaceVertices[1]), glm::vec2(pixelSpaceVertices[2]));
+                while (mask != 0) {
+                    int i = CountTrailingZeros(mask);
+                    mask &= mask - 1;
+                    int x = blockX + i;
+                    float* depth = depthLine + x * samples;
+                    int local = ((x - tile.minX) + (y - tile.minY) * tileWidth) * samples;
 
-                    if (barycentricCoords.x >= 0 && barycentricCoords.y >= 0 && barycentricCoords.z >= 0) {
+                    // The samples of this pixel the triangle covers and wins.
+                    // The pixel is shaded where the first of them lies.
+                    int won = 0;
+                    glm::vec3 shadeCoords;
+                    float shadeZ = 0.f;
+                    for (int s = 0; s < samples; ++s) {
+                        if (((sampleMask[s] >> i) & 1) == 0) {
+                            continue;
+                        }
+                        glm::vec3 barycentricCoords = sampleRow[s] + static_cast<float>(i) * dx;
                         float z = InterpolateZ(zInv, barycentricCoords);
-                        int zIndex = x + y * result.width();
-                        if (z < zBuffer[zIndex]) {
-                            zBuffer[zIndex] = z;
-                            glm::vec2 uv = interpolateUV(polygon.VertAt(triangle.m_indices[0]).m_uv,
-                                                         polygon.VertAt(triangle.m_indices[1]).m_uv,
-                                                         polygon.VertAt(triangle.m_indices[2]).m_uv,
-                                                         barycentricCoords, zInv, z);
-
-                            glm::vec3 normal = interpolateNormal(polygon.VertAt(triangle.m_indices[0]).m_normal,
-                                                              polygon.VertAt(triangle.m_indices[1]).m_normal,
-                                                              polygon.VertAt(triangle.m_indices[2]).m_normal,
-                                                              barycentricCoords, zInv, z);
-
-                            glm::mat3 viewMatrix3x3 = glm::mat3(viewMatrix);
-
-                            // Transform the normal to camera space
-                            glm::vec3 normalInCameraSpace = viewMatrix3x3 * normal;
-
-                            // Using Normal Map
-                            if(polygon.mp_normalMap != nullptr) {
-                                //std::cout << "using Normal Map" << std::endl;
-                                glm::mat3 tangentSpaceMatrix = createTangentMatrix(normal);
-                                glm::vec3 normalTangentSpace = getTangentNormal(uv, polygon.mp_normalMap);
-                                normal = glm::normalize(tangentSpaceMatrix * normalTangentSpace);
+
+                        if (pass == RasterPass::ShadeVisible) {
+                            if (z != depth[s] || tile.shaded[local + s]) {
+                                continue;
                             }
+                            tile.shaded[local + s] = true;
+                        } else {
+                            if (!inFront && z >= depth[s]) {
+                                continue;
+                            }
+                            depth[s] = z;
+                        }
+                        if (won == 0) {
+                            shadeCoords = barycentricCoords;
+                            shadeZ = z;
+                        }
+                        won |= 1 << s;
+                    }
+                    if (won == 0) {
+                        continue;
+                    }
+                    depthWritten = depthWritten || pass != RasterPass::ShadeVisible;
 
+                    if (pass == RasterPass::DepthAndShade || pass == RasterPass::ShadeVisible) {
+                        QRgb color = ShadeFragment(setup, frame, x, y, shadeCoords, shadeZ);
+                        QRgb* colors = frame.colors + (x + y * frame.width) * samples;
+                        for (int bits = won; bits != 0; bits &= bits - 1) {
+                            colors[CountTrailingZeros(bits)] = color;
+                        }
+                    } else if (pass == RasterPass::DepthAndId) {
+                        uint32_t* ids = frame.visibility + (x + y * frame.width) * samples;
+                        for (int bits = won; bits != 0; bits &= bits - 1) {
+                            ids[CountTrailingZeros(bits)] = setup.id;
+                        }
+                    }
+                }
+            }
 
-                            // Lambert law
-                            glm::vec3 diffuse = glm::dot(normal, lightDir) * lightColor;
+            if (depthWritten) {
+                frame.hiZ->Refresh(frame.zBuffer, hiZX, hiZY);
+            }
+        }
+    }
+}
 
-                            glm::vec3 position = { x, y, z };
+// Classifies a world-space box against the view frustum the way
+// ClassifyBlock classifies blocks against a triangle: -1 when it is entirely
+// outside one plane, 1 when it is entirely inside and 0 otherwise
+int ClassifyBounds(const Bounds& bounds, const glm::mat4& viewProj, float nearW) {
+    unsigned char outsideAll = 0xff;
+    unsigned char outsideAny = 0;
+    for (int corner = 0; corner < 8; ++corner) {
+        glm::vec4 point((corner & 1) ? bounds.max.x : bounds.min.x,
+                        (corner & 2) ? bounds.max.y : bounds.min.y,
+                        (corner & 4) ? bounds.max.z : bounds.min.z, 1.f);
+        glm::vec4 clip = viewProj * point;
+        unsigned char outcode = FrustumOutcode(glm::vec3(clip.x, clip.y, clip.w), nearW);
+        outsideAll &= outcode;
+        outsideAny |= outcode;
+    }
+    return outsideAll != 0 ? -1 : (outsideAny != 0 ? 0 : 1);
+}
 
-                            glm::vec3 viewDir = glm::normalize(eye - position);
+// Whether everything inside a world-space box is behind the depth already
+// stored where the box lands on screen. Boxes reaching behind the near plane
+// have no bounded projection and are never considered occluded.
+bool Occluded(const Bounds& bounds, const glm::mat4& viewProj, float nearW, const FrameContext& frame) {
+    glm::vec2 lo(std::numeric_limits<float>::max());
+    glm::vec2 hi(-std::numeric_limits<float>::max());
+    float nearest = std::numeric_limits<float>::max();
+    for (int corner = 0; corner < 8; ++corner) {
+        glm::vec4 point((corner & 1) ? bounds.max.x : bounds.min.x,
+                        (corner & 2) ? bounds.max.y : bounds.min.y,
+                        (corner & 4) ? bounds.max.z : bounds.min.z, 1.f);
+        glm::vec4 clip = viewProj * point;
+        if (clip.w <= nearW) {
+            return false;
+        }
+        glm::vec2 pixel((clip.x / clip.w + 1) * 0.5f * frame.width, (1 - clip.y / clip.w) * 0.5f * frame.height);
+        lo = glm::min(lo, pixel);
+        hi = glm::max(hi, pixel);
+        nearest = std::min(nearest, clip.w);
+    }
+    // Every pixel with a sample inside the projected box, clamped to the
+    // screen in floating point since the box may project far beyond it
+    glm::vec2 lastPixel(frame.width - 1, frame.height - 1);
+    glm::vec2 first = glm::clamp(glm::floor(lo) - 1.f, glm::vec2(0.f), lastPixel);
+    glm::vec2 last = glm::clamp(glm::ceil(hi) + 1.f, glm::vec2(0.f), lastPixel);
+    return nearest > frame.hiZ->MaxDepth(static_cast<int>(first.x), static_cast<int>(last.x),
+                                         static_cast<int>(first.y), static_cast<int>(last.y));
+}
 
-                            // if (uv.x > 1 || uv.x < 0 || uv.y > 1 || uv.y < 0) {
-                            //     std::cout << uv << " out of bound" << std::endl;
-                            // }
+// Milliseconds since the timer was last started; starts it again
+double Lap(QElapsedTimer& timer) {
+    double elapsed = timer.nsecsElapsed() * 1e-6;
+    timer.start();
+    return elapsed;
+}
 
-                            //if (barycentricCoords.x + barycentricCoords.y + barycentricCoords.z > 1.0f)
-                            //{
-                            //    std::cout << "Wrong barycentric coords!" << std::endl;
-                            //}
+// Runs one raster pass over every triangle binned into a tile, in submission order
+template <RasterPass pass>
+void RasterizeBins(const std::vector<std::vector<TriangleSetup>>& setups,
+                   const std::vector<std::vector<std::vector<uint32_t>>>& bins,
+                   int tileIndex, const FrameContext& frame, TileContext& tile) {
+    for (size_t batch = 0; batch < setups.size(); ++batch) {
+        for (uint32_t index : bins[batch][tileIndex]) {
+            RasterizeTriangle<pass>(setups[batch][index], frame, tile);
+        }
+    }
+}
 
-                            // get color from texture
-                            glm::vec3 color = GetImageColor(uv, polygon.mp_texture);
+// A triangle of the scene, and where its polygon's vertices start in the
+// vertex stage's output
+struct SceneTriangle {
+    uint32_t polygon;
+    uint32_t firstVertex;
+    const Triangle* triangle;
+};
 
-                            glm::vec3 specular = glm::vec3(0.0f);
+// How the screen is split into the tiles that the back end renders in parallel
+struct TileGrid {
+    int binSize;
+    int tilesX;
+    int tilesY;
+};
 
-                            if (shadingModel == ShadingModel::BlinnPhong)
-                            {
-                                glm::vec3 halfwayDir = glm::normalize(viewDir + lightDir);
+TileGrid MakeTileGrid(int tileSize, int width, int height) {
+    TileGrid grid;
+    // Tiles must be made of whole hierarchical z blocks
+    grid.binSize = std::max(1, (tileSize + HiZBuffer::BLOCK_SIZE - 1) / HiZBuffer::BLOCK_SIZE) * HiZBuffer::BLOCK_SIZE;
+    grid.tilesX = (width + grid.binSize - 1) / grid.binSize;
+    grid.tilesY = (height + grid.binSize - 1) / grid.binSize;
+    return grid;
+}
 
-                                specular = std::max(std::pow(glm::dot(normal, halfwayDir), shininess), 0.0f) * lightColor;
-                            }
-                            else if (shadingModel == ShadingModel::Phong)
-                            {
-                                glm::vec3 reflectDir = glm::reflect(-lightDir, normal);
-                                specular = std::max(std::pow(glm::dot(viewDir, reflectDir), shininess), 0.0f) * lightColor;
-                            }
+// The pixels of a tile, clipped to the screen
+TileContext MakeTile(const TileGrid& grid, int tileIndex, int width, int height) {
+    TileContext tile;
+    tile.minX = (tileIndex % grid.tilesX) * grid.binSize;
+    tile.minY = (tileIndex / grid.tilesX) * grid.binSize;
+    tile.maxX = std::min(tile.minX + grid.binSize, width) - 1;
+    tile.maxY = std::min(tile.minY + grid.binSize, height) - 1;
+    return tile;
+}
 
-                            color *= (diffuse + ambient + specular);
+// The tiles from the center of the screen outwards. Tiles are independent,
+// so the order never changes the image, but a viewer showing tiles as they
+// finish fills in the middle of the screen first.
+std::vector<int> CenterOutOrder(const TileGrid& grid) {
+    std::vector<int> order(grid.tilesX * grid.tilesY);
+    std::vector<float> distance(order.size());
+    for (int i = 0; i < static_cast<int>(order.size()); ++i) {
+        order[i] = i;
+        distance[i] = glm::length(glm::vec2(i % grid.tilesX + 0.5f - 0.5f * grid.tilesX,
+                                            i / grid.tilesX + 0.5f - 0.5f * grid.tilesY));
+    }
+    std::stable_sort(order.begin(), order.end(), [&](int a, int b) { return distance[a] < distance[b]; });
+    return order;
+}
 
-                            //color = glm::vec3(uv.x * 255.0f, uv.y * 255.0f, 0.0f);
-                            //color = glm::vec3(normal.x * 255.0f, normal.y * 255.0f, normal.z * 255.0f);
+// Whether another thread asked the frame being rendered to stop
+bool Cancelled(const std::atomic<bool>* cancel) {
+    return cancel != nullptr && cancel->load(std::memory_order_relaxed);
+}
 
-                            result.setPixel(x, y, ClampColor(color));
+// The vertex stage: transforms every vertex of the polygons in view exactly
+// once, however many triangles share it. firstVertex receives where each
+// polygon's vertices start in screenVertices. Once cancelled, the remaining
+// chunks of vertices are skipped and the output is incomplete.
+void TransformPolygons(const std::vector<Polygon>& polygons, const std::vector<uint8_t>& polygonInView,
+                       const glm::mat4& view, const glm::mat4& projection, int width, int height,
+                       const std::atomic<bool>* cancel,
+                       std::vector<uint32_t>& firstVertex, ScreenVertices& screenVertices) {
+    firstVertex.resize(polygons.size());
+    size_t vertexCount = 0;
+    for (size_t i = 0; i < polygons.size(); ++i) {
+        firstVertex[i] = static_cast<uint32_t>(vertexCount);
+        vertexCount += polygons[i].m_verts.size();
+    }
+
+    const size_t vertexChunk = 4096;
+    std::vector<std::pair<uint32_t, size_t>> vertexJobs; // (polygon, first local vertex)
+    for (size_t i = 0; i < polygons.size(); ++i) {
+        if (!polygonInView[i]) {
+            continue;
+        }
+        for (size_t begin = 0; begin < polygons[i].m_verts.size(); begin += vertexChunk) {
+            vertexJobs.push_back({static_cast<uint32_t>(i), begin});
+        }
+    }
+
+    screenVertices.Resize(vertexCount);
+    ParallelFor(static_cast<int>(vertexJobs.size()), [&](int job) {
+        if (Cancelled(cancel)) {
+            return;
+        }
+        const Polygon& polygon = polygons[vertexJobs[job].first];
+        size_t begin = vertexJobs[job].second;
+        size_t count = std::min(vertexChunk, polygon.m_verts.size() - begin);
+        TransformVertices(view, projection, polygon.m_verts, begin, count,
+                          width, height, screenVertices,
+                          firstVertex[vertexJobs[job].first] + begin);
+    });
+}
+
+// Flattens clusters into their triangles, so the triangle stage can split
+// them into even batches. The triangles come out polygon by polygon, each
+// polygon's in the order of its m_tris, however the BVH split it and in
+// whatever order the clusters are listed. Once cancelled, the list is cut
+// short.
+std::vector<SceneTriangle> GatherTriangles(const std::vector<Polygon>& polygons, const SceneBVH& bvh,
+                                           const std::vector<uint32_t>& clusterList,
+                                           const std::vector<uint32_t>& firstVertex,
+                                           const std::atomic<bool>* cancel) {
+    const std::vector<TriangleCluster>& clusters = bvh.Clusters();
+    const std::vector<uint32_t>& clusterTriangles = bvh.ClusterTriangles();
+
+    // Mark the listed triangles of every polygon, then walk the marks in order
+    std::vector<std::vector<uint8_t>> listed(polygons.size());
+    std::vector<uint32_t> listedPolygons;
+    size_t triangleCount = 0;
+    for (size_t c = 0; c < clusterList.size(); ++c) {
+        if (c % 256 == 0 && Cancelled(cancel)) {
+            return {};
+        }
+        const TriangleCluster& cluster = clusters[clusterList[c]];
+        std::vector<uint8_t>& marks = listed[cluster.polygon];
+        if (marks.empty()) {
+            marks.assign(polygons[cluster.polygon].m_tris.size(), 0);
+            listedPolygons.push_back(cluster.polygon);
+        }
+        for (uint32_t i = 0; i < cluster.triangleCount; ++i) {
+            marks[clusterTriangles[cluster.firstTriangle + i]] = 1;
+        }
+        triangleCount += cluster.triangleCount;
+    }
+    std::sort(listedPolygons.begin(), listedPolygons.end());
+
+    std::vector<SceneTriangle> triangles;
+    triangles.reserve(triangleCount);
+    for (uint32_t p : listedPolygons) {
+        const std::vector<Triangle>& polygonTriangles = polygons[p].m_tris;
+        const std::vector<uint8_t>& marks = listed[p];
+        for (size_t t = 0; t < marks.size(); ++t) {
+            if (marks[t]) {
+                triangles.push_back({p, firstVertex[p], &polygonTriangles[t]});
+            }
+        }
+    }
+    return triangles;
+}
+
+// The triangle stage: culls, clips and sets up triangles from the vertex
+// stage's output and sorts them into the tiles their bounding boxes touch.
+// Each batch covers a contiguous range of triangles and keeps its own bins,
+// so batches never contend with each other. Depth-only passes pass no
+// textures, and then the setups carry no attributes at all. Once cancelled,
+// batches stop early and leave their bins incomplete.
+void SetupTriangles(const std::vector<SceneTriangle>& triangles, const std::vector<Polygon>& polygons,
+                    const std::vector<std::shared_ptr<const Texture>>* textures,
+                    const std::vector<std::shared_ptr<const Texture>>* normalMaps,
+                    const ScreenVertices& screenVertices, const FrameContext& frame, float nearW,
+                    bool cullBackFaces, const TileGrid& grid, const std::atomic<bool>* cancel,
+                    std::vector<std::vector<TriangleSetup>>& setups,
+                    std::vector<std::vector<std::vector<uint32_t>>>& bins) {
+    const int batchCount = std::max(1, std::min(WorkerCount(), static_cast<int>(triangles.size()) / 256));
+    const int binSize = grid.binSize;
+    const int tilesX = grid.tilesX;
+    const int tilesY = grid.tilesY;
+    setups.assign(batchCount, std::vector<TriangleSetup>());
+    bins.assign(batchCount, std::vector<std::vector<uint32_t>>(tilesX * tilesY));
+
+    ParallelFor(batchCount, [&](int batch) {
+        size_t begin = triangles.size() * batch / batchCount;
+        size_t end = triangles.size() * (batch + 1) / batchCount;
+        std::vector<TriangleSetup>& batchSetups = setups[batch];
+        std::vector<std::vector<uint32_t>>& batchBins = bins[batch];
+        batchSetups.reserve(end - begin);
+
+        auto binSetup = [&](const TriangleSetup& setup) {
+            uint32_t index = static_cast<uint32_t>(batchSetups.size());
+            batchSetups.push_back(setup);
+            int tileMinX = std::max(setup.minX / binSize, 0);
+            int tileMaxX = std::min(setup.maxX / binSize, tilesX - 1);
+            int tileMinY = std::max(setup.minY / binSize, 0);
+            int tileMaxY = std::min(setup.maxY / binSize, tilesY - 1);
+            for (int ty = tileMinY; ty <= tileMaxY; ++ty) {
+                for (int tx = tileMinX; tx <= tileMaxX; ++tx) {
+                    batchBins[tx + ty * tilesX].push_back(index);
+                }
+            }
+        };
+
+        TriangleSetup setup;
+        for (size_t i = begin; i < end; ++i) {
+            // A batch is a worker's whole share of the frame's triangles
+            if ((i - begin) % 256 == 0 && Cancelled(cancel)) {
+                return;
+            }
+            const Triangle& triangle = *triangles[i].triangle;
+            setup.polygon = &polygons[triangles[i].polygon];
+            setup.texture = textures ? (*textures)[triangles[i].polygon].get() : nullptr;
+            setup.normalMap = normalMaps ? (*normalMaps)[triangles[i].polygon].get() : nullptr;
+            setup.triangle = &triangle;
+            // Unpacks the corners' attributes once a piece of the triangle survives culling
+            bool unpacked = !textures;
+            auto unpackAttributes = [&]() {
+                if (!unpacked) {
+                    const VertexBuffer& vertices = setup.polygon->m_verts;
+                    for (int v = 0; v < 3; ++v) {
+                        setup.uvs[v] = vertices.UV(triangle.m_indices[v]);
+                        setup.normals[v] = vertices.Normal(triangle.m_indices[v]);
+                    }
+                    for (int v = 0; v < 3 && setup.normalMap != nullptr; ++v) {
+                        glm::vec4 tangent = vertices.Tangent(triangle.m_indices[v]);
+                        // Without a tangent frame the map has no orientation to follow
+                        if (tangent.w == 0.f) {
+                            setup.normalMap = nullptr;
                         }
+                        setup.tangents[v] = glm::vec3(tangent);
+                        setup.bitangents[v] = tangent.w * glm::cross(setup.normals[v], glm::vec3(tangent));
                     }
+                    unpacked = true;
                 }
+            };
+
+            ClipVertex corners[3];
+            unsigned char frustumOut = 0xff;
+            unsigned char guardBandOut = 0;
+            for (int v = 0; v < 3; ++v) {
+                uint32_t index = triangles[i].firstVertex + triangle.m_indices[v];
+                corners[v].pos = glm::vec3(screenVertices.clipX[index], screenVertices.clipY[index], screenVertices.w[index]);
+                corners[v].bary = glm::vec3(v == 0, v == 1, v == 2);
+                frustumOut &= FrustumOutcode(corners[v].pos, nearW);
+                guardBandOut |= GuardBandOutcode(corners[v].pos, nearW, GUARD_BAND);
+            }
+
+            // Frustum culling: all three corners beyond the same plane
+            if (frustumOut != 0) {
+                continue;
             }
+
+            if (guardBandOut == 0) {
+                // The common case: the vertex stage's pixel positions are usable as they are
+                glm::vec2 pixelSpaceVertices[3];
+                glm::vec3 ZValue;
+                for (int v = 0; v < 3; ++v) {
+                    uint32_t index = triangles[i].firstVertex + triangle.m_indices[v];
+                    pixelSpaceVertices[v] = glm::vec2(screenVertices.x[index], screenVertices.y[index]);
+                    ZValue[v] = screenVertices.w[index];
+                }
+                setup.clipped = false;
+                if (SetupTriangle(pixelSpaceVertices, ZValue, frame.width, frame.height,
+                                  frame.sampleReach, cullBackFaces, setup)) {
+                    unpackAttributes();
+                    binSetup(setup);
+                }
+                continue;
+            }
+
+            // Crosses the near plane or leaves the guard band: clip, then fan
+            // the remaining polygon back into triangles
+            ClipVertex clipped[MAX_CLIPPED_VERTICES];
+            int clippedCount = ClipTriangle(corners, guardBandOut, nearW, GUARD_BAND, clipped);
+            glm::vec2 pixelSpace[MAX_CLIPPED_VERTICES];
+            for (int v = 0; v < clippedCount; ++v) {
+                const glm::vec3& pos = clipped[v].pos;
+                pixelSpace[v].x = (pos.x / pos.z + 1) * 0.5f * frame.width;
+                pixelSpace[v].y = (1 - pos.y / pos.z) * 0.5f * frame.height;
+            }
+            setup.clipped = true;
+            for (int v = 1; v + 1 < clippedCount; ++v) {
+                glm::vec2 pixelSpaceVertices[3] = {pixelSpace[0], pixelSpace[v], pixelSpace[v + 1]};
+                glm::vec3 ZValue(clipped[0].pos.z, clipped[v].pos.z, clipped[v + 1].pos.z);
+                setup.sourceBary = glm::mat3(clipped[0].bary, clipped[v].bary, clipped[v + 1].bary);
+                if (SetupTriangle(pixelSpaceVertices, ZValue, frame.width, frame.height,
+                                  frame.sampleReach, cullBackFaces, setup)) {
+                    unpackAttributes();
+                    binSetup(setup);
+                }
+            }
+        }
+    });
+}
+
+// Rasterization Main Logic
+//
+// The frame is rendered in six stages. The cull stage walks the scene's BVH
+// and keeps the triangle clusters inside the view frustum. The vertex stage
+// transforms every vertex of the polygons in view once into a screen-space
+// buffer. The shadow stage brings the shadow maps of the lights up to date,
+// rendering each with the depth pass of this same pipeline. The light stage
+// sorts the lights into the screen tiles they can reach. The triangle stage
+// sets up each triangle from the vertex buffer and sorts it into the screen
+// tiles its bounding box touches. The back end then shades each tile on its
+// own worker; a tile only ever writes its own pixels and its own slice of
+// the z-buffer, so no locking is needed.
+//
+// Triangles are drawn polygon by polygon as the scene lists them, each
+// polygon's in the order of its m_tris, however the BVH split it into
+// clusters. Bins keep that order however many workers set the triangles up,
+// and the depth test only replaces a sample with a strictly nearer one, so
+// of two triangles at the same depth the one drawn first wins, exactly as
+// in a single-threaded walk of the scene.
+//
+// With occlusion culling the triangle stage and the back end run twice: first
+// for the clusters that were visible in the last frame, then for the rest of
+// those in view, minus the ones the depth buffer of the first phase hides.
+// Each phase keeps the order above, but ties between the two phases go to
+// the first, so there the clusters visible a frame ago decide. Without
+// occlusion culling the image depends on the scene and camera alone.
+//
+// Anti-aliasing is multisampled: every pixel has scalingFactor x scalingFactor
+// coverage and depth samples, but each triangle shades a pixel only once, and
+// the samples' colors are averaged at the end.
+QImage Rasterizer::RenderScene(const std::atomic<bool>* cancel, const TileCallback& onTile) {
+    QElapsedTimer frameTimer, stageTimer;
+    frameTimer.start();
+    stageTimer.start();
+    m_stats = RenderStats();
+    // Checked between stages, before every tile of each pass, every chunk
+    // of vertices and every 256 clusters gathered or triangles set up, so
+    // an abandoned frame stops within about one tile's work. Only the BVH
+    // traversals run unchecked.
+    auto cancelled = [cancel]() {
+        return Cancelled(cancel);
+    };
+
+    int sampleGrid = std::max(1, std::min(scalingFactor, MAX_SAMPLE_GRID));
+    int samples = sampleGrid * sampleGrid;
+
+    // The buffers are cleared tile by tile by the workers that render them
+    m_frameBuffer.Resize(512, 512, samples, renderPath == RenderPath::VisibilityBuffer);
+    HiZBuffer hiZ(m_frameBuffer.Width(), m_frameBuffer.Height(), samples, std::numeric_limits<float>::max());
+
+    glm::mat4 projectionMatrix = m_camera.GetPerspectiveMatrix();
+    glm::mat4 viewMatrix = m_camera.GetViewMatrix();
+
+    FrameContext frame;
+    frame.eye = m_camera.GetPosition();
+    frame.ambient = ambient;
+    frame.shininess = 32.0f;
+    frame.shadingModel = shadingModel;
+    frame.textureFilter = textureFilter;
+    frame.width = m_frameBuffer.Width();
+    frame.height = m_frameBuffer.Height();
+    // An ordered grid of samples centered on the pixel's position
+    frame.samples = samples;
+    for (int sy = 0; sy < sampleGrid; ++sy) {
+        for (int sx = 0; sx < sampleGrid; ++sx) {
+            frame.sampleOffsets[sx + sy * sampleGrid] = glm::vec2((sx + 0.5f) / sampleGrid - 0.5f,
+                                                                  (sy + 0.5f) / sampleGrid - 0.5f);
         }
     }
+    frame.sampleReach = 0.5f - 0.5f / sampleGrid;
+    frame.colors = m_frameBuffer.SampleColors();
+    frame.zBuffer = m_frameBuffer.Depth();
+    frame.hiZ = &hiZ;
+    frame.visibility = m_frameBuffer.Visibility();
+
+    glm::mat4 viewProj = projectionMatrix * viewMatrix;
+    const float nearW = m_camera.GetNearClip();
+
+    // Pixel (x, y) is at normalized device coordinates (2x / width - 1,
+    // 1 - 2y / height), and at view depth 1 its view-space position is those
+    // divided by the projection's scale
+    glm::mat3 viewToWorld = glm::inverse(glm::mat3(viewMatrix));
+    float projectionX = projectionMatrix[0][0];
+    float projectionY = projectionMatrix[1][1];
+    frame.rayOrigin = viewToWorld * glm::vec3(-1.f / projectionX, 1.f / projectionY, 1.f);
+    frame.rayDX = viewToWorld * glm::vec3(2.f / (frame.width * projectionX), 0.f, 0.f);
+    frame.rayDY = viewToWorld * glm::vec3(0.f, -2.f / (frame.height * projectionY), 0.f);
+
+    // Cull stage: walk the BVH for the clusters inside the view frustum. The
+    // ones that were visible last frame are drawn first; the others are
+    // drawn afterwards, and only when the depth buffer the first ones leave
+    // behind does not hide them.
+    const std::vector<TriangleCluster>& clusters = m_bvh.Clusters();
+    bool useHistory = occlusionCulling && m_wasVisible.size() == clusters.size();
+    std::vector<uint8_t> inFrustum(clusters.size(), 0);
+    std::vector<uint8_t> polygonInView(m_polygons.size(), 0);
+    m_bvh.Traverse([&](const Bounds& bounds) {
+        return ClassifyBounds(bounds, viewProj, nearW);
+    }, [&](uint32_t cluster) {
+        inFrustum[cluster] = 1;
+        polygonInView[clusters[cluster].polygon] = 1;
+    });
+    std::vector<uint32_t> phaseClusters[2];
+    for (uint32_t c = 0; c < clusters.size(); ++c) {
+        if (inFrustum[c]) {
+            phaseClusters[useHistory && !m_wasVisible[c]].push_back(c);
+        }
+    }
+    m_stats.frustumCulled = static_cast<int>(clusters.size() - phaseClusters[0].size() - phaseClusters[1].size());
+    m_stats.cullMs = Lap(stageTimer);
+    if (cancelled()) {
+        return QImage();
+    }
+
+    // Vertex stage
+    std::vector<uint32_t> firstVertex;
+    ScreenVertices screenVertices;
+    TransformPolygons(m_polygons, polygonInView, viewMatrix, projectionMatrix, frame.width, frame.height, cancel,
+                      firstVertex, screenVertices);
+    m_stats.vertexMs = Lap(stageTimer);
+    if (cancelled()) {
+        return QImage();
+    }
+
+    // Shadow stage: render the shadow maps of the lights that cast shadows.
+    // They do not depend on the view, so a map is only rendered again once
+    // its light or the scene's geometry changed.
+    const int shadowSize = std::max(shadowMapSize, 1);
+    m_shadowMaps.resize(lights.size());
+    std::vector<const ShadowMap*> shadowMaps(lights.size(), nullptr);
+    Bounds sceneBounds;
+    for (const TriangleCluster& cluster : clusters) {
+        sceneBounds.Grow(cluster.bounds);
+    }
+    for (size_t i = 0; i < lights.size(); ++i) {
+        if (!lights[i].castsShadows) {
+            continue;
+        }
+        CachedShadowMap& cached = m_shadowMaps[i];
+        if (cached.map.Size() != shadowSize || cached.light != lights[i]
+            || cached.geometryVersion != m_geometryVersion) {
+            cached.map.Setup(lights[i], sceneBounds, shadowSize);
+            if (!RenderShadowMap(cached.map, cancel)) {
+                // Half rendered; the next frame starts it over
+                cached.map = ShadowMap();
+                return QImage();
+            }
+            cached.light = lights[i];
+            cached.geometryVersion = m_geometryVersion;
+            ++m_stats.shadowMaps;
+        }
+        shadowMaps[i] = &cached.map;
+    }
+    m_stats.shadowMs = Lap(stageTimer);
+    if (cancelled()) {
+        return QImage();
+    }
+
+    TileGrid grid = MakeTileGrid(tileSize, frame.width, frame.height);
+    const int binSize = grid.binSize;
+    const int tileCount = grid.tilesX * grid.tilesY;
 
-    QImage finalResult(512, 512, QImage::Format_RGB32);
-
-    // Downscale for MSAA
-    for (int y = 0; y < finalResult.height(); ++y) {
-        for (int x = 0; x < finalResult.width(); ++x) {
-            glm::vec3 avgColor(0.0f, 0.0f, 0.0f);
-            for (int dy = 0; dy < scalingFactor; ++dy) {
-                for (int dx = 0; dx < scalingFactor; ++dx) {
-                    int highResX = x * scalingFactor + dx;
-                    int highResY = y * scalingFactor + dy;
-                    QRgb pixelColor = result.pixel(highResX, highResY);
-                    avgColor.x += qRed(pixelColor);
-                    avgColor.y += qGreen(pixelColor);
-                    avgColor.z += qBlue(pixelColor);
+    // Light stage: bin the lights into the same tiles, so shading a pixel
+    // only visits the lights that reach its tile. A scene without lights of
+    // its own is lit by a white light shining along the view.
+    if (lights.empty()) {
+        m_lightGrid.Build({Light::Directional(m_camera.GetForward(), glm::vec3(1.0f))}, {}, viewProj, nearW,
+                          frame.width, frame.height, binSize);
+    } else {
+        m_lightGrid.Build(lights, shadowMaps, viewProj, nearW, frame.width, frame.height, binSize);
+    }
+    frame.lights = &m_lightGrid;
+    m_stats.lights = m_lightGrid.VisibleLights();
+    m_stats.lightMs = Lap(stageTimer);
+
+    // The setups of both phases stay alive until the visibility buffer is shaded
+    std::vector<std::vector<TriangleSetup>> setups[2];
+    std::vector<const TriangleSetup*> setupsById;
+
+    // Every tile is handed to onTile by the pass that finishes it: the last
+    // raster phase, unless deferred shading or resolving still follows
+    const bool shadeLater = renderPath == RenderPath::VisibilityBuffer;
+    const bool resolveLater = samples > 1;
+    const bool secondPhase = !phaseClusters[1].empty();
+    const std::vector<int> tileOrder = CenterOutOrder(grid);
+    auto report = [&](const TileContext& tile) {
+        if (onTile) {
+            RenderedTile rendered;
+            rendered.minX = tile.minX;
+            rendered.maxX = tile.maxX;
+            rendered.minY = tile.minY;
+            rendered.maxY = tile.maxY;
+            rendered.frameWidth = frame.width;
+            rendered.frameHeight = frame.height;
+            rendered.pixels = m_frameBuffer.Colors() + tile.minX + tile.minY * frame.width;
+            rendered.stride = frame.width;
+            onTile(rendered);
+        }
+    };
+
+    for (int phase = 0; phase < 2; ++phase) {
+        if (phase == 1 && !secondPhase) {
+            break;
+        }
+        if (phase == 1) {
+            // Occlusion culling against the depth of everything drawn so far
+            std::vector<uint32_t> unoccluded;
+            for (uint32_t c : phaseClusters[1]) {
+                if (!Occluded(clusters[c].bounds, viewProj, nearW, frame)) {
+                    unoccluded.push_back(c);
+                }
+            }
+            m_stats.occlusionCulled = static_cast<int>(phaseClusters[1].size() - unoccluded.size());
+            phaseClusters[1].swap(unoccluded);
+            m_stats.cullMs += Lap(stageTimer);
+            if (phaseClusters[1].empty()) {
+                // The first phase already drew everything there is
+                if (!shadeLater && !resolveLater) {
+                    for (int tileIndex : tileOrder) {
+                        report(MakeTile(grid, tileIndex, frame.width, frame.height));
+                    }
+                }
+                break;
+            }
+        }
+        const bool lastPhase = phase == 1 || !secondPhase;
+
+        std::vector<SceneTriangle> triangles = GatherTriangles(m_polygons, m_bvh, phaseClusters[phase], firstVertex, cancel);
+        m_stats.clusters += static_cast<int>(phaseClusters[phase].size());
+        m_stats.triangles += static_cast<int>(triangles.size());
+
+        // Triangle stage
+        std::vector<std::vector<TriangleSetup>>& phaseSetups = setups[phase];
+        std::vector<std::vector<std::vector<uint32_t>>> bins;
+        SetupTriangles(triangles, m_polygons, &m_textures, &m_normalMaps, screenVertices, frame, nearW,
+                       backfaceCulling, grid, cancel, phaseSetups, bins);
+        if (cancelled()) {
+            return QImage();
+        }
+
+        // Every setup gets its frame-wide id, in submission order
+        for (auto& batchSetups : phaseSetups) {
+            for (auto& setup : batchSetups) {
+                setup.id = static_cast<uint32_t>(setupsById.size());
+                setupsById.push_back(&setup);
+            }
+        }
+        m_stats.triangleMs += Lap(stageTimer);
+
+        // Back end: walk every batch's bin for this tile in batch order. With the
+        // depth pre-pass the tile's depth is resolved first, so the shading walk
+        // touches each visible pixel exactly once. The second phase draws on
+        // top of the first, so only the first clears.
+        ParallelFor(tileCount, [&](int job) {
+            if (cancelled()) {
+                return;
+            }
+            int tileIndex = tileOrder[job];
+            TileContext tile = MakeTile(grid, tileIndex, frame.width, frame.height);
+
+            // Clearing here rather than up front keeps the tile's buffers in
+            // this worker's cache for the rasterization that follows
+            if (phase == 0) {
+                m_frameBuffer.ClearRect(tile.minX, tile.maxX, tile.minY, tile.maxY, qRgb(0, 0, 0),
+                                        std::numeric_limits<float>::max(), NO_TRIANGLE);
+            }
+
+            switch (renderPath) {
+            case RenderPath::Forward:
+                RasterizeBins<RasterPass::DepthAndShade>(phaseSetups, bins, tileIndex, frame, tile);
+                break;
+            case RenderPath::DepthPrePass:
+                RasterizeBins<RasterPass::DepthOnly>(phaseSetups, bins, tileIndex, frame, tile);
+                tile.shaded.assign((tile.maxX - tile.minX + 1) * (tile.maxY - tile.minY + 1) * samples, false);
+                RasterizeBins<RasterPass::ShadeVisible>(phaseSetups, bins, tileIndex, frame, tile);
+                break;
+            case RenderPath::VisibilityBuffer:
+                RasterizeBins<RasterPass::DepthAndId>(phaseSetups, bins, tileIndex, frame, tile);
+                break;
+            }
+            if (lastPhase && !shadeLater && !resolveLater) {
+                report(tile);
+            }
+        });
+        m_stats.rasterMs += Lap(stageTimer);
+        if (cancelled()) {
+            return QImage();
+        }
+    }
+    m_stats.setups = static_cast<int>(setupsById.size());
+    m_stats.pixels = frame.width * frame.height;
+
+    // Remember which clusters the finished depth buffer leaves visible; they
+    // are next frame's first phase
+    if (occlusionCulling) {
+        m_wasVisible.assign(clusters.size(), 0);
+        for (int phase = 0; phase < 2; ++phase) {
+            for (uint32_t c : phaseClusters[phase]) {
+                m_wasVisible[c] = !Occluded(clusters[c].bounds, viewProj, nearW, frame);
+            }
+        }
+        m_stats.cullMs += Lap(stageTimer);
+    } else {
+        m_wasVisible.clear();
+    }
+
+    // Deferred shading: each pixel is shaded exactly once per triangle that
+    // survived in one of its samples, so the cost depends on the resolution
+    // and not on the overdraw
+    if (shadeLater) {
+        ParallelFor(tileCount, [&](int job) {
+            if (cancelled()) {
+                return;
+            }
+            TileContext tile = MakeTile(grid, tileOrder[job], frame.width, frame.height);
+            for (int y = tile.minY; y <= tile.maxY; ++y) {
+                for (int x = tile.minX; x <= tile.maxX; ++x) {
+                    const uint32_t* ids = frame.visibility + (x + y * frame.width) * samples;
+                    QRgb* pixelColors = frame.colors + (x + y * frame.width) * samples;
+                    int done = 0;
+                    for (int s = 0; s < samples; ++s) {
+                        if (((done >> s) & 1) != 0 || ids[s] == NO_TRIANGLE) {
+                            continue;
+                        }
+                        const TriangleSetup& setup = *setupsById[ids[s]];
+                        glm::vec3 barycentricCoords = BarycentricAt(setup, x, y, frame.sampleOffsets[s]);
+                        float z = InterpolateZ(setup.zInv, barycentricCoords);
+                        QRgb color = ShadeFragment(setup, frame, x, y, barycentricCoords, z);
+                        for (int other = s; other < samples; ++other) {
+                            if (ids[other] == ids[s]) {
+                                pixelColors[other] = color;
+                                done |= 1 << other;
+                            }
+                        }
+                    }
                 }
             }
-            avgColor /= (scalingFactor * scalingFactor);
-            finalResult.setPixel(x, y, ClampColor(avgColor));
+            if (!resolveLater) {
+                report(tile);
+            }
+        });
+        m_stats.shadeMs = Lap(stageTimer);
+    }
+
+    if (cancelled()) {
+        return QImage();
+    }
+
+    // Resolve: average every pixel's samples into the image
+    if (resolveLater) {
+        QRgb* pixels = m_frameBuffer.Colors();
+        ParallelFor(tileCount, [&](int job) {
+            if (cancelled()) {
+                return;
+            }
+            TileContext tile = MakeTile(grid, tileOrder[job], frame.width, frame.height);
+            for (int y = tile.minY; y <= tile.maxY; ++y) {
+                QRgb* scanLine = pixels + y * frame.width;
+                const QRgb* rowColors = frame.colors + y * frame.width * samples;
+                for (int x = tile.minX; x <= tile.maxX; ++x) {
+                    const QRgb* pixelColors = rowColors + x * samples;
+                    // Pixels away from edges hold a single color in all their samples
+                    bool uniform = true;
+                    for (int s = 1; s < samples; ++s) {
+                        uniform = uniform && pixelColors[s] == pixelColors[0];
+                    }
+                    if (uniform) {
+                        scanLine[x] = pixelColors[0];
+                        continue;
+                    }
+                    int red = 0, green = 0, blue = 0;
+                    for (int s = 0; s < samples; ++s) {
+                        red += qRed(pixelColors[s]);
+                        green += qGreen(pixelColors[s]);
+                        blue += qBlue(pixelColors[s]);
+                    }
+                    scanLine[x] = qRgb(red / samples, green / samples, blue / samples);
+                }
+            }
+            report(tile);
+        });
+        if (cancelled()) {
+            return QImage();
         }
     }
 
-    return finalResult;
+    QImage result = m_frameBuffer.TakeImage();
+    m_stats.resolveMs = Lap(stageTimer);
+    m_stats.totalMs = frameTimer.nsecsElapsed() * 1e-6;
+    return result;
 }
 
+// A shadow map view is a frame of its own with a single sample per pixel and
+// no color: the cull, vertex and triangle stages run as for the camera, and
+// the back end only resolves depth. The triangle setups skip every attribute.
+// Clusters beyond the light's range are culled along with those outside the
+// view: nothing there is lit, and nothing there stands between the light and
+// a point that is.
+bool Rasterizer::RenderShadowMap(ShadowMap& shadowMap, const std::atomic<bool>* cancel) {
+    const int size = shadowMap.Size();
+    TileGrid grid = MakeTileGrid(tileSize, size, size);
+    const std::vector<TriangleCluster>& clusters = m_bvh.Clusters();
+
+    for (ShadowMap::View& view : shadowMap.Views()) {
+        if (Cancelled(cancel)) {
+            return false;
+        }
+        std::vector<uint32_t> clusterList;
+        std::vector<uint8_t> polygonInView(m_polygons.size(), 0);
+        m_bvh.Traverse([&](const Bounds& bounds) {
+            int inRange = shadowMap.ClassifyRange(bounds);
+            return inRange < 0 ? -1 : std::min(inRange, ClassifyBounds(bounds, view.viewProj, view.nearW));
+        }, [&](uint32_t cluster) {
+            clusterList.push_back(cluster);
+            polygonInView[clusters[cluster].polygon] = 1;
+        });
+
+        std::vector<uint32_t> firstVertex;
+        ScreenVertices screenVertices;
+        TransformPolygons(m_polygons, polygonInView, view.view, view.projection, size, size, cancel,
+                          firstVertex, screenVertices);
+        std::vector<SceneTriangle> triangles = GatherTriangles(m_polygons, m_bvh, clusterList, firstVertex, cancel);
+
+        HiZBuffer hiZ(size, size, 1, std::numeric_limits<float>::max());
+        FrameContext frame = {};
+        frame.width = size;
+        frame.height = size;
+        frame.samples = 1;
+        frame.sampleOffsets[0] = glm::vec2(0.f);
+        frame.sampleReach = 0.f;
+        frame.zBuffer = view.depth.data();
+        frame.hiZ = &hiZ;
+
+        // Light rarely reaches only the front faces of a mesh, so none are culled
+        std::vector<std::vector<TriangleSetup>> setups;
+        std::vector<std::vector<std::vector<uint32_t>>> bins;
+        SetupTriangles(triangles, m_polygons, nullptr, nullptr, screenVertices, frame, view.nearW,
+                       false, grid, cancel, setups, bins);
+
+        ParallelFor(grid.tilesX * grid.tilesY, [&](int tileIndex) {
+            if (Cancelled(cancel)) {
+                return;
+            }
+            TileContext tile = MakeTile(grid, tileIndex, size, size);
+            for (int y = tile.minY; y <= tile.maxY; ++y) {
+                float* depthLine = frame.zBuffer + y * size;
+                std::fill(depthLine + tile.minX, depthLine + tile.maxX + 1, std::numeric_limits<float>::max());
+            }
+            RasterizeBins<RasterPass::DepthOnly>(setups, bins, tileIndex, frame, tile);
+        });
+    }
+    // The last view may have been cut short too
+    return !Cancelled(cancel);
+}
+
+std::vector<float> Rasterizer::FrameDepth() const {
+    const int samples = m_frameBuffer.Samples();
+    const float* depth = m_frameBuffer.Depth();
+    std::vector<float> nearest(static_cast<size_t>(m_frameBuffer.Width()) * m_frameBuffer.Height());
+    for (size_t pixel = 0; pixel < nearest.size(); ++pixel) {
+        const float* pixelDepth = depth + pixel * samples;
+        nearest[pixel] = *std::min_element(pixelDepth, pixelDepth + samples);
+    }
+    return nearest;
+}
 
 void Rasterizer::ClearScene()
 {
     m_polygons.clear();
+    m_textures.clear();
+    m_normalMaps.clear();
+    m_bvh.Build(m_polygons);
+    m_wasVisible.clear();
+    ++m_geometryVersion;
 }
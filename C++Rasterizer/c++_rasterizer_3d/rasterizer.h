@@ -1,7 +1,15 @@
 #pragma once
 #include <polygon.h>
 #include <QImage>
+#include "bvh.h"
 #include "camera.h"
+#include "framebuffer.h"
+#include "light.h"
+#include "shadowmap.h"
+#include "texture.h"
+#include <atomic>
+#include <functional>
+#include <memory>
 
 enum class ShadingModel : uint8_t
 {
@@ -9,6 +17,51 @@ enum class ShadingModel : uint8_t
     BlinnPhong
 };
 
+enum class RenderPath : uint8_t
+{
+    Forward,         // Shade every fragment that passes the depth test
+    DepthPrePass,    // Resolve depth first, then shade each visible pixel once
+    VisibilityBuffer // Record the visible triangle per pixel, then shade all pixels in one pass
+};
+
+// Where the time of the last RenderScene call went, in milliseconds
+struct RenderStats
+{
+    double cullMs = 0;     // Frustum and occlusion culling of triangle clusters
+    double vertexMs = 0;   // Transforming the vertices of every polygon in view
+    double shadowMs = 0;   // Rendering the shadow maps that were out of date
+    double lightMs = 0;    // Binning the lights into screen tiles
+    double triangleMs = 0; // Culling, clipping, setting up and binning triangles
+    double rasterMs = 0;   // Clearing and rasterizing the tiles, including forward shading
+    double shadeMs = 0;    // The deferred shading pass of the visibility buffer
+    double resolveMs = 0;  // Averaging samples and handing the image to Qt
+    double totalMs = 0;
+    int triangles = 0;     // Triangles submitted, after culling clusters
+    int setups = 0;        // Triangles and clipped pieces that reached the tiles
+    int pixels = 0;
+    int clusters = 0;        // Clusters drawn
+    int frustumCulled = 0;   // Clusters outside the view frustum
+    int occlusionCulled = 0; // Clusters hidden behind what was drawn before them
+    int lights = 0;          // Lights that reach the view frustum
+    int shadowMaps = 0;      // Shadow maps rendered, rather than reused from the last frame
+};
+
+// A screen tile of a frame that has its final colors, handed out while the
+// rest of the frame still renders. pixels is the tile's top left pixel, and
+// its rows are stride pixels apart. The pixels are only valid during the
+// callback.
+struct RenderedTile
+{
+    int minX, maxX, minY, maxY;
+    int frameWidth, frameHeight;
+    const QRgb* pixels;
+    int stride;
+};
+
+// Called from the worker threads, for every tile exactly once, so it must be
+// thread-safe. Tiles arrive from the center of the screen outwards.
+typedef std::function<void(const RenderedTile&)> TileCallback;
+
 class Rasterizer
 {
 private:
@@ -16,12 +69,81 @@ private:
     std::vector<Polygon> m_polygons;
     Camera m_camera;
     ShadingModel shadingModel = ShadingModel::BlinnPhong;
+    RenderPath renderPath = RenderPath::Forward;
+    TextureFilter textureFilter = TextureFilter::Trilinear;
+    // Every polygon's texture and normal map prepared for sampling (null when
+    // it has none), in the order of m_polygons
+    std::vector<std::shared_ptr<const Texture>> m_textures;
+    std::vector<std::shared_ptr<const Texture>> m_normalMaps;
+    // Reused from frame to frame; only the resolved image is handed out
+    FrameBuffer m_frameBuffer;
+    RenderStats m_stats;
+    LightGrid m_lightGrid;
+    SceneBVH m_bvh;
+    // Counts the changes to the scene's geometry, so shadow maps know when
+    // they are out of date
+    uint64_t m_geometryVersion;
+    // A light's shadow map and what it was rendered for. It is reused as
+    // long as neither the light nor the geometry changes.
+    struct CachedShadowMap
+    {
+        Light light;
+        uint64_t geometryVersion;
+        ShadowMap map;
+    };
+    // One per light, in the order of lights; unused for lights without shadows
+    std::vector<CachedShadowMap> m_shadowMaps;
+    // Per cluster, whether it was visible at the end of the last frame. Those
+    // clusters are drawn first, and the depth they leave behind is what the
+    // remaining clusters are tested against. Empty when there is no last frame.
+    std::vector<uint8_t> m_wasVisible;
+
+    void BuildTextures();
+    // Renders the depth of every view of a shadow map, with the depth pass
+    // of the frame's pipeline. Returns false when cancelled first.
+    bool RenderShadowMap(ShadowMap& shadowMap, const std::atomic<bool>* cancel);
 public:
-    Rasterizer(const std::vector<Polygon>& polygons);
-    QImage RenderScene();
+    // Pass the polygons with std::move when the caller does not need them
+    // any more; otherwise they are copied, sharing their images.
+    Rasterizer(std::vector<Polygon> polygons);
+    // Renders the scene as the camera sees it. Another thread may set cancel
+    // to abandon the frame early, in which case the image is null. onTile
+    // receives each tile as soon as it is final. RenderTask runs this on a
+    // thread of its own.
+    QImage RenderScene(const std::atomic<bool>* cancel = nullptr, const TileCallback& onTile = TileCallback());
+    // The view depth of every pixel of the frame RenderScene last returned,
+    // in rows: the nearest of its samples, and float max where nothing was
+    // drawn. A cancelled frame leaves the depth incomplete.
+    std::vector<float> FrameDepth() const;
     void ClearScene();
     Camera& GetCamera();
+    const RenderStats& GetRenderStats() const;
+
+    // The scene's polygons may be edited in place between frames. Call
+    // RefitBVH after moving vertices, and RebuildBVH after changing which
+    // triangles a polygon has. Either also marks shadow maps out of date.
+    int PolygonCount() const;
+    Polygon& GetPolygon(int index);
+    void RefitBVH();
+    void RebuildBVH();
 
     void setShadingModel(ShadingModel inShadingModel);
+    void setRenderPath(RenderPath inRenderPath);
+    void setTextureFilter(TextureFilter inTextureFilter);
+    // Multisample anti-aliasing: every pixel takes a scalingFactor x scalingFactor
+    // grid of coverage and depth samples (1 to 4 per axis)
     int scalingFactor = 1;
+    // Edge length in pixels of the screen tiles that are shaded in parallel
+    int tileSize = 32;
+    // Skip triangles that face away from the camera. Only safe for closed meshes.
+    bool backfaceCulling = false;
+    // Skip clusters that are hidden behind the ones visible in the last frame
+    bool occlusionCulling = true;
+    // The scene's lights, in world space. Without any, a white directional
+    // light shines along the camera's view.
+    std::vector<Light> lights;
+    // Edge length in texels of the shadow maps, per view
+    int shadowMapSize = 1024;
+    // Light that reaches every surface regardless of the lights
+    glm::vec3 ambient = glm::vec3(0.3f);
 };
@@ -2,8 +2,7 @@ QT       += core gui
 
 CONFIG += c++11
 
-INCLUDEPATH += include
-INCLUDEPATH += $$PWD
+include(rasterizer_core.pri)
 
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 
@@ -12,16 +11,8 @@ TEMPLATE = app
 
 
 SOURCES += main.cpp\
-    camera.cpp \
-        mainwindow.cpp \
-    polygon.cpp \
-    rasterizer.cpp \
-    tiny_obj_loader.cc
-
-HEADERS  += mainwindow.h \
-    camera.h \
-    polygon.h \
-    rasterizer.h \
-    tiny_obj_loader.h
+        mainwindow.cpp
+
+HEADERS  += mainwindow.h
 
 FORMS    += mainwindow.ui
@@ -0,0 +1,18 @@
+# Command-line benchmark: rasterizer_bench times the rasterizer on fixed scenes
+# and compares every frame against the golden images in scenes/golden. It
+# needs no display; run it with --help for options.
+QT       += core gui
+
+CONFIG += c++11 console
+CONFIG -= app_bundle
+
+include(rasterizer_core.pri)
+
+TARGET = rasterizer_bench
+TEMPLATE = app
+
+
+SOURCES += bench.cpp
+
+# Fixed scenes and golden images are read from the source tree by default
+DEFINES += RASTERIZER_SCENES=\\\"$$PWD/../scenes\\\"
@@ -0,0 +1,14 @@
+# Headless batch renderer: rasterizer_cli renders a JSON scene along a camera
+# path to image files. It needs no display; run it with --help for options.
+QT       += core gui
+
+CONFIG += c++11 console
+CONFIG -= app_bundle
+
+include(rasterizer_core.pri)
+
+TARGET = rasterizer_cli
+TEMPLATE = app
+
+
+SOURCES += cli.cpp
@@ -0,0 +1,46 @@
+# The rasterizer itself, shared by the GUI (rasterizer.pro), the headless
+# renderer (rasterizer_cli.pro) and the benchmark (rasterizer_bench.pro)
+CONFIG += c++11
+
+INCLUDEPATH += $$PWD/include
+INCLUDEPATH += $$PWD
+
+SOURCES += \
+    $$PWD/bvh.cpp \
+    $$PWD/camera.cpp \
+    $$PWD/clipper.cpp \
+    $$PWD/framebuffer.cpp \
+    $$PWD/hizbuffer.cpp \
+    $$PWD/light.cpp \
+    $$PWD/objloader.cpp \
+    $$PWD/parallel.cpp \
+    $$PWD/polygon.cpp \
+    $$PWD/rasterizer.cpp \
+    $$PWD/rendertask.cpp \
+    $$PWD/reprojection.cpp \
+    $$PWD/sceneloader.cpp \
+    $$PWD/shadowmap.cpp \
+    $$PWD/texture.cpp \
+    $$PWD/vertexbuffer.cpp \
+    $$PWD/vertexstage.cpp
+
+HEADERS += \
+    $$PWD/bvh.h \
+    $$PWD/camera.h \
+    $$PWD/clipper.h \
+    $$PWD/coverage.h \
+    $$PWD/framebuffer.h \
+    $$PWD/hizbuffer.h \
+    $$PWD/light.h \
+    $$PWD/objloader.h \
+    $$PWD/parallel.h \
+    $$PWD/polygon.h \
+    $$PWD/rasterizer.h \
+    $$PWD/rendertask.h \
+    $$PWD/reprojection.h \
+    $$PWD/sceneloader.h \
+    $$PWD/shadowmap.h \
+    $$PWD/simd.h \
+    $$PWD/texture.h \
+    $$PWD/vertexbuffer.h \
+    $$PWD/vertexstage.h
@@ -0,0 +1,36 @@
+#include "rendertask.h"
+
+RenderTask::RenderTask(Rasterizer& rasterizer, const TileCallback& onTile)
+    : m_rasterizer(rasterizer), m_cancel(false), m_finished(false)
+{
+    // Started last, once every member the thread uses exists
+    m_thread = std::thread([this, onTile]() {
+        m_image = m_rasterizer.RenderScene(&m_cancel, onTile);
+        m_finished = true;
+    });
+}
+
+RenderTask::~RenderTask()
+{
+    Cancel();
+    Wait();
+}
+
+void RenderTask::Cancel()
+{
+    m_cancel = true;
+}
+
+bool RenderTask::IsFinished() const
+{
+    return m_finished;
+}
+
+QImage RenderTask::Wait()
+{
+    if(m_thread.joinable())
+    {
+        m_thread.join();
+    }
+    return m_image;
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include <QImage>
+#include <atomic>
+#include <thread>
+#include "rasterizer.h"
+
+// One frame of a Rasterizer rendering on a thread of its own, so the caller
+// stays responsive and can give up on the frame halfway. The rasterizer
+// belongs to the task until it is finished: the caller must not touch it,
+// and must not start another task on it, before Wait returned or the task
+// was destroyed.
+//
+// To replace a frame that is out of date, cancel its task, and start the new
+// one once IsFinished says the old one let go of the rasterizer. RenderScene
+// notices the cancellation within about one tile of work, but destroying a
+// task still blocks until then, so a GUI thread should not.
+class RenderTask
+{
+public:
+    // Starts rendering right away. onTile is passed on to RenderScene.
+    explicit RenderTask(Rasterizer& rasterizer, const TileCallback& onTile = TileCallback());
+    // Cancels the frame if it is still rendering and blocks until the
+    // thread notices
+    ~RenderTask();
+
+    RenderTask(const RenderTask&) = delete;
+    RenderTask& operator=(const RenderTask&) = delete;
+
+    // Asks the frame to stop; returns without waiting for it
+    void Cancel();
+
+    // Whether the frame is done, finished or cancelled; Wait will not block
+    bool IsFinished() const;
+
+    // Blocks until the frame is done. The image is null when the frame was
+    // cancelled before it finished.
+    QImage Wait();
+
+private:
+    Rasterizer& m_rasterizer;
+    std::atomic<bool> m_cancel;
+    std::atomic<bool> m_finished;
+    QImage m_image;
+    std::thread m_thread;
+};
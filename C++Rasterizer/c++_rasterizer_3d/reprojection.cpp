@@ -0,0 +1,79 @@
+#include "reprojection.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace
+{
+// Pixels that come closer than this many times their old distance are still
+// spread over at most MAX_SPLAT x MAX_SPLAT pixels
+const int MAX_SPLAT = 4;
+}
+
+QImage ReprojectFrame(const FrameSnapshot& frame, const Camera& camera)
+{
+    const int width = frame.image.width();
+    const int height = frame.image.height();
+    if(frame.image.isNull() || frame.depth.size() != static_cast<size_t>(width) * height)
+    {
+        return QImage();
+    }
+
+    // Pixel (x, y) at view depth w sits at (ndcX * w / P[0][0], ndcY * w / P[1][1], w)
+    // in the old camera's view space, with ndc = (2x / width - 1, 1 - 2y / height)
+    glm::mat4 oldProjection = frame.camera.GetPerspectiveMatrix();
+    glm::mat4 oldToNew = camera.GetPerspectiveMatrix() * camera.GetViewMatrix()
+                       * glm::inverse(frame.camera.GetViewMatrix());
+    const float nearW = camera.GetNearClip();
+    const float stepX = 2.f / (width * oldProjection[0][0]);
+    const float stepY = -2.f / (height * oldProjection[1][1]);
+
+    QImage image(width, height, QImage::Format_RGB32);
+    image.fill(qRgb(0, 0, 0));
+    std::vector<float> depth(frame.depth.size(), std::numeric_limits<float>::max());
+    for(int y = 0; y < height; ++y)
+    {
+        const QRgb* source = reinterpret_cast<const QRgb*>(frame.image.constScanLine(y));
+        const float* sourceDepth = frame.depth.data() + static_cast<size_t>(y) * width;
+        for(int x = 0; x < width; ++x)
+        {
+            float w = sourceDepth[x];
+            if(w == std::numeric_limits<float>::max())
+            {
+                continue;
+            }
+            glm::vec3 view(w * (x * stepX - 1.f / oldProjection[0][0]),
+                           w * (y * stepY + 1.f / oldProjection[1][1]), w);
+            glm::vec4 clip = oldToNew * glm::vec4(view, 1.f);
+            if(clip.w <= nearW)
+            {
+                continue;
+            }
+
+            // A pixel twice as close covers twice as many pixels per axis
+            int splat = glm::clamp(static_cast<int>(std::ceil(w / clip.w)), 1, MAX_SPLAT);
+            float px = (clip.x / clip.w + 1) * 0.5f * width - 0.5f * (splat - 1);
+            float py = (1 - clip.y / clip.w) * 0.5f * height - 0.5f * (splat - 1);
+            if(px <= -splat || py <= -splat || px >= width || py >= height)
+            {
+                continue;
+            }
+            int minX = static_cast<int>(std::floor(px + 0.5f));
+            int minY = static_cast<int>(std::floor(py + 0.5f));
+            for(int ty = std::max(minY, 0); ty < std::min(minY + splat, height); ++ty)
+            {
+                QRgb* target = reinterpret_cast<QRgb*>(image.scanLine(ty));
+                float* targetDepth = depth.data() + static_cast<size_t>(ty) * width;
+                for(int tx = std::max(minX, 0); tx < std::min(minX + splat, width); ++tx)
+                {
+                    if(clip.w < targetDepth[tx])
+                    {
+                        targetDepth[tx] = clip.w;
+                        target[tx] = source[x];
+                    }
+                }
+            }
+        }
+    }
+    return image;
+}
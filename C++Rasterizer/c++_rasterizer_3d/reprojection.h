@@ -0,0 +1,22 @@
+#pragma once
+#include <QImage>
+#include <vector>
+#include "camera.h"
+
+// A finished frame together with what it takes to show it again from another
+// camera: the view depth of every pixel and the camera it was rendered from.
+struct FrameSnapshot
+{
+    QImage image;
+    // Rows of image.width() entries; float max where nothing was drawn
+    std::vector<float> depth;
+    Camera camera;
+};
+
+// An approximation of what camera sees, made from frame alone. Every pixel
+// of the frame is moved to where its surface lands in the new view, the
+// nearest surface winning where several land on one pixel, and pixels that
+// came closer are spread over as many pixels as they now cover. What the old
+// frame did not see stays black. A cheap stand-in while the real frame renders.
+// Returns a null image for an empty snapshot.
+QImage ReprojectFrame(const FrameSnapshot& frame, const Camera& camera);
@@ -0,0 +1,270 @@
+#include "sceneloader.h"
+#include "objloader.h"
+#include "parallel.h"
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonObject>
+#include <QJsonDocument>
+#include <QJsonArray>
+
+void TextureCache::Load(const QStringList& filenames)
+{
+    QStringList missing;
+    for(const QString& filename : filenames)
+    {
+        if(m_images.find(filename) == m_images.end() && !missing.contains(filename))
+        {
+            missing.append(filename);
+        }
+    }
+
+    std::vector<std::shared_ptr<const QImage>> decoded(missing.size());
+    ParallelFor(missing.size(), [&](int i) {
+        decoded[i] = std::make_shared<const QImage>(missing[i]);
+    });
+    for(int i = 0; i < missing.size(); i++)
+    {
+        m_images[missing[i]] = decoded[i];
+    }
+}
+
+std::shared_ptr<const QImage> TextureCache::Share(const QString& filename) const
+{
+    auto found = m_images.find(filename);
+    return found != m_images.end() ? found->second : std::make_shared<const QImage>();
+}
+
+void TextureCache::Prune()
+{
+    for(auto it = m_images.begin(); it != m_images.end();)
+    {
+        if(it->second.use_count() == 1)
+        {
+            it = m_images.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
+
+namespace
+{
+// An "obj" entry of a scene, with its mesh once it has been read
+struct MeshJob
+{
+    QString filename;
+    VertexPrecision precision;
+    VertexBuffer vertices;
+    std::vector<Triangle> triangles;
+    QString error;
+    bool loaded;
+};
+
+glm::vec3 ReadVec3(const QJsonValue& value)
+{
+    QJsonArray arr = value.toArray();
+    return glm::vec3(arr[0].toDouble(), arr[1].toDouble(), arr[2].toDouble());
+}
+
+// Reads one entry of a scene's "lights" array. Returns false for an entry
+// of unknown type.
+bool ReadLight(const QJsonObject& obj, Light& light)
+{
+    QString type = obj["type"].toString();
+    glm::vec3 color = obj.contains(QString("color")) ? ReadVec3(obj["color"]) : glm::vec3(1.f);
+    if(QString::compare(type, QString("directional")) == 0)
+    {
+        light = Light::Directional(ReadVec3(obj["direction"]), color);
+    }
+    else if(QString::compare(type, QString("point")) == 0)
+    {
+        light = Light::Point(ReadVec3(obj["position"]), color, obj["range"].toDouble());
+    }
+    else if(QString::compare(type, QString("spot")) == 0)
+    {
+        light = Light::Spot(ReadVec3(obj["position"]), ReadVec3(obj["direction"]), color,
+                            obj["range"].toDouble(), obj["innerCone"].toDouble(), obj["outerCone"].toDouble());
+    }
+    else
+    {
+        return false;
+    }
+    light.castsShadows = obj["castsShadows"].toBool(false);
+    return true;
+}
+}
+
+bool LoadScene(const QString& filename, std::vector<Polygon>& polygons, QString* error, TextureCache* textures,
+               std::vector<Light>* lights)
+{
+    QFile file(filename);
+    if(!file.open(QIODevice::ReadOnly))
+    {
+        if(error)
+        {
+            *error = QString("Could not open the JSON file %1.").arg(filename);
+        }
+        return false;
+    }
+    QByteArray file_data = file.readAll();
+    QString local_path = QFileInfo(filename).absolutePath() + "/";
+
+    QJsonParseError parseError;
+    QJsonDocument jdoc(QJsonDocument::fromJson(file_data, &parseError));
+    if(jdoc.isNull())
+    {
+        if(error)
+        {
+            *error = QString("%1: %2").arg(filename, parseError.errorString());
+        }
+        return false;
+    }
+
+    // The lights are read first, since a bad entry fails the whole load
+    // and polygons must not be touched then
+    QJsonArray lightArray = jdoc.object()["lights"].toArray();
+    std::vector<Light> sceneLights;
+    for(int i = 0; i < lightArray.size(); i++)
+    {
+        Light light;
+        if(!ReadLight(lightArray[i].toObject(), light))
+        {
+            if(error)
+            {
+                *error = QString("%1: light %2 has the unknown type \"%3\".")
+                             .arg(filename, QString::number(i), lightArray[i].toObject()["type"].toString());
+            }
+            return false;
+        }
+        sceneLights.push_back(light);
+    }
+
+    // Gather every file the scene needs before reading any of them, so the
+    // meshes and images can all be read at the same time
+    QJsonArray objects = jdoc.object()["objects"].toArray();
+    std::vector<MeshJob> meshes;
+    QStringList images;
+    for(int i = 0; i < objects.size(); i++)
+    {
+        QJsonObject obj = objects[i].toObject();
+        if(QString::compare(obj["type"].toString(), QString("obj")) == 0)
+        {
+            MeshJob mesh;
+            mesh.filename = local_path + obj["filename"].toString();
+            // Meshes are quantized unless the entry asks for full precision
+            mesh.precision = obj["quantize"].toBool(true) ? VertexPrecision::Quantized : VertexPrecision::Full;
+            mesh.loaded = false;
+            meshes.push_back(mesh);
+            images.append(local_path + obj["texture"].toString());
+            if(obj.contains(QString("normalMap")))
+            {
+                images.append(local_path + obj["normalMap"].toString());
+            }
+        }
+    }
+
+    // Every mesh and the whole batch of images are one work item each.
+    // ParallelFor nests, so each of them still spreads its own work over
+    // the pool while it runs.
+    TextureCache sceneTextures;
+    TextureCache& cache = textures ? *textures : sceneTextures;
+    int meshCount = static_cast<int>(meshes.size());
+    ParallelFor(meshCount + 1, [&](int job) {
+        if(job == meshCount)
+        {
+            cache.Load(images);
+            return;
+        }
+        MeshJob& mesh = meshes[job];
+        mesh.loaded = LoadOBJFile(mesh.filename, mesh.vertices, mesh.triangles, mesh.precision, &mesh.error);
+    });
+    for(const MeshJob& mesh : meshes)
+    {
+        if(!mesh.loaded)
+        {
+            if(error)
+            {
+                *error = mesh.error;
+            }
+            return false;
+        }
+    }
+
+    // Build the polygons in place, in the order of the file
+    polygons.reserve(polygons.size() + objects.size());
+    size_t mesh = 0;
+    for(int i = 0; i < objects.size(); i++)
+    {
+        QJsonObject obj = objects[i].toObject();
+        QString type = obj["type"].toString();
+        //Custom Polygon case
+        if(QString::compare(type, QString("custom")) == 0)
+        {
+            std::vector<glm::vec4> vert_pos;
+            std::vector<glm::vec3> vert_col;
+            QString name = obj["name"].toString();
+            QJsonArray pos = obj["vertexPos"].toArray();
+            for(int j = 0; j < pos.size(); j++)
+            {
+                QJsonArray arr = pos[j].toArray();
+                glm::vec4 p(arr[0].toDouble(), arr[1].toDouble(), arr[2].toDouble(), 1);
+                vert_pos.push_back(p);
+            }
+            QJsonArray col = obj["vertexCol"].toArray();
+            for(int j = 0; j < col.size(); j++)
+            {
+                QJsonArray arr = col[j].toArray();
+                glm::vec3 c(arr[0].toDouble(), arr[1].toDouble(), arr[2].toDouble());
+                vert_col.push_back(c);
+            }
+            polygons.emplace_back(name, vert_pos, vert_col);
+        }
+        //Regular Polygon case
+        else if(QString::compare(type, QString("regular")) == 0)
+        {
+            QString name = obj["name"].toString();
+            int sides = obj["sides"].toInt();
+            QJsonArray colorA = obj["color"].toArray();
+            glm::vec3 color(colorA[0].toDouble(), colorA[1].toDouble(), colorA[2].toDouble());
+            QJsonArray posA = obj["pos"].toArray();
+            glm::vec4 pos(posA[0].toDouble(), posA[1].toDouble(), posA[2].toDouble(),1);
+            float rot = obj["rot"].toDouble();
+            QJsonArray scaleA = obj["scale"].toArray();
+            glm::vec4 scale(scaleA[0].toDouble(), scaleA[1].toDouble(), scaleA[2].toDouble(),1);
+            polygons.emplace_back(name, sides, color, pos, rot, scale);
+        }
+        //OBJ file case
+        else if(QString::compare(type, QString("obj")) == 0)
+        {
+            polygons.emplace_back(obj["name"].toString());
+            Polygon& p = polygons.back();
+            p.m_verts = std::move(meshes[mesh].vertices);
+            p.m_tris.swap(meshes[mesh].triangles);
+            mesh++;
+            p.SetTexture(cache.Share(local_path + obj["texture"].toString()));
+            if(obj.contains(QString("normalMap")))
+            {
+                p.SetNormalMap(cache.Share(local_path + obj["normalMap"].toString()));
+            }
+        }
+    }
+    if(lights)
+    {
+        lights->insert(lights->end(), sceneLights.begin(), sceneLights.end());
+    }
+    return true;
+}
+
+Polygon LoadOBJ(const QString &file, const QString &polyName)
+{
+    Polygon p(polyName);
+    QString error;
+    if(!LoadOBJFile(file, p.m_verts, p.m_tris, VertexPrecision::Quantized, &error))
+    {
+        //An error loading the OBJ occurred!
+        qWarning("%s", qPrintable(error));
+    }
+    return p;
+}
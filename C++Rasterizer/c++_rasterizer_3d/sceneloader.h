@@ -0,0 +1,58 @@
+#pragma once
+#include <QImage>
+#include <QString>
+#include <QStringList>
+#include <map>
+#include <memory>
+#include <vector>
+#include "light.h"
+#include "polygon.h"
+
+// The registry of decoded images by file name. Scenes usually reuse a
+// handful of textures across many objects, so each file is decoded once and
+// every polygon using it holds a handle to the same QImage. An image that
+// only the registry still holds is no longer used by any polygon, and Prune
+// drops it. Keeping one registry across several loads also saves decoding
+// the textures that the next scene has in common with the last one.
+//
+// Not thread-safe; Load spreads the decoding over the worker pool itself.
+class TextureCache
+{
+public:
+    // Decodes every file that is not registered yet, in parallel
+    void Load(const QStringList& filenames);
+
+    // The handle to the image of a file, for Polygon::SetTexture and
+    // SetNormalMap. The file must have been passed to Load before.
+    std::shared_ptr<const QImage> Share(const QString& filename) const;
+
+    // Forgets every image that only the registry still refers to
+    void Prune();
+
+private:
+    std::map<QString, std::shared_ptr<const QImage>> m_images;
+};
+
+// Reads a scene file in the JSON format of the scenes folder: an "objects"
+// array of "custom", "regular" and "obj" entries. File names inside it are
+// relative to the scene file. The vertices of "obj" entries are quantized
+// unless the entry sets "quantize" to false. The OBJ files and textures of the scene are
+// read in parallel, and images are taken from and added to textures when
+// one is given. The new polygons are appended to polygons in the order of
+// the file.
+//
+// An optional "lights" array holds "directional", "point" and "spot"
+// entries with the fields of Light: "color" (white when left out),
+// "position", "direction", "range", "innerCone" and "outerCone" as the type
+// needs them, and "castsShadows" (false when left out). They are appended
+// to lights when one is given.
+//
+// Returns false and describes the problem in error when a file cannot be
+// read or a light has an unknown type; polygons and lights are left
+// unchanged then.
+bool LoadScene(const QString& filename, std::vector<Polygon>& polygons, QString* error = nullptr,
+               TextureCache* textures = nullptr, std::vector<Light>* lights = nullptr);
+
+// Loads all shapes of an OBJ file into a single Polygon. A file that cannot
+// be read gives an empty Polygon.
+Polygon LoadOBJ(const QString& file, const QString& polyName);
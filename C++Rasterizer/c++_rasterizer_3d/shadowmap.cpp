@@ -0,0 +1,192 @@
+#include "shadowmap.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace
+{
+// A view from eye along forward with a square field of view whose half-width
+// at view depth 1 is tanHalf. Like the camera's, it keeps the view depth in
+// clip w, which is all the rasterizer's depth pass interpolates.
+ShadowMap::View MakeView(const glm::vec3& eye, const glm::vec3& forward, float tanHalf, float nearW, int size)
+{
+    glm::vec3 F = glm::normalize(forward);
+    glm::vec3 up = std::abs(F.y) > 0.99f ? glm::vec3(1.f, 0.f, 0.f) : glm::vec3(0.f, 1.f, 0.f);
+    glm::vec3 R = glm::normalize(glm::cross(F, up));
+    glm::vec3 U = glm::cross(R, F);
+    glm::mat4 view(glm::vec4(R.x, U.x, F.x, 0.f),
+                   glm::vec4(R.y, U.y, F.y, 0.f),
+                   glm::vec4(R.z, U.z, F.z, 0.f),
+                   glm::vec4(-glm::dot(R, eye), -glm::dot(U, eye), -glm::dot(F, eye), 1.f));
+    float scale = 1.f / tanHalf;
+    glm::mat4 projection(glm::vec4(scale, 0.f, 0.f, 0.f),
+                         glm::vec4(0.f, scale, 0.f, 0.f),
+                         glm::vec4(0.f, 0.f, 1.f, 1.f),
+                         glm::vec4(0.f));
+
+    ShadowMap::View result;
+    result.view = view;
+    result.projection = projection;
+    result.viewProj = projection * view;
+    result.nearW = nearW;
+    result.texelScale = 2.f * tanHalf / size;
+    result.depth.resize(static_cast<size_t>(size) * size);
+    return result;
+}
+
+// The weights along one axis of a tent filter two texels wide on each side
+// of the lookup, fraction of a texel past texel x0: four taps starting at
+// x0 - 1. Each is the tent's height at the tap's texel, divided by their
+// sum of 2. A lookup right on a texel weighs it and its neighbours
+// 1/4, 1/2, 1/4, and the weights slide linearly to the next texel.
+void TentWeights(float fraction, float weights[4])
+{
+    weights[0] = (1.f - fraction) * 0.25f;
+    weights[1] = (2.f - fraction) * 0.25f;
+    weights[2] = (1.f + fraction) * 0.25f;
+    weights[3] = fraction * 0.25f;
+}
+}
+
+ShadowMap::ShadowMap()
+    : m_size(0), m_cube(false), m_center(0.f), m_range(0.f)
+{}
+
+void ShadowMap::Setup(const Light& light, const Bounds& sceneBounds, int size)
+{
+    m_size = size;
+    m_cube = false;
+    m_center = light.position;
+    m_range = light.type == LightType::Directional ? std::numeric_limits<float>::infinity() : light.range;
+    m_views.clear();
+    float nearW = std::max(light.range * 0.001f, 1e-3f);
+
+    switch(light.type)
+    {
+    case LightType::Spot:
+    {
+        float tanHalf = std::tan(glm::radians(std::min(light.outerCone, 89.f)));
+        m_views.push_back(MakeView(light.position, light.direction, tanHalf, nearW, size));
+        break;
+    }
+    case LightType::Point:
+    {
+        // Each face of the cube sees exactly the directions whose largest
+        // component is along its axis
+        m_cube = true;
+        for(int axis = 0; axis < 3; ++axis)
+        {
+            for(float sign : {1.f, -1.f})
+            {
+                glm::vec3 forward(0.f);
+                forward[axis] = sign;
+                m_views.push_back(MakeView(light.position, forward, 1.f, nearW, size));
+            }
+        }
+        break;
+    }
+    case LightType::Directional:
+    {
+        if(sceneBounds.min.x > sceneBounds.max.x)
+        {
+            break;
+        }
+        // Parallel rays would take an orthographic view, which the
+        // rasterizer's perspective-correct depth cannot express. A view from
+        // far away that just fits the scene's bounding sphere is close enough.
+        glm::vec3 center = sceneBounds.Center();
+        float radius = std::max(0.5f * glm::length(sceneBounds.max - sceneBounds.min), 1e-3f);
+        float distance = 16.f * radius;
+        glm::vec3 direction = glm::normalize(light.direction);
+        float tanHalf = radius / std::sqrt(distance * distance - radius * radius);
+        m_views.push_back(MakeView(center - direction * distance, direction, tanHalf,
+                                   0.99f * (distance - radius), size));
+        break;
+    }
+    }
+}
+
+int ShadowMap::Size() const
+{
+    return m_size;
+}
+
+std::vector<ShadowMap::View>& ShadowMap::Views()
+{
+    return m_views;
+}
+
+int ShadowMap::ClassifyRange(const Bounds& bounds) const
+{
+    // The box's nearest and farthest points from the light
+    glm::vec3 nearest = glm::clamp(m_center, bounds.min, bounds.max) - m_center;
+    glm::vec3 farthest = glm::max(glm::abs(bounds.min - m_center), glm::abs(bounds.max - m_center));
+    float rangeSq = m_range * m_range;
+    if(glm::dot(nearest, nearest) >= rangeSq)
+    {
+        return -1;
+    }
+    return glm::dot(farthest, farthest) < rangeSq ? 1 : 0;
+}
+
+float ShadowMap::Visibility(const glm::vec3& point, const glm::vec3& normal) const
+{
+    if(m_views.empty())
+    {
+        return 1.f;
+    }
+
+    const View* view = &m_views[0];
+    if(m_cube)
+    {
+        glm::vec3 offset = point - m_center;
+        glm::vec3 extent = glm::abs(offset);
+        int axis = extent.x >= extent.y ? (extent.x >= extent.z ? 0 : 2) : (extent.y >= extent.z ? 1 : 2);
+        view = &m_views[axis * 2 + (offset[axis] < 0.f)];
+    }
+
+    float w = (view->viewProj * glm::vec4(point, 1.f)).w;
+    if(w <= view->nearW)
+    {
+        return 1.f;
+    }
+    // A texel covers this much of the surface around point. Pushing the
+    // lookup out past the filter's reach of two texels keeps a surface from
+    // shadowing itself.
+    float texel = w * view->texelScale;
+    glm::vec4 clip = view->viewProj * glm::vec4(point + 2.f * texel * normal, 1.f);
+    if(clip.w <= view->nearW)
+    {
+        return 1.f;
+    }
+
+    // Texel (x, y) holds the depth seen at pixel position (x, y)
+    float px = (clip.x / clip.w + 1) * 0.5f * m_size;
+    float py = (1 - clip.y / clip.w) * 0.5f * m_size;
+    if(px < -1.f || py < -1.f || px > m_size || py > m_size)
+    {
+        return 1.f;
+    }
+    float x0 = std::floor(px);
+    float y0 = std::floor(py);
+    float weightsX[4], weightsY[4];
+    TentWeights(px - x0, weightsX);
+    TentWeights(py - y0, weightsY);
+
+    float receiver = clip.w - texel;
+    float lit = 0.f;
+    for(int j = 0; j < 4; ++j)
+    {
+        int y = glm::clamp(static_cast<int>(y0) - 1 + j, 0, m_size - 1);
+        const float* row = view->depth.data() + static_cast<size_t>(y) * m_size;
+        for(int i = 0; i < 4; ++i)
+        {
+            int x = glm::clamp(static_cast<int>(x0) - 1 + i, 0, m_size - 1);
+            if(receiver <= row[x])
+            {
+                lit += weightsX[i] * weightsY[j];
+            }
+        }
+    }
+    return lit;
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <vector>
+#include "bvh.h"
+#include "light.h"
+
+// Depth images of the scene as seen from a light, for telling which points
+// the light reaches. Every view is a perspective projection that stores the
+// view depth of the nearest surface per texel, exactly what the rasterizer's
+// z-buffer holds, so views are rendered by the same pipeline as the frame.
+//
+// Spot lights take one view along their cone and point lights six, one per
+// face of a cube around them. Directional lights take one view from far
+// away, narrow enough that its rays are nearly parallel, fitted around the
+// whole scene.
+class ShadowMap
+{
+public:
+    struct View
+    {
+        glm::mat4 view;
+        glm::mat4 projection;
+        glm::mat4 viewProj; // projection * view
+        float nearW;
+        float texelScale; // World-space size of a texel at view depth 1
+        std::vector<float> depth;
+    };
+
+    ShadowMap();
+
+    // Places the views for light around a scene with the given bounds,
+    // size x size texels each. The depth images still have to be rendered.
+    void Setup(const Light& light, const Bounds& sceneBounds, int size);
+
+    int Size() const;
+    std::vector<View>& Views();
+
+    // Classifies a world-space box against the sphere the light reaches
+    // the way the rasterizer classifies boxes against a view: -1 when the
+    // box is entirely beyond the light's range, 1 when it is entirely
+    // within it and 0 otherwise. Directional lights reach every box.
+    int ClassifyRange(const Bounds& bounds) const;
+
+    // The fraction of the light that reaches point, from 0 in full shadow to
+    // 1 fully lit. The depth comparisons of the 4x4 texels around point are
+    // weighed with a tent filter two texels wide on each side
+    // (percentage-closer filtering), and the lookup is pushed two texels
+    // away from the surface along normal so it does not shadow itself.
+    float Visibility(const glm::vec3& point, const glm::vec3& normal) const;
+
+private:
+    int m_size;
+    bool m_cube;
+    glm::vec3 m_center; // Of the cube, for point lights
+    float m_range;      // Infinite for directional lights
+    std::vector<View> m_views;
+};
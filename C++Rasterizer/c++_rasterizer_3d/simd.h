@@ -0,0 +1,16 @@
+#pragma once
+
+// Picks the widest SIMD instruction set the compiler was told it may use.
+// Code that uses intrinsics checks these macros and keeps a scalar fallback.
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define RASTERIZER_AVX2
+#define RASTERIZER_SSE2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define RASTERIZER_SSE2
+#endif
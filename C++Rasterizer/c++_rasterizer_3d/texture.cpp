@@ -0,0 +1,152 @@
+#include "texture.h"
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+// Spreads the three bits of a coordinate inside a tile onto the even bits,
+// so that x and y interleave into a Morton index
+const uint8_t MORTON_SPREAD[8] = {0, 1, 4, 5, 16, 17, 20, 21};
+
+glm::vec3 Unpack(QRgb color)
+{
+    return glm::vec3(qRed(color), qGreen(color), qBlue(color));
+}
+}
+
+Texture::Texture(const QImage& image)
+{
+    QImage source = image.convertToFormat(QImage::Format_RGB32);
+
+    // Level 0 is the image itself, then each level halves the one before it
+    int width = std::max(source.width(), 1);
+    int height = std::max(source.height(), 1);
+    while(true)
+    {
+        Level level;
+        level.width = width;
+        level.height = height;
+        level.tilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+        int tilesY = (height + TILE_SIZE - 1) / TILE_SIZE;
+        level.texels.resize(static_cast<size_t>(level.tilesX) * tilesY * TILE_SIZE * TILE_SIZE);
+
+        if(m_levels.empty())
+        {
+            for(int y = 0; y < height; ++y)
+            {
+                const QRgb* scanLine = source.isNull() ? nullptr
+                                     : reinterpret_cast<const QRgb*>(source.constScanLine(y));
+                for(int x = 0; x < width; ++x)
+                {
+                    level.texels[TexelIndex(level, x, y)] = scanLine ? scanLine[x] : qRgb(255, 255, 255);
+                }
+            }
+        }
+        else
+        {
+            // Box filter over the 2x2 texels each texel covers in the level above
+            const Level& above = m_levels.back();
+            for(int y = 0; y < height; ++y)
+            {
+                for(int x = 0; x < width; ++x)
+                {
+                    glm::vec3 sum = Unpack(Fetch(above, 2 * x, 2 * y)) + Unpack(Fetch(above, 2 * x + 1, 2 * y))
+                                  + Unpack(Fetch(above, 2 * x, 2 * y + 1)) + Unpack(Fetch(above, 2 * x + 1, 2 * y + 1));
+                    sum = sum * 0.25f + 0.5f;
+                    level.texels[TexelIndex(level, x, y)] = qRgb(int(sum.x), int(sum.y), int(sum.z));
+                }
+            }
+        }
+        m_levels.push_back(std::move(level));
+
+        if(width == 1 && height == 1)
+        {
+            break;
+        }
+        width = std::max(width / 2, 1);
+        height = std::max(height / 2, 1);
+    }
+}
+
+int Texture::Width() const
+{
+    return m_levels[0].width;
+}
+
+int Texture::Height() const
+{
+    return m_levels[0].height;
+}
+
+int Texture::Levels() const
+{
+    return static_cast<int>(m_levels.size());
+}
+
+size_t Texture::TexelIndex(const Level& level, int x, int y)
+{
+    size_t tile = static_cast<size_t>(y / TILE_SIZE) * level.tilesX + x / TILE_SIZE;
+    int inTile = MORTON_SPREAD[x % TILE_SIZE] | (MORTON_SPREAD[y % TILE_SIZE] << 1);
+    return tile * TILE_SIZE * TILE_SIZE + inTile;
+}
+
+QRgb Texture::Fetch(const Level& level, int x, int y)
+{
+    x = std::min(std::max(x, 0), level.width - 1);
+    y = std::min(std::max(y, 0), level.height - 1);
+    return level.texels[TexelIndex(level, x, y)];
+}
+
+glm::vec3 Texture::Bilinear(const Level& level, const glm::vec2& uv)
+{
+    // Texel centers sit at half-integer positions
+    float s = uv.x * level.width - 0.5f;
+    float t = (1.0f - uv.y) * level.height - 0.5f;
+    float x0 = std::floor(s);
+    float y0 = std::floor(t);
+    float fx = s - x0;
+    float fy = t - y0;
+    int x = static_cast<int>(x0);
+    int y = static_cast<int>(y0);
+
+    glm::vec3 top = glm::mix(Unpack(Fetch(level, x, y)), Unpack(Fetch(level, x + 1, y)), fx);
+    glm::vec3 bottom = glm::mix(Unpack(Fetch(level, x, y + 1)), Unpack(Fetch(level, x + 1, y + 1)), fx);
+    return glm::mix(top, bottom, fy);
+}
+
+glm::vec3 Texture::Sample(const glm::vec2& uv, const glm::vec2& dUVdx, const glm::vec2& dUVdy,
+                          TextureFilter filter) const
+{
+    const Level& base = m_levels[0];
+    glm::vec2 clamped = glm::clamp(uv, glm::vec2(0.f), glm::vec2(1.f));
+
+    if(filter == TextureFilter::Nearest)
+    {
+        int x = static_cast<int>(glm::min(base.width * clamped.x, base.width - 1.0f));
+        int y = static_cast<int>(glm::min(base.height * (1.0f - clamped.y), base.height - 1.0f));
+        return Unpack(Fetch(base, x, y));
+    }
+
+    // The level whose texels are about as large as the pixel's footprint.
+    // Magnified textures (and degenerate derivatives) use the full image.
+    glm::vec2 size(base.width, base.height);
+    glm::vec2 footprintX = dUVdx * size;
+    glm::vec2 footprintY = dUVdy * size;
+    float footprint = std::max(glm::dot(footprintX, footprintX), glm::dot(footprintY, footprintY));
+    float lod = footprint > 1.f ? 0.5f * std::log2(footprint) : 0.f;
+    lod = std::min(lod, static_cast<float>(Levels() - 1));
+
+    if(filter == TextureFilter::Bilinear)
+    {
+        return Bilinear(m_levels[static_cast<int>(lod + 0.5f)], clamped);
+    }
+
+    int level = static_cast<int>(lod);
+    float blend = lod - level;
+    glm::vec3 color = Bilinear(m_levels[level], clamped);
+    if(blend > 0.f && level + 1 < Levels())
+    {
+        color = glm::mix(color, Bilinear(m_levels[level + 1], clamped), blend);
+    }
+    return color;
+}
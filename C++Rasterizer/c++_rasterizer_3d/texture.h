@@ -0,0 +1,50 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <QImage>
+#include <cstdint>
+#include <vector>
+
+enum class TextureFilter : uint8_t
+{
+    Nearest,  // One texel of the full resolution image, like GetImageColor
+    Bilinear, // Four texels of the mip level closest to the pixel's footprint
+    Trilinear // Bilinear in the two mip levels around the footprint, blended
+};
+
+// An image prepared for sampling during rasterization. It is built once from
+// a Polygon's QImage: the full chain of mip levels is precomputed, and every
+// level stores its texels in 8x8 tiles, ordered along a Morton curve inside
+// each tile, so the texels a filter reads together share cache lines instead
+// of being a whole image row apart.
+class Texture
+{
+public:
+    explicit Texture(const QImage& image);
+
+    int Width() const;
+    int Height() const;
+    int Levels() const;
+
+    // The color at uv, 0 to 255 per channel. uv follows GetImageColor's
+    // convention (v points up) and is clamped to the image. The screen-space
+    // derivatives of uv size the pixel's footprint, which picks the mip level.
+    glm::vec3 Sample(const glm::vec2& uv, const glm::vec2& dUVdx, const glm::vec2& dUVdy,
+                     TextureFilter filter) const;
+
+private:
+    static const int TILE_SIZE = 8;
+
+    struct Level
+    {
+        int width;
+        int height;
+        int tilesX;
+        std::vector<QRgb> texels;
+    };
+
+    static size_t TexelIndex(const Level& level, int x, int y);
+    static QRgb Fetch(const Level& level, int x, int y);
+    static glm::vec3 Bilinear(const Level& level, const glm::vec2& uv);
+
+    std::vector<Level> m_levels;
+};
@@ -0,0 +1,577 @@
+#include "vertexbuffer.h"
+#include "parallel.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <unordered_map>
+
+namespace
+{
+// Vertices are packed in parallel in blocks of this many
+const size_t PACK_BLOCK = 16384;
+
+const float QUANTIZED_MAX = 65535.f;
+
+// The packed normal of vertices without one; octahedral coordinates never
+// use -32768, since they are scaled to [-32767, 32767]
+const uint32_t NO_NORMAL = 0x80008000u;
+
+// The packed tangent of vertices without one; x never uses -32768 either
+const uint32_t NO_TANGENT = 0x00008000u;
+
+// Set in a packed tangent when its bitangent is -cross(normal, tangent)
+const uint32_t TANGENT_FLIPPED = 0x80000000u;
+
+float SignNotZero(float value)
+{
+    return value >= 0.f ? 1.f : -1.f;
+}
+
+uint32_t PackSnorm16(float value)
+{
+    return static_cast<uint16_t>(static_cast<int16_t>(std::round(glm::clamp(value, -1.f, 1.f) * 32767.f)));
+}
+
+float UnpackSnorm16(uint32_t bits)
+{
+    return static_cast<int16_t>(static_cast<uint16_t>(bits)) / 32767.f;
+}
+
+// The low 15 bits of the result, scaled to [-16383, 16383]
+uint32_t PackSnorm15(float value)
+{
+    return static_cast<uint16_t>(static_cast<int16_t>(std::round(glm::clamp(value, -1.f, 1.f) * 16383.f))) & 0x7fffu;
+}
+
+float UnpackSnorm15(uint32_t bits)
+{
+    // Shifting the sign bit into place sign-extends; the value stays even
+    return static_cast<int16_t>(static_cast<uint16_t>(bits << 1)) / 2 / 16383.f;
+}
+
+// Folds the unit sphere onto the square [-1, 1]^2: the upper half maps to
+// the diamond in its middle and the lower half to the corners around it.
+// direction must not be zero.
+glm::vec2 EncodeOctahedral(const glm::vec3& direction)
+{
+    float length = std::abs(direction.x) + std::abs(direction.y) + std::abs(direction.z);
+    glm::vec2 p = glm::vec2(direction) / length;
+    if(direction.z < 0.f)
+    {
+        p = glm::vec2((1.f - std::abs(p.y)) * SignNotZero(p.x), (1.f - std::abs(p.x)) * SignNotZero(p.y));
+    }
+    return p;
+}
+
+glm::vec3 DecodeOctahedral(const glm::vec2& p)
+{
+    glm::vec3 direction(p, 1.f - std::abs(p.x) - std::abs(p.y));
+    if(direction.z < 0.f)
+    {
+        direction.x = (1.f - std::abs(p.y)) * SignNotZero(p.x);
+        direction.y = (1.f - std::abs(p.x)) * SignNotZero(p.y);
+    }
+    return glm::normalize(direction);
+}
+
+uint32_t EncodeNormal(const glm::vec3& normal)
+{
+    if(normal == glm::vec3(0.f))
+    {
+        return NO_NORMAL;
+    }
+    glm::vec2 p = EncodeOctahedral(normal);
+    return PackSnorm16(p.x) | (PackSnorm16(p.y) << 16);
+}
+
+glm::vec3 DecodeNormal(uint32_t bits)
+{
+    if(bits == NO_NORMAL)
+    {
+        return glm::vec3(0.f);
+    }
+    return DecodeOctahedral(glm::vec2(UnpackSnorm16(bits), UnpackSnorm16(bits >> 16)));
+}
+
+// Like a normal, but y only gets 15 bits so the sign of w fits in the top one
+uint32_t EncodeTangent(const glm::vec4& tangent)
+{
+    if(tangent.w == 0.f || glm::vec3(tangent) == glm::vec3(0.f))
+    {
+        return NO_TANGENT;
+    }
+    glm::vec2 p = EncodeOctahedral(glm::vec3(tangent));
+    return PackSnorm16(p.x) | (PackSnorm15(p.y) << 16) | (tangent.w < 0.f ? TANGENT_FLIPPED : 0u);
+}
+
+glm::vec4 DecodeTangent(uint32_t bits)
+{
+    if(bits == NO_TANGENT)
+    {
+        return glm::vec4(0.f);
+    }
+    glm::vec3 tangent = DecodeOctahedral(glm::vec2(UnpackSnorm16(bits), UnpackSnorm15(bits >> 16)));
+    return glm::vec4(tangent, (bits & TANGENT_FLIPPED) ? -1.f : 1.f);
+}
+
+uint32_t EncodeColor(const glm::vec3& color)
+{
+    glm::vec3 c = glm::clamp(glm::round(color), 0.f, 255.f);
+    return (static_cast<uint32_t>(c.x) << 16) | (static_cast<uint32_t>(c.y) << 8) | static_cast<uint32_t>(c.z);
+}
+
+uint16_t Quantize(float value, float origin, float step)
+{
+    if(step == 0.f)
+    {
+        return 0;
+    }
+    return static_cast<uint16_t>(glm::clamp(std::round((value - origin) / step), 0.f, QUANTIZED_MAX));
+}
+
+// Whether value is within half a step of the range a quantized value covers
+bool InRange(float value, float origin, float step)
+{
+    if(step == 0.f)
+    {
+        return value == origin;
+    }
+    float q = (value - origin) / step;
+    return q >= -0.5f && q <= QUANTIZED_MAX + 0.5f;
+}
+
+uint32_t FloatBits(float value)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+typedef std::array<uint32_t, 8> VertexKey;
+
+struct VertexKeyHash
+{
+    size_t operator()(const VertexKey& key) const
+    {
+        uint64_t h = 0;
+        for(uint32_t word : key)
+        {
+            h = (h ^ word) * 0x100000001B3ull;
+        }
+        return static_cast<size_t>(h ^ (h >> 32));
+    }
+};
+
+// Moves every element i of values with keep[i] down to index remap[i]
+template <typename T>
+void CompactArray(std::vector<T>& values, const std::vector<uint8_t>& keep, const std::vector<uint32_t>& remap,
+                  size_t count)
+{
+    if(values.empty())
+    {
+        return;
+    }
+    for(size_t i = 0; i < keep.size(); ++i)
+    {
+        if(keep[i])
+        {
+            values[remap[i]] = values[i];
+        }
+    }
+    values.resize(count);
+}
+}
+
+VertexBuffer::VertexBuffer()
+    : m_precision(VertexPrecision::Full),
+      m_positionOrigin(0.f), m_positionStep(0.f), m_uvOrigin(0.f), m_uvStep(0.f)
+{}
+
+size_t VertexBuffer::size() const
+{
+    return m_normal.size();
+}
+
+bool VertexBuffer::empty() const
+{
+    return m_normal.empty();
+}
+
+void VertexBuffer::reserve(size_t count)
+{
+    bool quantized = m_precision == VertexPrecision::Quantized;
+    for(int axis = 0; axis < 3; ++axis)
+    {
+        if(quantized)
+        {
+            m_quantizedPosition[axis].reserve(count);
+        }
+        else
+        {
+            m_position[axis].reserve(count);
+        }
+    }
+    for(int axis = 0; axis < 2; ++axis)
+    {
+        if(quantized)
+        {
+            m_quantizedUV[axis].reserve(count);
+        }
+        else
+        {
+            m_uv[axis].reserve(count);
+        }
+    }
+    m_normal.reserve(count);
+    m_tangent.reserve(count);
+    m_color.reserve(count);
+}
+
+void VertexBuffer::clear()
+{
+    Resize(0);
+}
+
+void VertexBuffer::push_back(const Vertex& vertex)
+{
+    if(!Representable(vertex))
+    {
+        std::vector<Vertex> vertices = Unpack();
+        vertices.push_back(vertex);
+        Assign(vertices, m_precision);
+        return;
+    }
+    size_t index = size();
+    Resize(index + 1);
+    Write(index, vertex);
+}
+
+Vertex VertexBuffer::operator[](size_t index) const
+{
+    return Vertex(glm::vec4(Position(index), 1.f), Color(index), glm::vec4(Normal(index), 0.f), UV(index),
+                  Tangent(index));
+}
+
+void VertexBuffer::Set(size_t index, const Vertex& vertex)
+{
+    if(!Representable(vertex))
+    {
+        std::vector<Vertex> vertices = Unpack();
+        vertices[index] = vertex;
+        Assign(vertices, m_precision);
+        return;
+    }
+    Write(index, vertex);
+}
+
+void VertexBuffer::Assign(const std::vector<Vertex>& vertices, VertexPrecision precision)
+{
+    m_precision = precision;
+    if(precision == VertexPrecision::Quantized)
+    {
+        FitQuantization(vertices);
+    }
+    // Drops the arrays of the other precision
+    for(int axis = 0; axis < 3; ++axis)
+    {
+        std::vector<float>().swap(m_position[axis]);
+        std::vector<uint16_t>().swap(m_quantizedPosition[axis]);
+    }
+    for(int axis = 0; axis < 2; ++axis)
+    {
+        std::vector<float>().swap(m_uv[axis]);
+        std::vector<uint16_t>().swap(m_quantizedUV[axis]);
+    }
+    Resize(vertices.size());
+
+    int blocks = static_cast<int>((vertices.size() + PACK_BLOCK - 1) / PACK_BLOCK);
+    ParallelFor(blocks, [&](int block) {
+        size_t end = std::min(vertices.size(), (block + 1) * PACK_BLOCK);
+        for(size_t i = block * PACK_BLOCK; i < end; ++i)
+        {
+            Write(i, vertices[i]);
+        }
+    });
+}
+
+void VertexBuffer::SetPrecision(VertexPrecision precision)
+{
+    if(precision != m_precision)
+    {
+        Assign(Unpack(), precision);
+    }
+}
+
+VertexPrecision VertexBuffer::Precision() const
+{
+    return m_precision;
+}
+
+std::vector<uint32_t> VertexBuffer::Deduplicate()
+{
+    size_t count = size();
+    bool quantized = m_precision == VertexPrecision::Quantized;
+    std::unordered_map<VertexKey, uint32_t, VertexKeyHash> first;
+    first.reserve(count);
+    std::vector<uint32_t> remap(count);
+    std::vector<uint8_t> keep(count, 0);
+    uint32_t kept = 0;
+    for(size_t i = 0; i < count; ++i)
+    {
+        VertexKey key;
+        for(int axis = 0; axis < 3; ++axis)
+        {
+            key[axis] = quantized ? m_quantizedPosition[axis][i] : FloatBits(m_position[axis][i]);
+        }
+        for(int axis = 0; axis < 2; ++axis)
+        {
+            key[3 + axis] = quantized ? m_quantizedUV[axis][i] : FloatBits(m_uv[axis][i]);
+        }
+        key[5] = m_normal[i];
+        key[6] = m_color[i];
+        key[7] = m_tangent[i];
+        auto inserted = first.insert(std::make_pair(key, kept));
+        remap[i] = inserted.first->second;
+        if(inserted.second)
+        {
+            keep[i] = 1;
+            ++kept;
+        }
+    }
+    if(kept == count)
+    {
+        return std::vector<uint32_t>();
+    }
+
+    for(int axis = 0; axis < 3; ++axis)
+    {
+        CompactArray(m_position[axis], keep, remap, kept);
+        CompactArray(m_quantizedPosition[axis], keep, remap, kept);
+    }
+    for(int axis = 0; axis < 2; ++axis)
+    {
+        CompactArray(m_uv[axis], keep, remap, kept);
+        CompactArray(m_quantizedUV[axis], keep, remap, kept);
+    }
+    CompactArray(m_normal, keep, remap, kept);
+    CompactArray(m_tangent, keep, remap, kept);
+    CompactArray(m_color, keep, remap, kept);
+    return remap;
+}
+
+void VertexBuffer::Translate(const glm::vec3& offset)
+{
+    if(m_precision == VertexPrecision::Quantized)
+    {
+        m_positionOrigin += offset;
+        return;
+    }
+    for(int axis = 0; axis < 3; ++axis)
+    {
+        for(float& value : m_position[axis])
+        {
+            value += offset[axis];
+        }
+    }
+}
+
+glm::vec3 VertexBuffer::Position(size_t index) const
+{
+    if(m_precision == VertexPrecision::Quantized)
+    {
+        return m_positionOrigin + m_positionStep * glm::vec3(m_quantizedPosition[0][index],
+                                                             m_quantizedPosition[1][index],
+                                                             m_quantizedPosition[2][index]);
+    }
+    return glm::vec3(m_position[0][index], m_position[1][index], m_position[2][index]);
+}
+
+glm::vec3 VertexBuffer::Normal(size_t index) const
+{
+    return DecodeNormal(m_normal[index]);
+}
+
+glm::vec4 VertexBuffer::Tangent(size_t index) const
+{
+    return DecodeTangent(m_tangent[index]);
+}
+
+void VertexBuffer::SetTangent(size_t index, const glm::vec4& tangent)
+{
+    m_tangent[index] = EncodeTangent(tangent);
+}
+
+glm::vec2 VertexBuffer::UV(size_t index) const
+{
+    if(m_precision == VertexPrecision::Quantized)
+    {
+        return m_uvOrigin + m_uvStep * glm::vec2(m_quantizedUV[0][index], m_quantizedUV[1][index]);
+    }
+    return glm::vec2(m_uv[0][index], m_uv[1][index]);
+}
+
+glm::vec3 VertexBuffer::Color(size_t index) const
+{
+    uint32_t color = m_color[index];
+    return glm::vec3((color >> 16) & 0xff, (color >> 8) & 0xff, color & 0xff);
+}
+
+const float* VertexBuffer::FloatPositions(int axis) const
+{
+    return m_position[axis].data();
+}
+
+const uint16_t* VertexBuffer::QuantizedPositions(int axis) const
+{
+    return m_quantizedPosition[axis].data();
+}
+
+glm::mat4 VertexBuffer::PositionTransform() const
+{
+    if(m_precision == VertexPrecision::Full)
+    {
+        return glm::mat4(1.f);
+    }
+    return glm::mat4(glm::vec4(m_positionStep.x, 0.f, 0.f, 0.f),
+                     glm::vec4(0.f, m_positionStep.y, 0.f, 0.f),
+                     glm::vec4(0.f, 0.f, m_positionStep.z, 0.f),
+                     glm::vec4(m_positionOrigin, 1.f));
+}
+
+size_t VertexBuffer::BytesPerVertex() const
+{
+    size_t packed = sizeof(uint32_t) * 3; // Normal, tangent and color
+    if(m_precision == VertexPrecision::Quantized)
+    {
+        return packed + sizeof(uint16_t) * 5;
+    }
+    return packed + sizeof(float) * 5;
+}
+
+void VertexBuffer::Resize(size_t count)
+{
+    bool quantized = m_precision == VertexPrecision::Quantized;
+    for(int axis = 0; axis < 3; ++axis)
+    {
+        if(quantized)
+        {
+            m_quantizedPosition[axis].resize(count);
+        }
+        else
+        {
+            m_position[axis].resize(count);
+        }
+    }
+    for(int axis = 0; axis < 2; ++axis)
+    {
+        if(quantized)
+        {
+            m_quantizedUV[axis].resize(count);
+        }
+        else
+        {
+            m_uv[axis].resize(count);
+        }
+    }
+    m_normal.resize(count);
+    m_tangent.resize(count);
+    m_color.resize(count);
+}
+
+void VertexBuffer::Write(size_t index, const Vertex& vertex)
+{
+    for(int axis = 0; axis < 3; ++axis)
+    {
+        if(m_precision == VertexPrecision::Quantized)
+        {
+            m_quantizedPosition[axis][index] = Quantize(vertex.m_pos[axis], m_positionOrigin[axis],
+                                                        m_positionStep[axis]);
+        }
+        else
+        {
+            m_position[axis][index] = vertex.m_pos[axis];
+        }
+    }
+    for(int axis = 0; axis < 2; ++axis)
+    {
+        if(m_precision == VertexPrecision::Quantized)
+        {
+            m_quantizedUV[axis][index] = Quantize(vertex.m_uv[axis], m_uvOrigin[axis], m_uvStep[axis]);
+        }
+        else
+        {
+            m_uv[axis][index] = vertex.m_uv[axis];
+        }
+    }
+    m_normal[index] = EncodeNormal(glm::vec3(vertex.m_normal));
+    m_tangent[index] = EncodeTangent(vertex.m_tangent);
+    m_color[index] = EncodeColor(vertex.m_color);
+}
+
+void VertexBuffer::FitQuantization(const std::vector<Vertex>& vertices)
+{
+    const float big = std::numeric_limits<float>::max();
+    int blocks = static_cast<int>((vertices.size() + PACK_BLOCK - 1) / PACK_BLOCK);
+    std::vector<glm::vec3> minPosition(blocks, glm::vec3(big)), maxPosition(blocks, glm::vec3(-big));
+    std::vector<glm::vec2> minUV(blocks, glm::vec2(big)), maxUV(blocks, glm::vec2(-big));
+    ParallelFor(blocks, [&](int block) {
+        size_t end = std::min(vertices.size(), (block + 1) * PACK_BLOCK);
+        for(size_t i = block * PACK_BLOCK; i < end; ++i)
+        {
+            minPosition[block] = glm::min(minPosition[block], glm::vec3(vertices[i].m_pos));
+            maxPosition[block] = glm::max(maxPosition[block], glm::vec3(vertices[i].m_pos));
+            minUV[block] = glm::min(minUV[block], vertices[i].m_uv);
+            maxUV[block] = glm::max(maxUV[block], vertices[i].m_uv);
+        }
+    });
+
+    glm::vec3 lowPosition(0.f), highPosition(0.f);
+    glm::vec2 lowUV(0.f), highUV(0.f);
+    for(int block = 0; block < blocks; ++block)
+    {
+        lowPosition = block == 0 ? minPosition[0] : glm::min(lowPosition, minPosition[block]);
+        highPosition = block == 0 ? maxPosition[0] : glm::max(highPosition, maxPosition[block]);
+        lowUV = block == 0 ? minUV[0] : glm::min(lowUV, minUV[block]);
+        highUV = block == 0 ? maxUV[0] : glm::max(highUV, maxUV[block]);
+    }
+    m_positionOrigin = lowPosition;
+    m_positionStep = (highPosition - lowPosition) / QUANTIZED_MAX;
+    m_uvOrigin = lowUV;
+    m_uvStep = (highUV - lowUV) / QUANTIZED_MAX;
+}
+
+bool VertexBuffer::Representable(const Vertex& vertex) const
+{
+    if(m_precision == VertexPrecision::Full)
+    {
+        return true;
+    }
+    for(int axis = 0; axis < 3; ++axis)
+    {
+        if(!InRange(vertex.m_pos[axis], m_positionOrigin[axis], m_positionStep[axis]))
+        {
+            return false;
+        }
+    }
+    for(int axis = 0; axis < 2; ++axis)
+    {
+        if(!InRange(vertex.m_uv[axis], m_uvOrigin[axis], m_uvStep[axis]))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::vector<Vertex> VertexBuffer::Unpack() const
+{
+    std::vector<Vertex> vertices;
+    vertices.reserve(size());
+    for(size_t i = 0; i < size(); ++i)
+    {
+        vertices.push_back((*this)[i]);
+    }
+    return vertices;
+}
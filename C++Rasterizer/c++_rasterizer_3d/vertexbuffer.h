@@ -0,0 +1,118 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+
+// A Vertex is a point in space that defines one corner of a polygon.
+// Each Vertex has several attributes that determine how they contribute to the
+// appearance of their Polygon, such as coloration.
+struct Vertex
+{
+    glm::vec4 m_pos;    // The position of the vertex. In hw02, this is in pixel space.
+    glm::vec3 m_color;  // The color of the vertex. X corresponds to Red, Y corresponds to Green, and Z corresponds to Blue.
+    glm::vec4 m_normal; // The surface normal of the vertex (not yet used)
+    glm::vec2 m_uv;     // The texture coordinates of the vertex (not yet used)
+    // The direction of increasing u along the surface, perpendicular to the
+    // normal. w is the bitangent's sign: the direction of increasing v is
+    // w * cross(normal, tangent). Zero for vertices without one.
+    glm::vec4 m_tangent;
+
+    Vertex(glm::vec4 p, glm::vec3 c, glm::vec4 n, glm::vec2 u, glm::vec4 t = glm::vec4(0.f))
+        : m_pos(p), m_color(c), m_normal(n), m_uv(u), m_tangent(t)
+    {}
+};
+
+// How a VertexBuffer stores positions and texture coordinates
+enum class VertexPrecision : uint8_t
+{
+    Full,     // 32-bit floats: 32 bytes per vertex in all
+    Quantized // 16 bits per component, spread over the bounds of the buffer's
+              // values: 22 bytes per vertex, a third of a Vertex
+};
+
+// The vertices of a polygon, packed attribute by attribute. Normals are
+// stored as two 16-bit octahedral coordinates (unit length, about 0.005
+// degrees apart), tangents the same way but with y in 15 bits and the
+// bitangent's sign in the word's top bit, and colors as 8 bits per channel,
+// whatever the precision. Positions are always read with w = 1 and normals with w = 0.
+//
+// Vertices are unpacked on the way out, so there are no references to
+// them; use Set to change one. Quantized positions and uvs keep their
+// precision relative to the bounds of everything in the buffer, so adding
+// or setting a vertex outside those bounds repacks the whole buffer. Build
+// a buffer at full precision and quantize it once it is complete.
+class VertexBuffer
+{
+public:
+    VertexBuffer();
+
+    // std::vector's names, so code that walks m_verts by index reads the same
+    size_t size() const;
+    bool empty() const;
+    void reserve(size_t count);
+    void clear();
+    void push_back(const Vertex& vertex);
+    Vertex operator[](size_t index) const;
+
+    void Set(size_t index, const Vertex& vertex);
+
+    // Packs vertices at the given precision, replacing the buffer's contents.
+    // Large inputs are packed in parallel.
+    void Assign(const std::vector<Vertex>& vertices, VertexPrecision precision);
+
+    // Repacks every vertex at the given precision
+    void SetPrecision(VertexPrecision precision);
+    VertexPrecision Precision() const;
+
+    // Merges vertices whose packed attributes are identical, keeping the
+    // first of each. Returns every old index's new index, or nothing when no
+    // vertex was merged; the caller renumbers its triangles with it.
+    std::vector<uint32_t> Deduplicate();
+
+    // Replaces one vertex's tangent, leaving its other attributes as packed
+    void SetTangent(size_t index, const glm::vec4& tangent);
+
+    // Moves every position by offset. Quantized buffers only move their
+    // origin, so this costs the same for any vertex count.
+    void Translate(const glm::vec3& offset);
+
+    glm::vec3 Position(size_t index) const;
+    glm::vec3 Normal(size_t index) const; // Zero for vertices without one
+    glm::vec4 Tangent(size_t index) const; // Likewise
+    glm::vec2 UV(size_t index) const;
+    glm::vec3 Color(size_t index) const;
+
+    // The stored positions, one array per axis. Quantized positions are
+    // turned into object space by PositionTransform.
+    const float* FloatPositions(int axis) const;
+    const uint16_t* QuantizedPositions(int axis) const;
+    glm::mat4 PositionTransform() const;
+
+    // Bytes of vertex data per vertex, not counting spare capacity
+    size_t BytesPerVertex() const;
+
+private:
+    void Resize(size_t count);
+    // Packs vertex into slot index, which must exist already
+    void Write(size_t index, const Vertex& vertex);
+    // Picks the quantization origins and steps so they span vertices
+    void FitQuantization(const std::vector<Vertex>& vertices);
+    bool Representable(const Vertex& vertex) const;
+    std::vector<Vertex> Unpack() const;
+
+    VertexPrecision m_precision;
+
+    std::vector<float> m_position[3];
+    std::vector<uint16_t> m_quantizedPosition[3];
+    std::vector<float> m_uv[2];
+    std::vector<uint16_t> m_quantizedUV[2];
+    std::vector<uint32_t> m_normal; // Octahedral x and y, 16 bits each
+    std::vector<uint32_t> m_tangent; // Octahedral x and y, 16 and 15 bits, and the sign
+    std::vector<uint32_t> m_color;  // 0x00RRGGBB
+
+    // A quantized value q stands for origin + q * step
+    glm::vec3 m_positionOrigin;
+    glm::vec3 m_positionStep;
+    glm::vec2 m_uvOrigin;
+    glm::vec2 m_uvStep;
+};
@@ -0,0 +1,131 @@
+#include "vertexstage.h"
+#include "simd.h"
+
+void ScreenVertices::Resize(size_t count)
+{
+    x.resize(count);
+    y.resize(count);
+    w.resize(count);
+    clipX.resize(count);
+    clipY.resize(count);
+}
+
+namespace
+{
+#if defined(RASTERIZER_SSE2)
+// Four consecutive values of one position axis, as floats
+inline __m128 Load4(const float* values)
+{
+    return _mm_loadu_ps(values);
+}
+
+inline __m128 Load4(const uint16_t* values)
+{
+    __m128i packed = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(values));
+    return _mm_cvtepi32_ps(_mm_unpacklo_epi16(packed, _mm_setzero_si128()));
+}
+
+// One row of a matrix times four vectors, pairing the terms like glm's
+// matrix-vector product: (m0 x + m1 y) + (m2 z + m3 w)
+inline __m128 Row4(const __m128 row[4], __m128 x, __m128 y, __m128 z, __m128 w)
+{
+    return _mm_add_ps(_mm_add_ps(_mm_mul_ps(row[0], x), _mm_mul_ps(row[1], y)),
+                      _mm_add_ps(_mm_mul_ps(row[2], z), _mm_mul_ps(row[3], w)));
+}
+
+inline void SplatRow(const glm::mat4& m, int r, __m128 row[4])
+{
+    for(int c = 0; c < 4; ++c)
+    {
+        row[c] = _mm_set1_ps(m[c][r]);
+    }
+}
+#endif
+
+// The transform itself, for either kind of stored position
+template <typename T>
+void Transform(const glm::mat4& view, const glm::mat4& projection, const T* posX, const T* posY, const T* posZ,
+               size_t count, int width, int height, ScreenVertices& out, size_t first)
+{
+    float* outX = out.x.data() + first;
+    float* outY = out.y.data() + first;
+    float* outW = out.w.data() + first;
+    float* outClipX = out.clipX.data() + first;
+    float* outClipY = out.clipY.data() + first;
+    const float halfWidth = 0.5f * width;
+    const float halfHeight = 0.5f * height;
+
+    size_t i = 0;
+#if defined(RASTERIZER_SSE2)
+    // Four vertices at a time. Only the x, y and w rows of the projection
+    // matter: the rasterizer interpolates the view depth, which is what w
+    // holds.
+    const __m128 one = _mm_set1_ps(1.f);
+    const __m128 scaleX = _mm_set1_ps(halfWidth);
+    const __m128 scaleY = _mm_set1_ps(halfHeight);
+    __m128 viewRow[4][4];
+    for(int r = 0; r < 4; ++r)
+    {
+        SplatRow(view, r, viewRow[r]);
+    }
+    __m128 projectionRow[3][4];
+    const int rows[3] = {0, 1, 3};
+    for(int r = 0; r < 3; ++r)
+    {
+        SplatRow(projection, rows[r], projectionRow[r]);
+    }
+
+    for(; i + 4 <= count; i += 4)
+    {
+        __m128 px = Load4(posX + i);
+        __m128 py = Load4(posY + i);
+        __m128 pz = Load4(posZ + i);
+
+        __m128 camera[4];
+        for(int r = 0; r < 4; ++r)
+        {
+            camera[r] = Row4(viewRow[r], px, py, pz, one);
+        }
+        __m128 clip[3];
+        for(int r = 0; r < 3; ++r)
+        {
+            clip[r] = Row4(projectionRow[r], camera[0], camera[1], camera[2], camera[3]);
+        }
+
+        __m128 ndcX = _mm_div_ps(clip[0], clip[2]);
+        __m128 ndcY = _mm_div_ps(clip[1], clip[2]);
+        _mm_storeu_ps(outX + i, _mm_mul_ps(_mm_add_ps(ndcX, one), scaleX));
+        _mm_storeu_ps(outY + i, _mm_mul_ps(_mm_sub_ps(one, ndcY), scaleY));
+        _mm_storeu_ps(outW + i, clip[2]);
+        _mm_storeu_ps(outClipX + i, clip[0]);
+        _mm_storeu_ps(outClipY + i, clip[1]);
+    }
+#endif
+
+    for(; i < count; ++i)
+    {
+        glm::vec4 clip = projection * (view * glm::vec4(posX[i], posY[i], posZ[i], 1.f));
+        outX[i] = (clip.x / clip.w + 1) * halfWidth;
+        outY[i] = (1 - clip.y / clip.w) * halfHeight;
+        outW[i] = clip.w;
+        outClipX[i] = clip.x;
+        outClipY[i] = clip.y;
+    }
+}
+}
+
+void TransformVertices(const glm::mat4& view, const glm::mat4& projection, const VertexBuffer& vertices,
+                       size_t begin, size_t count, int width, int height, ScreenVertices& out, size_t first)
+{
+    if(vertices.Precision() == VertexPrecision::Quantized)
+    {
+        Transform(view * vertices.PositionTransform(), projection, vertices.QuantizedPositions(0) + begin,
+                  vertices.QuantizedPositions(1) + begin, vertices.QuantizedPositions(2) + begin, count,
+                  width, height, out, first);
+    }
+    else
+    {
+        Transform(view, projection, vertices.FloatPositions(0) + begin, vertices.FloatPositions(1) + begin,
+                  vertices.FloatPositions(2) + begin, count, width, height, out, first);
+    }
+}
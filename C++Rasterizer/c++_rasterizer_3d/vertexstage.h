@@ -0,0 +1,29 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <vector>
+#include "vertexbuffer.h"
+
+// The screen-space position of every vertex in the scene for one frame.
+// Each component lives in its own array so the transform can fill four
+// vertices with every SIMD instruction. A polygon's vertices start at the
+// offset RenderScene records for it, so triangles index straight into here.
+struct ScreenVertices
+{
+    std::vector<float> x; // Pixel space; meaningless for vertices behind the camera
+    std::vector<float> y;
+    std::vector<float> w; // View-space depth, also the clip-space w
+    std::vector<float> clipX; // Clip space, for the clipper
+    std::vector<float> clipY;
+
+    void Resize(size_t count);
+};
+
+// Transforms count vertices of vertices, starting at begin, by view and then
+// projection and maps them into a width x height viewport, writing the
+// results to out starting at index first. The two matrices are applied one
+// after the other, rounding exactly like glm's matrix-vector products, so
+// the results do not depend on whether a vertex took the SIMD path.
+// Quantized positions are read as they are stored and dequantized by the
+// view transform.
+void TransformVertices(const glm::mat4& view, const glm::mat4& projection, const VertexBuffer& vertices,
+                       size_t begin, size_t count, int width, int height, ScreenVertices& out, size_t first);
@@ -19,9 +19,9 @@ uniform sampler2DShadow  u_DepthTexture;
 // their specific values without knowing the vertices that contributed to them
 in vec4 fs_Pos;
 in vec4 fs_Nor;
-in vec4 fs_Col;
 in vec2 fs_UV;
 in vec2 fs_Animated;
+flat in vec3 fs_Tile;
 in vec3 fs_Tan; // Surface tangent
 in vec3 fs_Bit; // Surface bitangent
 in vec4 shadow_coord;
@@ -49,10 +49,12 @@ float fresnelFunction(vec3 viewDir, vec3 normal, float minTransparency, float ma
 
 void main() {
     gb_WorldPos = fs_WorldPos;
-    vec3 normalTex = texture(u_NormalTexture, fs_UV).rgb * 2.0 - 1.0;
+    // Block faces repeat their tile once per block
+    vec2 uv = fs_Tile.z > 0.0 ? fs_Tile.xy + fract(fs_UV) * 0.0625 : fs_UV;
+    vec3 normalTex = texture(u_NormalTexture, uv).rgb * 2.0 - 1.0;
     mat3 TBN = mat3(normalize(fs_Tan), normalize(fs_Bit), normalize(fs_Nor));
     vec3 normal = normalize(TBN * normalTex);
-    if(texture(u_NormalTexture, fs_UV).rgb == vec3(1, 1, 1)){
+    if(texture(u_NormalTexture, uv).rgb == vec3(1, 1, 1)){
         gb_Normal = vec4(fs_Nor.rgb, 1);
     } else{
         gb_Normal = vec4(normal, 1);
@@ -93,7 +95,7 @@ void main() {
 
 
     // Modulate albedo color with shadow visibility
-    vec4 albedoColor = texture(u_Texture, fs_UV);
+    vec4 albedoColor = texture(u_Texture, uv);
 
     float alphaValue = u_Transparent ? TransAlpha : albedoColor.a;
     if (u_Transparent && albedoColor.rgb == vec3(0, 0, 0)){
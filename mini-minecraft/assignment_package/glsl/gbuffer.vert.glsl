@@ -26,31 +26,43 @@ uniform float u_Time;
 
 uniform sampler2D u_NormalTexture;
 
-in vec4 vs_Pos;             // The array of vertex positions passed to the shader
-
-in vec4 vs_Nor;             // The array of vertex normals passed to the shader
-
-in vec4 vs_Col;             // The array of vertex colors passed to the shader.
-
-in vec2 vs_UV;
-
-in vec2 vs_Animated;
-
-in vec3 vs_Tangent;
-
-in vec3 vs_Bitangent;
+in uvec2 vs_Packed;         // A chunk vertex, packed as described in chunk.h
 
 out vec4 fs_Pos;
 out vec4 fs_Nor;            // The array of normals that has been transformed by u_ModelInvTr. This is implicitly passed to the fragment shader.
-out vec4 fs_Col;            // The color of each vertex. This is implicitly passed to the fragment shader.
 out vec2 fs_UV;
 out vec2 fs_Animated;
+flat out vec3 fs_Tile;      // For block faces: the corner of the atlas tile repeated once per
+                            // block, and 1 in z. Zero for flowers, whose uv is in the atlas.
 out vec3 fs_Tan;
 out vec3 fs_Bit;
 out vec4 shadow_coord;
 out vec4 fs_WorldPos;
 uniform mat4 u_DepthMVP;
 
+// The normal, tangent and bitangent of each face, by Direction. The texture
+// runs along the tangent and bitangent, so they give a block face its uv too.
+const vec3 FACE_NORMALS[6] = vec3[](
+    vec3(1, 0, 0), vec3(-1, 0, 0), vec3(0, 1, 0), vec3(0, -1, 0), vec3(0, 0, 1), vec3(0, 0, -1));
+const vec3 FACE_TANGENTS[6] = vec3[](
+    vec3(0, 0, -1), vec3(0, 0, 1), vec3(1, 0, 0), vec3(1, 0, 0), vec3(1, 0, 0), vec3(-1, 0, 0));
+const vec3 FACE_BITANGENTS[6] = vec3[](
+    vec3(0, 1, 0), vec3(0, 1, 0), vec3(0, 0, -1), vec3(0, 0, 1), vec3(0, 1, 0), vec3(0, 1, 0));
+
+// Where the corners of flower and grass faces sit in their block, by face
+// and corner, as in ChunkHelper::createFace_flower_grass. Their Y faces
+// have no area and are never drawn.
+const vec3 CROSS_CORNERS[24] = vec3[](
+    vec3(0.499, 0, 1), vec3(0.499, 0, 0), vec3(0.499, 0.5, 0), vec3(0.499, 0.5, 1),
+    vec3(0.5, 0, 0), vec3(0.5, 0, 1), vec3(0.5, 1, 1), vec3(0.5, 1, 0),
+    vec3(0), vec3(0), vec3(0), vec3(0),
+    vec3(0), vec3(0), vec3(0), vec3(0),
+    vec3(0, 0, 0.499), vec3(1, 0, 0.499), vec3(1, 1, 0.499), vec3(0, 1, 0.499),
+    vec3(1, 0, 0.5), vec3(0, 0, 0.5), vec3(0, 0.5, 0.5), vec3(1, 0.5, 0.5));
+
+// The uv of each corner of a face, in tiles
+const vec2 CORNER_UVS[4] = vec2[](vec2(0, 0), vec2(1, 0), vec2(1, 1), vec2(0, 1));
+
 const vec4 lightDir = normalize(vec4(0.5, 1, 0.75, 0));  // The direction of our virtual light, which is used to compute the shading of
                                         // the geometry in the fragment shader.
 // Constants and sea parameters
@@ -88,24 +100,42 @@ float sea_height(vec3 p) {
 }
 
 void main() {
-    vec4 modelPosition = u_Model * vs_Pos;
+    uint bits = vs_Packed.x;
+    vec3 pos = vec3(bits & 31u, (bits >> 5) & 511u, (bits >> 14) & 31u);
+    int face = int((bits >> 19) & 7u);
+    int corner = int((bits >> 22) & 3u);
+    bool cross = ((bits >> 24) & 1u) != 0u;
+    uint tile = (vs_Packed.y >> 8) & 255u;
+    float animation = float((vs_Packed.y >> 16) & 3u);
+    if (cross) {
+        pos += CROSS_CORNERS[face * 4 + corner];
+    }
+
+    vec4 modelPosition = u_Model * vec4(pos, 1.0);
     vec4 clipPosition = u_ViewProj * modelPosition;
 
     // Apply sea wave effects for water vertices
-    if (vs_Animated.x == 1.0f) {
+    if (animation == 1.0f) {
         float heightOffset = sea_height(modelPosition.xyz);
         clipPosition.y += -0.8 + heightOffset; // Adjust y-coordinate based on wave height
     }
 
     // Pass transformed positions and normals
     fs_Pos = modelPosition;
-    fs_Col = vs_Col;
-    fs_UV = (vs_Animated.x > 0.f) ? vec2(vs_UV.x + float(mod(u_Time, 100.f) / 100.f) * 0.0625f, vs_UV.y) : vs_UV;
-    fs_Animated = vs_Animated;
+    float scroll = (animation > 0.f) ? float(mod(u_Time, 100.f) / 100.f) * 0.0625f : 0.f;
+    vec2 tileCorner = vec2(tile % 16u, tile / 16u) * 0.0625f + vec2(scroll, 0.f);
+    if (cross) {
+        fs_Tile = vec3(0.f);
+        fs_UV = tileCorner + CORNER_UVS[corner] * 0.0625f;
+    } else {
+        fs_Tile = vec3(tileCorner, 1.f);
+        fs_UV = vec2(dot(pos, FACE_TANGENTS[face]), dot(pos, FACE_BITANGENTS[face]));
+    }
+    fs_Animated = vec2(animation, 0.f);
     mat3 normalMatrix = mat3(u_ModelInvTr);
-    fs_Nor = vec4(normalMatrix * vec3(vs_Nor), 0.0);
-    fs_Tan = normalize(mat3(u_Model) * vs_Tangent);
-    fs_Bit = normalize(mat3(u_Model) * vs_Bitangent);
+    fs_Nor = vec4(normalMatrix * FACE_NORMALS[face], 0.0);
+    fs_Tan = normalize(mat3(u_Model) * FACE_TANGENTS[face]);
+    fs_Bit = normalize(mat3(u_Model) * FACE_BITANGENTS[face]);
 
     shadow_coord = u_DepthMVP * modelPosition;
     fs_WorldPos = modelPosition;
@@ -13,35 +13,39 @@ uniform mat4 u_ViewProj;    // The matrix that defines the camera's transformati
                             // but in HW3 you'll have to generate one yourself
 
 
-in vec4 vs_Pos;             // The array of vertex positions passed to the shader
-
-in vec4 vs_Nor;             // The array of vertex normals passed to the shader
-
-in vec4 vs_Col;             // The array of vertex colors passed to the shader.
-
-in vec2 vs_UV;
-
-in vec2 vs_Animated;
-
-in vec3 vs_Tangent;
-
-in vec3 vs_Bitangent;
+in uvec2 vs_Packed;         // A chunk vertex, packed as described in chunk.h
 
 out vec4 fs_Pos;
 out vec4 fs_Nor;            // The array of normals that has been transformed by u_ModelInvTr. This is implicitly passed to the fragment shader.
-out vec4 fs_Col;            // The color of each vertex. This is implicitly passed to the fragment shader.
 out vec2 fs_UV;
 
 
+// Where the corners of flower and grass faces sit in their block, by face
+// and corner, as in ChunkHelper::createFace_flower_grass. Their Y faces
+// have no area and are never drawn.
+const vec3 CROSS_CORNERS[24] = vec3[](
+    vec3(0.499, 0, 1), vec3(0.499, 0, 0), vec3(0.499, 0.5, 0), vec3(0.499, 0.5, 1),
+    vec3(0.5, 0, 0), vec3(0.5, 0, 1), vec3(0.5, 1, 1), vec3(0.5, 1, 0),
+    vec3(0), vec3(0), vec3(0), vec3(0),
+    vec3(0), vec3(0), vec3(0), vec3(0),
+    vec3(0, 0, 0.499), vec3(1, 0, 0.499), vec3(1, 1, 0.499), vec3(0, 1, 0.499),
+    vec3(1, 0, 0.5), vec3(0, 0, 0.5), vec3(0, 0.5, 0.5), vec3(1, 0.5, 0.5));
+
 const vec4 lightDir = normalize(vec4(0.5, 1, 0.75, 0));  // The direction of our virtual light, which is used to compute the shading of
                                         // the geometry in the fragment shader.
 
 void main()
 {
 
-    fs_Pos = vs_Pos;
+    uint bits = vs_Packed.x;
+    vec4 pos = vec4(bits & 31u, (bits >> 5) & 511u, (bits >> 14) & 31u, 1.0);
+    if (((bits >> 24) & 1u) != 0u) {
+        pos.xyz += CROSS_CORNERS[int((bits >> 19) & 7u) * 4 + int((bits >> 22) & 3u)];
+    }
+
+    fs_Pos = pos;
 
-    vec4 modelposition = u_Model * vs_Pos;   // Temporarily store the transformed vertex positions for use below
+    vec4 modelposition = u_Model * pos;   // Temporarily store the transformed vertex positions for use below
 
     gl_Position = u_ViewProj * modelposition;// gl_Position is a built-in variable of OpenGL which is
                                              // used to render the final positions of the geometry's vertices
@@ -17,7 +17,7 @@ public:
                     Terrain& t);
     ~BlockTypeWorker();
     void run() override;
-    //noise chunk generate
+    //noise chunk generate; the caller holds c's block lock
     void generateChunkData(Chunk* c, glm::ivec2 pos, int x, int z, bool asset);
 private:
     glm::ivec2 m_pos;
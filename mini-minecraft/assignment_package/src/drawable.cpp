@@ -23,6 +23,10 @@ void Drawable::destroyVBOdata() {
     for(auto &kvp : bufHandles) {
         mp_context->glDeleteBuffers(1, &(kvp.second));
     }
+    // So that destroying twice, as evicted Chunks are, does not delete
+    // buffers that reused the names
+    bufHandles.clear();
+    bufGenerated.clear();
     indexCounts[INDEX_TRAN] = -1;
     indexCounts[INDEX] = -1;
     indexCounts[INDEX_QUAD] = -1;
@@ -11,8 +11,7 @@ enum BufferType : unsigned char {
     POSITION2, NORMAL2, COLOR2, UV2,
     POSITION3, NORMAL3, COLOR3, UV3,
     INTERLEAVED,
-    INSTANCED_OFFSET, ANIMATED, ANIMATED2,
-    TANGENT, TANGENT2, BITANGENT, BITANGENT2,
+    INSTANCED_OFFSET,
 };
 
 //This defines a class which can be rendered by our shader program.
@@ -1,14 +1,30 @@
 #include "chunk.h"
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <stdexcept>
+#include <string>
 
 
-Chunk::Chunk(OpenGLContext *context) : Drawable(context), m_blocks(), m_neighbors{{XPOS, nullptr}, {XNEG, nullptr}, {ZPOS, nullptr}, {ZNEG, nullptr}}
-{
-    std::fill_n(m_blocks.begin(), 65536, EMPTY);
+Chunk::Chunk(OpenGLContext *context) : Drawable(context), m_sections(), m_blocksLock(), m_neighbors{{XPOS, nullptr}, {XNEG, nullptr}, {ZPOS, nullptr}, {ZNEG, nullptr}},
+    m_meshingMode(GREEDY), m_edited(false), m_users(0)
+{}
+
+BlockType Chunk::blockAt(int x, int y, int z) const {
+    return m_sections[y >> 4].getBlock(x + 16 * (y & 15) + 256 * z);
+}
+
+// Does bounds checking like at()
+static void checkLocalCoordinates(unsigned int x, unsigned int y, unsigned int z) {
+    if (x >= 16 || y >= 256 || z >= 16) {
+        throw std::out_of_range("Local coordinates " + std::to_string(x) + " " + std::to_string(y) + " " +
+                                std::to_string(z) + " are outside the chunk!");
+    }
 }
 
-// Does bounds checking with at()
 BlockType Chunk::getLocalBlockAt(unsigned int x, unsigned int y, unsigned int z) const {
-    return m_blocks.at(x + 16 * y + 16 * 256 * z);
+    QMutexLocker locker(&m_blocksLock);
+    return getLocalBlockAtUnlocked(x, y, z);
 }
 
 // Exists to get rid of compiler warnings about int -> unsigned int implicit conversion
@@ -16,9 +32,39 @@ BlockType Chunk::getLocalBlockAt(int x, int y, int z) const {
     return getLocalBlockAt(static_cast<unsigned int>(x), static_cast<unsigned int>(y), static_cast<unsigned int>(z));
 }
 
-// Does bounds checking with at()
 void Chunk::setLocalBlockAt(unsigned int x, unsigned int y, unsigned int z, BlockType t) {
-    m_blocks.at(x + 16 * y + 16 * 256 * z) = t;
+    QMutexLocker locker(&m_blocksLock);
+    setLocalBlockAtUnlocked(x, y, z, t);
+}
+
+void Chunk::lockBlocks() const {
+    m_blocksLock.lock();
+}
+
+void Chunk::unlockBlocks() const {
+    m_blocksLock.unlock();
+}
+
+BlockType Chunk::getLocalBlockAtUnlocked(unsigned int x, unsigned int y, unsigned int z) const {
+    checkLocalCoordinates(x, y, z);
+    return blockAt(x, y, z);
+}
+
+BlockType Chunk::getLocalBlockAtUnlocked(int x, int y, int z) const {
+    return getLocalBlockAtUnlocked(static_cast<unsigned int>(x), static_cast<unsigned int>(y),
+                                   static_cast<unsigned int>(z));
+}
+
+void Chunk::setLocalBlockAtUnlocked(unsigned int x, unsigned int y, unsigned int z, BlockType t) {
+    checkLocalCoordinates(x, y, z);
+    m_sections[y >> 4].setBlock(x + 16 * (y & 15) + 256 * z, t);
+}
+
+void Chunk::compactBlocks() {
+    QMutexLocker locker(&m_blocksLock);
+    for (ChunkSection &section : m_sections) {
+        section.compact();
+    }
 }
 
 
@@ -31,93 +77,185 @@ const static std::unordered_map<Direction, Direction, EnumHash> oppositeDirectio
     {ZNEG, ZPOS}
 };
 
+// Both link and unlink lock one chunk at a time, like copyPaddedBlocks
 void Chunk::linkNeighbor(uPtr<Chunk> &neighbor, Direction dir) {
     if(neighbor != nullptr) {
+        m_blocksLock.lock();
         this->m_neighbors[dir] = neighbor.get();
+        m_blocksLock.unlock();
+        QMutexLocker locker(&neighbor->m_blocksLock);
         neighbor->m_neighbors[oppositeDirection.at(dir)] = this;
     }
 }
 
-BlockType Chunk::getNeighbors(int x, int y, int z, glm::vec4 dir) const
-{
-    BlockType block = EMPTY;
-
-    int x_coord = x + (int) dir[0];
-    int y_coord = y + (int) dir[1];
-    int z_coord = z + (int) dir[2];
-
-    if (y_coord == -1 || y_coord == 256) {
-        return block;
+void Chunk::unlinkNeighbors() {
+    m_blocksLock.lock();
+    std::unordered_map<Direction, Chunk*, EnumHash> neighbors = m_neighbors;
+    for (auto &neighbor : m_neighbors) {
+        neighbor.second = nullptr;
     }
-
-    std::tuple<int, Direction, int> xBound[2] = {std::make_tuple(-1, XNEG, 15), std::make_tuple(16, XPOS, 0)};
-    for (int i = 0; i < 2; i++) {
-        if (x_coord == std::get<0>(xBound[i])) {
-            Direction dirc = std::get<1>(xBound[i]);
-            Chunk *neighbor = m_neighbors.at(dirc);
-            return neighbor != nullptr ? neighbor->getLocalBlockAt(std::get<2>(xBound[i]), y, z) : block;
+    m_blocksLock.unlock();
+    // Once a neighbor forgets this chunk, its meshing cannot start reading
+    // this one any more
+    for (auto &neighbor : neighbors) {
+        if (neighbor.second != nullptr) {
+            QMutexLocker locker(&neighbor.second->m_blocksLock);
+            neighbor.second->m_neighbors[oppositeDirection.at(neighbor.first)] = nullptr;
         }
     }
+}
 
-    std::tuple<int, Direction, int> zBound[2] = {std::make_tuple(-1, ZNEG, 15),
-                                                 std::make_tuple(16, ZPOS, 0)};
-    for (int i = 0; i < 2; i++) {
-        if (z_coord == std::get<0>(zBound[i])) {
-            Direction dirc = std::get<1>(zBound[i]);
-            Chunk *neighbor = m_neighbors.at(dirc);
-            return neighbor != nullptr ? neighbor->getLocalBlockAt(x, y, std::get<2>(zBound[i])) : block;
+void Chunk::writeBlocks(std::vector<unsigned char> &out) const {
+    QMutexLocker locker(&m_blocksLock);
+    for (const ChunkSection &section : m_sections) {
+        section.write(out);
+    }
+}
+
+bool Chunk::readBlocks(const unsigned char *data, size_t size) {
+    const unsigned char *end = data + size;
+    std::array<ChunkSection, 16> sections;
+    for (ChunkSection &section : sections) {
+        if (!section.read(data, end)) {
+            return false;
         }
     }
+    if (data != end) {
+        return false;
+    }
 
-    return getLocalBlockAt(x_coord, y_coord, z_coord);
+    QMutexLocker locker(&m_blocksLock);
+    m_sections.swap(sections);
+    return true;
 }
 
+void Chunk::setEdited(bool edited) {
+    m_edited = edited;
+}
 
+bool Chunk::isEdited() const {
+    return m_edited;
+}
 
-void pushBuffer(std::vector<float> &buffer, const glm::vec4 &vec) {
-    for (int i = 0; i < 4; i++) {
-        buffer.push_back(vec[i]);
-    }
+void Chunk::acquire() const {
+    ++m_users;
 }
 
-void pushBuffer(std::vector<float> &buffer, const glm::vec3 &vec) {
-    for (int i = 0; i < 3; i++) {
-        buffer.push_back(vec[i]);
-    }
+void Chunk::release() const {
+    --m_users;
 }
 
-void pushBuffer(std::vector<float> &buffer, const glm::vec2 &vec) {
-    for (int i = 0; i < 2; i++) {
-        buffer.push_back(vec[i]);
-    }
+bool Chunk::isInUse() const {
+    return m_users > 0;
+}
+
+void Chunk::setMeshingMode(MeshingMode mode) {
+    m_meshingMode = mode;
 }
 
-glm::vec3 ComputeTangent(const Vertex &v0, const Vertex &v1, const Vertex &v2) {
-    // Convert glm::vec4 to glm::vec3 by ignoring the w component
-    glm::vec3 edge1 = glm::vec3(v1.pos) - glm::vec3(v0.pos);
-    glm::vec3 edge2 = glm::vec3(v2.pos) - glm::vec3(v0.pos);
-    glm::vec2 deltaUV1 = v1.uv - v0.uv;
-    glm::vec2 deltaUV2 = v2.uv - v0.uv;
+MeshingMode Chunk::getMeshingMode() const {
+    return m_meshingMode;
+}
 
-    float f = 1.0f / (deltaUV1.x * deltaUV2.y - deltaUV2.x * deltaUV1.y);
-    glm::vec3 tangent;
-    tangent.x = f * (deltaUV2.y * edge1.x - deltaUV1.y * edge2.x);
-    tangent.y = f * (deltaUV2.y * edge1.y - deltaUV1.y * edge2.y);
-    tangent.z = f * (deltaUV2.y * edge1.z - deltaUV1.y * edge2.z);
-    tangent = glm::normalize(tangent);
+// The chunk with its border, as laid out by copyPaddedBlocks
+static const int PADDED_X = 18;
+static const int PADDED_Y = 258;
+static const int PADDED_Z = 18;
 
-    return tangent;
+// Where block (x, y, z) of the chunk is in its padded copy; -1 and 16 (or
+// 256) are the border
+static inline int paddedIndex(int x, int y, int z) {
+    return (x + 1) + PADDED_X * (y + 1) + PADDED_X * PADDED_Y * (z + 1);
 }
 
+// How far the neighbor in each Direction is in the padded copy
+static const int PADDED_STRIDE[6] = {1, -1, PADDED_X, -PADDED_X, PADDED_X * PADDED_Y, -PADDED_X * PADDED_Y};
+
+void Chunk::copyPaddedBlocks(std::vector<BlockType> &padded) const
+{
+    padded.assign(PADDED_X * PADDED_Y * PADDED_Z, EMPTY);
 
-glm::vec3 ComputeBitangent(const Vertex &v0, const Vertex &v1, const Vertex &v2, const glm::vec3 &tangent) {
-    // Convert glm::vec4 to glm::vec3 for position vectors
-    glm::vec3 normal = glm::normalize(glm::cross(glm::vec3(v1.pos) - glm::vec3(v0.pos), glm::vec3(v2.pos) - glm::vec3(v0.pos)));
-    glm::vec3 bitangent = glm::cross(normal, tangent);
-    return glm::normalize(bitangent);
+    m_blocksLock.lock();
+    for (int z = 0; z < 16; z++) {
+        for (int y = 0; y < 256; y++) {
+            const ChunkSection &section = m_sections[y >> 4];
+            BlockType *row = &padded[paddedIndex(0, y, z)];
+            if (section.isUniform()) {
+                std::fill_n(row, 16, section.getBlock(0));
+                continue;
+            }
+            for (int x = 0; x < 16; x++) {
+                row[x] = section.getBlock(x + 16 * (y & 15) + 256 * z);
+            }
+        }
+    }
+    // Taken under the lock that unlinkNeighbors holds, so an evicted
+    // neighbor is either gone already or stays in use until released below
+    const Chunk *xPos = m_neighbors.at(XPOS), *xNeg = m_neighbors.at(XNEG);
+    const Chunk *zPos = m_neighbors.at(ZPOS), *zNeg = m_neighbors.at(ZNEG);
+    for (const Chunk *neighbor : {xPos, xNeg, zPos, zNeg}) {
+        if (neighbor != nullptr) {
+            neighbor->acquire();
+        }
+    }
+    m_blocksLock.unlock();
+
+    // The neighbors' faces that touch this chunk. Only one chunk is locked
+    // at a time, as a neighbor may be meshing too.
+    if (xPos != nullptr) {
+        QMutexLocker locker(&xPos->m_blocksLock);
+        for (int y = 0; y < 256; y++) {
+            for (int i = 0; i < 16; i++) {
+                padded[paddedIndex(16, y, i)] = xPos->blockAt(0, y, i);
+            }
+        }
+    }
+    if (xNeg != nullptr) {
+        QMutexLocker locker(&xNeg->m_blocksLock);
+        for (int y = 0; y < 256; y++) {
+            for (int i = 0; i < 16; i++) {
+                padded[paddedIndex(-1, y, i)] = xNeg->blockAt(15, y, i);
+            }
+        }
+    }
+    if (zPos != nullptr) {
+        QMutexLocker locker(&zPos->m_blocksLock);
+        for (int y = 0; y < 256; y++) {
+            for (int i = 0; i < 16; i++) {
+                padded[paddedIndex(i, y, 16)] = zPos->blockAt(i, y, 0);
+            }
+        }
+    }
+    if (zNeg != nullptr) {
+        QMutexLocker locker(&zNeg->m_blocksLock);
+        for (int y = 0; y < 256; y++) {
+            for (int i = 0; i < 16; i++) {
+                padded[paddedIndex(i, y, -1)] = zNeg->blockAt(i, y, 15);
+            }
+        }
+    }
+
+    for (const Chunk *neighbor : {xPos, xNeg, zPos, zNeg}) {
+        if (neighbor != nullptr) {
+            neighbor->release();
+        }
+    }
+}
+
+// ChunkHelper::Blocks by block type, so meshing does not hash every block
+static const std::array<const std::array<Face, 6>*, 256> &facesByType() {
+    static const std::array<const std::array<Face, 6>*, 256> faces = [] {
+        std::array<const std::array<Face, 6>*, 256> table = {};
+        for (const auto &block : ChunkHelper::Blocks) {
+            table[block.first] = &block.second;
+        }
+        return table;
+    }();
+    return faces;
 }
 
 
+
 bool Chunk::checkBlockType(bool drawType, BlockType blockType) const {
     if (blockType == EMPTY) {
         return false;
@@ -149,45 +287,206 @@ bool Chunk::checkNeighborBlock(bool drawType, BlockType neighborType) const {
 
 
 
+// Appends one vertex in the packed layout described in chunk.h
+void pushVertex(std::vector<GLuint> &vertexVBOdata, const glm::ivec3 &pos, Direction dir,
+                int corner, bool cross, BlockType blockType) {
+    glm::ivec2 tile = glm::ivec2(glm::round(ChunkHelper::getUV(blockType, dir) * 16.f));
+    GLuint animation = static_cast<GLuint>(ChunkHelper::getAnimated(blockType).x);
+
+    vertexVBOdata.push_back(pos.x | pos.y << 5 | pos.z << 14 | dir << 19 | corner << 22 | cross << 24);
+    vertexVBOdata.push_back(blockType | (tile.y * 16 + tile.x) << 8 | animation << 16);
+}
+
+// Appends one quad for the given face of the block at (x, y, z). Faces
+// without area are dropped, and so are faces that are neither a whole
+// block's nor a flower's, which the packed layout has no room for. Those
+// are reported once per block type, so a new block shape does not just
+// vanish.
+void pushFace(std::vector<GLuint> &vertexVBOdata, std::vector<GLuint> &idx, int &nVertices,
+              const Face &face, BlockType blockType, int x, int y, int z) {
+    static const GLuint faceIndices[] = {0, 1, 2, 0, 2, 3};
+    // Chunks are meshed on several workers at once
+    static std::array<std::atomic<bool>, 256> reported = {};
+
+    if (face.vertices[0].pos == face.vertices[2].pos) {
+        return;
+    }
+    bool cross = !ChunkHelper::isUnitFace(face);
+    if (cross && !ChunkHelper::isCrossFace(face)) {
+        if (!reported[blockType].exchange(true)) {
+            std::cerr << "Block type " << static_cast<int>(blockType) << " has a face the packed vertex layout cannot hold;"
+                      << " it is not drawn" << std::endl;
+        }
+        return;
+    }
+
+    glm::ivec3 block(x, y, z);
+    for (int i = 0; i < 4; i++) {
+        glm::ivec3 pos = cross ? block : block + glm::ivec3(face.vertices[i].pos);
+        pushVertex(vertexVBOdata, pos, face.dir, i, cross, blockType);
+    }
+
+    for (GLuint index : faceIndices) {
+        idx.push_back(nVertices + index);
+    }
+
+    nVertices += 4;
+}
+
 //generate opaque chunk data
-void Chunk::generateOpaData(std::vector<float>& vertexVBOdata, std::vector<GLuint>& idx)
+void Chunk::generateOpaData(std::vector<GLuint>& vertexVBOdata, std::vector<GLuint>& idx)
 {
+    if (m_meshingMode == GREEDY) {
+        generateGreedyOpaData(vertexVBOdata, idx);
+        return;
+    }
+
     // init
     int nVertices = 0;
-
-    std::vector<GLuint> faceIndices = {0, 1, 2, 0, 2, 3};
+    std::vector<BlockType> blocks;
+    copyPaddedBlocks(blocks);
+    const auto &faces = facesByType();
 
     for (int x = 0; x < 16; x++) {
         for (int y = 0; y < 256; y++) {
             for (int z = 0; z < 16; z++) {
-                BlockType blockType = getLocalBlockAt(x, y, z);
+                int i = paddedIndex(x, y, z);
+                BlockType blockType = blocks[i];
                 if (!checkBlockType(false, blockType)) {
                     continue;
                 }
 
-                for (const Face &face : ChunkHelper::Blocks[blockType]) {
-                    BlockType neighbors = getNeighbors(x, y, z, face.normal);
+                for (const Face &face : *faces[blockType]) {
+                    BlockType neighbors = blocks[i + PADDED_STRIDE[face.dir]];
                     if (!checkNeighborBlock(false, neighbors)) {
                         continue;
                     }
 
-                    glm::vec3 tangent = ComputeTangent(face.vertices[0], face.vertices[1], face.vertices[2]);
-                    glm::vec3 bitangent = ComputeBitangent(face.vertices[0], face.vertices[1], face.vertices[2], tangent);
-                    for (const Vertex &v : face.vertices) {
-                        pushBuffer(vertexVBOdata, v.pos + glm::vec4(x, y, z, 0));
-                        pushBuffer(vertexVBOdata, face.normal);
-                        pushBuffer(vertexVBOdata, ChunkHelper::getColor(blockType));
-                        pushBuffer(vertexVBOdata, ChunkHelper::getUV(blockType, face.dir) + v.uv);
-                        pushBuffer(vertexVBOdata, ChunkHelper::getAnimated(blockType));
-                        pushBuffer(vertexVBOdata, tangent);
-                        pushBuffer(vertexVBOdata, bitangent);
+                    pushFace(vertexVBOdata, idx, nVertices, face, blockType, x, y, z);
+                }
+            }
+        }
+    }
+}
+
+// Merges the visible faces of whole blocks into as few quads as possible.
+// Each slice of the chunk across a face direction is a grid of the block
+// types showing that face; a quad starts at the first cell still uncovered,
+// grows along u as far as the block type repeats, then along v as long as
+// every cell of the next row matches.
+void Chunk::generateGreedyOpaData(std::vector<GLuint>& vertexVBOdata, std::vector<GLuint>& idx)
+{
+    static const int chunkSize[3] = {16, 256, 16};
+    static const GLuint faceIndices[] = {0, 1, 2, 0, 2, 3};
+
+    int nVertices = 0;
+    std::vector<BlockType> blocks;
+    copyPaddedBlocks(blocks);
+    const auto &faces = facesByType();
+
+    // Which block types' faces can be merged in each direction; the rest get
+    // a quad per face, as in PER_FACE mode. Whether a block type is drawn, and
+    // whether faces behind it show, is looked up per type when building masks.
+    std::array<std::array<bool, 6>, 256> mergeable = {};
+    for (const auto &block : ChunkHelper::Blocks) {
+        for (const Face &face : block.second) {
+            mergeable[block.first][face.dir] = ChunkHelper::isUnitFace(face);
+        }
+    }
+    std::array<bool, 256> drawn, showsFaces;
+    for (int t = 0; t < 256; t++) {
+        drawn[t] = checkBlockType(false, BlockType(t));
+        showsFaces[t] = checkNeighborBlock(false, BlockType(t));
+    }
+
+    for (int x = 0; x < 16; x++) {
+        for (int y = 0; y < 256; y++) {
+            for (int z = 0; z < 16; z++) {
+                int i = paddedIndex(x, y, z);
+                BlockType blockType = blocks[i];
+                if (!checkBlockType(false, blockType)) {
+                    continue;
+                }
+
+                for (const Face &face : *faces[blockType]) {
+                    if (mergeable[blockType][face.dir]) {
+                        continue;
+                    }
+                    if (!checkNeighborBlock(false, blocks[i + PADDED_STRIDE[face.dir]])) {
+                        continue;
+                    }
+                    pushFace(vertexVBOdata, idx, nVertices, face, blockType, x, y, z);
+                }
+            }
+        }
+    }
+
+    std::vector<BlockType> mask;
+    for (const Face &unit : ChunkHelper::UnitFaces) {
+        // The axis the face looks along and the two axes of its plane
+        int axis = unit.dir / 2;
+        int axisU = (axis + 1) % 3;
+        int axisV = (axis + 2) % 3;
+        int sizeU = chunkSize[axisU];
+        int sizeV = chunkSize[axisV];
+        mask.resize(sizeU * sizeV);
+
+        for (int slice = 0; slice < chunkSize[axis]; slice++) {
+            for (int v = 0; v < sizeV; v++) {
+                for (int u = 0; u < sizeU; u++) {
+                    glm::ivec3 p;
+                    p[axis] = slice;
+                    p[axisU] = u;
+                    p[axisV] = v;
+                    int i = paddedIndex(p.x, p.y, p.z);
+                    BlockType blockType = blocks[i];
+                    bool shown = drawn[blockType] & mergeable[blockType][unit.dir]
+                               & showsFaces[blocks[i + PADDED_STRIDE[unit.dir]]];
+                    mask[u + v * sizeU] = shown ? blockType : EMPTY;
+                }
+            }
+
+            for (int v = 0; v < sizeV; v++) {
+                for (int u = 0; u < sizeU;) {
+                    BlockType blockType = mask[u + v * sizeU];
+                    if (blockType == EMPTY) {
+                        u++;
+                        continue;
                     }
 
-                    for (int index : faceIndices) {
+                    int width = 1;
+                    while (u + width < sizeU && mask[u + width + v * sizeU] == blockType) {
+                        width++;
+                    }
+                    int height = 1;
+                    for (bool rowMatches = true; v + height < sizeV; height++) {
+                        for (int i = 0; i < width && rowMatches; i++) {
+                            rowMatches = mask[u + i + (v + height) * sizeU] == blockType;
+                        }
+                        if (!rowMatches) {
+                            break;
+                        }
+                    }
+                    for (int j = 0; j < height; j++) {
+                        std::fill_n(mask.begin() + u + (v + j) * sizeU, width, EMPTY);
+                    }
+
+                    // The unit face's corners, stretched over the rectangle
+                    for (int k = 0; k < 4; k++) {
+                        const glm::vec4 &pos = unit.vertices[k].pos;
+                        glm::ivec3 corner;
+                        corner[axis] = slice + static_cast<int>(pos[axis]);
+                        corner[axisU] = u + static_cast<int>(pos[axisU]) * width;
+                        corner[axisV] = v + static_cast<int>(pos[axisV]) * height;
+                        pushVertex(vertexVBOdata, corner, unit.dir, k, false, blockType);
+                    }
+
+                    for (GLuint index : faceIndices) {
                         idx.push_back(nVertices + index);
                     }
 
                     nVertices += 4;
+                    u += width;
                 }
             }
         }
@@ -195,44 +494,30 @@ void Chunk::generateOpaData(std::vector<float>& vertexVBOdata, std::vector<GLuin
 }
 
 //generate transparent chunk data
-void Chunk::generateTransData(std::vector<float>& vertexVBOdata, std::vector<GLuint>& idx)
+void Chunk::generateTransData(std::vector<GLuint>& vertexVBOdata, std::vector<GLuint>& idx)
 {
     // init
     int nVertices = 0;
-
-    std::vector<GLuint> faceIndices = {0, 1, 2, 0, 2, 3};
+    std::vector<BlockType> blocks;
+    copyPaddedBlocks(blocks);
+    const auto &faces = facesByType();
 
     for (int x = 0; x < 16; x++) {
         for (int y = 0; y < 256; y++) {
             for (int z = 0; z < 16; z++) {
-                BlockType blockType = getLocalBlockAt(x, y, z);
+                int i = paddedIndex(x, y, z);
+                BlockType blockType = blocks[i];
                 if (!checkBlockType(true, blockType)) {
                     continue;
                 }
 
-                for (const Face &face : ChunkHelper::Blocks[blockType]) {
-                    BlockType neighbors = getNeighbors(x, y, z, face.normal);
+                for (const Face &face : *faces[blockType]) {
+                    BlockType neighbors = blocks[i + PADDED_STRIDE[face.dir]];
                     if (!checkNeighborBlock(true, neighbors)) {
                         continue;
                     }
 
-                    glm::vec3 tangent = ComputeTangent(face.vertices[0], face.vertices[1], face.vertices[2]);
-                    glm::vec3 bitangent = ComputeBitangent(face.vertices[0], face.vertices[1], face.vertices[2], tangent);
-                    for (const Vertex &v : face.vertices) {
-                        pushBuffer(vertexVBOdata, v.pos + glm::vec4(x, y, z, 0));
-                        pushBuffer(vertexVBOdata, face.normal);
-                        pushBuffer(vertexVBOdata, ChunkHelper::getColor(blockType));
-                        pushBuffer(vertexVBOdata, ChunkHelper::getUV(blockType, face.dir) + v.uv);
-                        pushBuffer(vertexVBOdata, ChunkHelper::getAnimated(blockType));
-                        pushBuffer(vertexVBOdata, tangent);
-                        pushBuffer(vertexVBOdata, bitangent);
-                    }
-
-                    for (int index : faceIndices) {
-                        idx.push_back(nVertices + index);
-                    }
-
-                    nVertices += 4;
+                    pushFace(vertexVBOdata, idx, nVertices, face, blockType, x, y, z);
                 }
             }
         }
@@ -240,7 +525,7 @@ void Chunk::generateTransData(std::vector<float>& vertexVBOdata, std::vector<GLu
 }
 
 //pass to gpu
-void Chunk::createOpaVBOdata(std::vector<float>& vertexVBOdata, std::vector<GLuint>& idx)
+void Chunk::createOpaVBOdata(std::vector<GLuint>& vertexVBOdata, std::vector<GLuint>& idx)
 {
     indexCounts[INDEX] = idx.size();
 
@@ -252,35 +537,10 @@ void Chunk::createOpaVBOdata(std::vector<float>& vertexVBOdata, std::vector<GLui
 
     generateBuffer(POSITION);
     bindBuffer(POSITION);
-    mp_context->glBufferData(GL_ARRAY_BUFFER, bufferSize * sizeof(float), vertexVBOdata.data(), GL_STATIC_DRAW);
-
-    generateBuffer(NORMAL);
-    bindBuffer(NORMAL);
-    mp_context->glBufferData(GL_ARRAY_BUFFER, bufferSize * sizeof(float), vertexVBOdata.data(), GL_STATIC_DRAW);
-
-    generateBuffer(COLOR);
-    bindBuffer(COLOR);
-    mp_context->glBufferData(GL_ARRAY_BUFFER, bufferSize * sizeof(float), vertexVBOdata.data(), GL_STATIC_DRAW);
-
-    generateBuffer(UV);
-    bindBuffer(UV);
-    mp_context->glBufferData(GL_ARRAY_BUFFER, bufferSize * sizeof(float), vertexVBOdata.data(), GL_STATIC_DRAW);
-
-    generateBuffer(ANIMATED);
-    bindBuffer(ANIMATED);
-    mp_context->glBufferData(GL_ARRAY_BUFFER, bufferSize * sizeof(float), vertexVBOdata.data(), GL_STATIC_DRAW);
-
-    generateBuffer(TANGENT);
-    bindBuffer(TANGENT);
-    mp_context->glBufferData(GL_ARRAY_BUFFER, bufferSize * sizeof(float), vertexVBOdata.data(), GL_STATIC_DRAW);
-
-    generateBuffer(BITANGENT);
-    bindBuffer(BITANGENT);
-    mp_context->glBufferData(GL_ARRAY_BUFFER, bufferSize * sizeof(float), vertexVBOdata.data(), GL_STATIC_DRAW);
-
+    mp_context->glBufferData(GL_ARRAY_BUFFER, bufferSize * sizeof(GLuint), vertexVBOdata.data(), GL_STATIC_DRAW);
 }
 
-void Chunk::createTransVBOdata(std::vector<float>& vertexVBOdata, std::vector<GLuint>& idx)
+void Chunk::createTransVBOdata(std::vector<GLuint>& vertexVBOdata, std::vector<GLuint>& idx)
 {
     indexCounts[INDEX_TRAN] = idx.size();
 
@@ -292,37 +552,12 @@ void Chunk::createTransVBOdata(std::vector<float>& vertexVBOdata, std::vector<GL
 
     generateBuffer(POSITION2);
     bindBuffer(POSITION2);
-    mp_context->glBufferData(GL_ARRAY_BUFFER, bufferSize * sizeof(float), vertexVBOdata.data(), GL_STATIC_DRAW);
-
-    generateBuffer(NORMAL2);
-    bindBuffer(NORMAL2);
-    mp_context->glBufferData(GL_ARRAY_BUFFER, bufferSize * sizeof(float), vertexVBOdata.data(), GL_STATIC_DRAW);
-
-    generateBuffer(COLOR2);
-    bindBuffer(COLOR2);
-    mp_context->glBufferData(GL_ARRAY_BUFFER, bufferSize * sizeof(float), vertexVBOdata.data(), GL_STATIC_DRAW);
-
-    generateBuffer(UV2);
-    bindBuffer(UV2);
-    mp_context->glBufferData(GL_ARRAY_BUFFER, bufferSize * sizeof(float), vertexVBOdata.data(), GL_STATIC_DRAW);
-
-    generateBuffer(ANIMATED2);
-    bindBuffer(ANIMATED2);
-    mp_context->glBufferData(GL_ARRAY_BUFFER, bufferSize * sizeof(float), vertexVBOdata.data(), GL_STATIC_DRAW);
-
-    generateBuffer(TANGENT2);
-    bindBuffer(TANGENT2);
-    mp_context->glBufferData(GL_ARRAY_BUFFER, bufferSize * sizeof(float), vertexVBOdata.data(), GL_STATIC_DRAW);
-
-    generateBuffer(BITANGENT2);
-    bindBuffer(BITANGENT2);
-    mp_context->glBufferData(GL_ARRAY_BUFFER, bufferSize * sizeof(float), vertexVBOdata.data(), GL_STATIC_DRAW);
-
+    mp_context->glBufferData(GL_ARRAY_BUFFER, bufferSize * sizeof(GLuint), vertexVBOdata.data(), GL_STATIC_DRAW);
 }
 
 
 void Chunk::createVBOdata() {
-    std::vector<float> vertexVBOdata_opa, vertexVBOdata_trans;
+    std::vector<GLuint> vertexVBOdata_opa, vertexVBOdata_trans;
     std::vector<GLuint> idx_opa, idx_trans;
     //generateOpaData(vertexVBOdata_opa, idx_opa);
     //createOpaVBOdata(vertexVBOdata_opa, idx_opa);
@@ -3,9 +3,12 @@
 #include "drawable.h"
 #include "glm_includes.h"
 #include "chunkhelper.h"
+#include "chunksection.h"
 #include <array>
 #include <unordered_map>
 #include <cstddef>
+#include <atomic>
+#include <QMutex>
 
 
 // One Chunk is a 16 x 256 x 16 section of the world,
@@ -15,31 +18,102 @@
 // render all the world at once, while also not having
 // to render the world block by block.
 
+// How generateOpaData turns the visible faces of blocks into quads
+enum MeshingMode : unsigned char
+{
+    PER_FACE, // One quad per face
+    GREEDY    // Coplanar faces of the same block type merged into rectangles
+};
+
+// The VBO data of a chunk holds two GLuints per vertex, everything else is
+// looked up by the shaders from the face and tile:
+//   first:  bits  0-4  x, 0 to 16, in blocks from the chunk's corner
+//           bits  5-13 y, 0 to 256
+//           bits 14-18 z, 0 to 16
+//           bits 19-21 face, a Direction
+//           bits 22-23 corner of the face, 0 to 3
+//           bit  24    set on the faces of flowers and grass. Their xyz is
+//                      the block, which the shaders offset to the corner.
+//   second: bits  0-7  BlockType
+//           bits  8-15 atlas tile, row * 16 + column
+//           bits 16-17 animation: 1 for water, 2 for lava
+// Block faces take their uv from the position, so one texture tile repeats
+// once per block over a greedy quad.
+
 // TODO have Chunk inherit from Drawable
 class Chunk : public Drawable {
 private:
-    // All of the blocks contained within this Chunk
-    std::array<BlockType, 65536> m_blocks;
+    // All of the blocks contained within this Chunk, in sections of 16
+    // blocks from the bottom up
+    std::array<ChunkSection, 16> m_sections;
+    // Held while reading or writing m_sections or m_neighbors, since the
+    // chunks next to a chunk mesh while it is being generated
+    mutable QMutex m_blocksLock;
     // This Chunk's four neighbors to the north, south, east, and west
     // The third input to this map just lets us use a Direction as
     // a key for this map.
     // These allow us to properly determine
     std::unordered_map<Direction, Chunk*, EnumHash> m_neighbors;
+    MeshingMode m_meshingMode;
+    // Whether the player changed blocks since the chunk was generated or
+    // last saved
+    bool m_edited;
+    // Workers queued or running for this chunk, plus meshing neighbors that
+    // are reading its edge
+    mutable std::atomic<int> m_users;
 
-    BlockType getNeighbors(int x, int y, int z, glm::vec4 dir) const;
+    // Copies the blocks of this Chunk into padded, with a one block border
+    // taken from its neighbors, so meshing can look across the edges
+    // without checks. Blocks above and below the chunk, or in missing
+    // neighbors, are EMPTY.
+    void copyPaddedBlocks(std::vector<BlockType>& padded) const;
+    // Without bounds checks or locking
+    BlockType blockAt(int x, int y, int z) const;
+    void generateGreedyOpaData(std::vector<GLuint>& vertexVBOdata, std::vector<GLuint>& idx);
 
 public:
     Chunk(OpenGLContext *context);
     BlockType getLocalBlockAt(unsigned int x, unsigned int y, unsigned int z) const;
     BlockType getLocalBlockAt(int x, int y, int z) const;
     void setLocalBlockAt(unsigned int x, unsigned int y, unsigned int z, BlockType t);
+    // For code that reads or writes many blocks in a row, such as terrain
+    // generation: take the lock once with lockBlocks, use the Unlocked
+    // accessors, which check bounds but leave the lock alone, and call
+    // unlockBlocks when done
+    void lockBlocks() const;
+    void unlockBlocks() const;
+    BlockType getLocalBlockAtUnlocked(unsigned int x, unsigned int y, unsigned int z) const;
+    BlockType getLocalBlockAtUnlocked(int x, int y, int z) const;
+    void setLocalBlockAtUnlocked(unsigned int x, unsigned int y, unsigned int z, BlockType t);
+    // Frees what the sections no longer need after many blocks changed,
+    // such as when the chunk's terrain has been generated
+    void compactBlocks();
     void linkNeighbor(uPtr<Chunk>& neighbor, Direction dir);
+    // Forgets the neighbors, and makes them forget this chunk
+    void unlinkNeighbors();
+    // The blocks as region files store them: the sections from the bottom
+    // up, in the layout of ChunkSection::write
+    void writeBlocks(std::vector<unsigned char>& out) const;
+    // Replaces the blocks with ones written by writeBlocks. Returns false
+    // and leaves the blocks as they were if size bytes are not a chunk.
+    bool readBlocks(const unsigned char* data, size_t size);
+    void setEdited(bool edited);
+    bool isEdited() const;
+    // Workers call acquire when they are queued for the chunk and release
+    // once they are done with it, so Terrain knows when an evicted chunk
+    // can be freed: not before it is unlinked and no longer in use.
+    void acquire() const;
+    void release() const;
+    bool isInUse() const;
+    // Takes effect the next time the VBO data is generated
+    void setMeshingMode(MeshingMode mode);
+    MeshingMode getMeshingMode() const;
 
     virtual void createVBOdata() override;
-    void generateTransData(std::vector<float>& vertexVBOdata, std::vector<GLuint>& idx);
-    void generateOpaData(std::vector<float>& vertexVBOdata, std::vector<GLuint>& idx);
-    void createTransVBOdata(std::vector<float>& vertexVBOdata, std::vector<GLuint>& idx);
-    void createOpaVBOdata(std::vector<float>& vertexVBOdata, std::vector<GLuint>& idx);
+    void generateTransData(std::vector<GLuint>& vertexVBOdata, std::vector<GLuint>& idx);
+    void generateOpaData(std::vector<GLuint>& vertexVBOdata, std::vector<GLuint>& idx);
+    void createTransVBOdata(std::vector<GLuint>& vertexVBOdata, std::vector<GLuint>& idx);
+    void createOpaVBOdata(std::vector<GLuint>& vertexVBOdata, std::vector<GLuint>& idx);
     int getAllNeighbors() const;
     bool checkBlockType(bool drawType, BlockType blockType) const;
     bool checkNeighborBlock(bool drawType, BlockType neighborType) const;
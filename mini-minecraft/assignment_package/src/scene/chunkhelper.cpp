@@ -175,15 +175,34 @@ bool ChunkHelper::isTransparent(BlockType type) {
 
 glm::vec2 ChunkHelper::getAnimated(BlockType type) {
     if (type == WATER) {
-        return glm::vec2(1.f);
+        return glm::vec2(1.f, 0.f);
     } else if (type == LAVA) {
-        return glm::vec2(2.f);
+        return glm::vec2(2.f, 0.f);
     } else {
         return glm::vec2(0.f);
     }
 }
 
 
+// Whether two faces have the same corners and uvs
+static bool sameShape(const Face &a, const Face &b) {
+    for (int i = 0; i < 4; i++) {
+        if (a.vertices[i].pos != b.vertices[i].pos || a.vertices[i].uv != b.vertices[i].uv) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool ChunkHelper::isUnitFace(const Face &face) {
+    return sameShape(face, UnitFaces[face.dir]);
+}
+
+bool ChunkHelper::isCrossFace(const Face &face) {
+    return sameShape(face, CrossFaces[face.dir]);
+}
+
+
 glm::vec4 ChunkHelper::getColor(BlockType type)
 {
     glm::vec4 color = glm::vec4();
@@ -291,6 +310,9 @@ glm::vec2 ChunkHelper::getUV(BlockType type, Direction dir)
 
 
 
+const std::array<Face, 6> ChunkHelper::UnitFaces = ChunkHelper::createFace();
+const std::array<Face, 6> ChunkHelper::CrossFaces = ChunkHelper::createFace_flower_grass();
+
 std::unordered_map<BlockType, std::array<Face, 6>> ChunkHelper::Blocks = {
         {{GRASS,  ChunkHelper::createFace()},
         {DIRT ,  ChunkHelper::createFace()},
@@ -67,6 +67,14 @@ private:
 public:
     static std::unordered_map<BlockType, std::array<Face, 6>> Blocks;
 
+    // The faces of a whole 1 x 1 x 1 block, in Direction order. Block faces
+    // shaped like these can be merged with their neighbors when meshing.
+    static const std::array<Face, 6> UnitFaces;
+
+    // The faces of flowers and grass, which cross in the middle of their
+    // block. Their Y faces have no area.
+    static const std::array<Face, 6> CrossFaces;
+
     static std::unordered_map<BlockType, std::array<Face, 4>> Other_block;
 
     static bool isOpaque(BlockType type);
@@ -79,4 +87,8 @@ public:
 
     static glm::vec2 getAnimated(BlockType type);
 
+    static bool isUnitFace(const Face &face);
+
+    static bool isCrossFace(const Face &face);
+
 };
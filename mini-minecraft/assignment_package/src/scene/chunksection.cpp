@@ -0,0 +1,158 @@
+#include "chunksection.h"
+#include <algorithm>
+
+static const int SECTION_BLOCKS = 16 * 16 * 16;
+
+ChunkSection::ChunkSection(BlockType t) : m_uniform(t), m_shift(-1), m_palette(), m_indices()
+{}
+
+void ChunkSection::setPaletteIndex(int index, int entry) {
+    int perWord = 6 - m_shift;
+    int offset = (index & ((1 << perWord) - 1)) << m_shift;
+    uint64_t mask = ((uint64_t(1) << (1 << m_shift)) - 1) << offset;
+    uint64_t &word = m_indices[index >> perWord];
+    word = (word & ~mask) | (uint64_t(entry) << offset);
+}
+
+void ChunkSection::repack(int shift, const std::vector<int> *remap) {
+    std::vector<uint64_t> indices;
+    indices.swap(m_indices);
+    int oldShift = m_shift;
+
+    m_shift = shift;
+    m_indices.assign(SECTION_BLOCKS >> (6 - shift), 0);
+    for (int i = 0; i < SECTION_BLOCKS; i++) {
+        int perWord = 6 - oldShift;
+        int offset = (i & ((1 << perWord) - 1)) << oldShift;
+        int entry = (indices[i >> perWord] >> offset) & ((1u << (1 << oldShift)) - 1);
+        setPaletteIndex(i, remap != nullptr ? (*remap)[entry] : entry);
+    }
+}
+
+void ChunkSection::setBlock(int index, BlockType t) {
+    if (m_shift < 0) {
+        if (t == m_uniform) {
+            return;
+        }
+        m_palette = {m_uniform, t};
+        m_shift = 0;
+        m_indices.assign(SECTION_BLOCKS / 64, 0);
+        setPaletteIndex(index, 1);
+        return;
+    }
+
+    // Palettes rarely hold more than a handful of types
+    auto found = std::find(m_palette.begin(), m_palette.end(), t);
+    int entry = static_cast<int>(found - m_palette.begin());
+    if (found == m_palette.end()) {
+        if (m_palette.size() == size_t(1) << (1 << m_shift)) {
+            repack(m_shift + 1);
+        }
+        m_palette.push_back(t);
+    }
+    setPaletteIndex(index, entry);
+}
+
+void ChunkSection::compact() {
+    if (m_shift < 0) {
+        return;
+    }
+
+    std::vector<int> uses(m_palette.size(), 0);
+    for (int i = 0; i < SECTION_BLOCKS; i++) {
+        uses[paletteIndex(i)]++;
+    }
+
+    // Where each type moves to in the palette without the unused ones
+    std::vector<int> remap(m_palette.size(), 0);
+    std::vector<BlockType> palette;
+    for (size_t i = 0; i < m_palette.size(); i++) {
+        if (uses[i] > 0) {
+            remap[i] = static_cast<int>(palette.size());
+            palette.push_back(m_palette[i]);
+        }
+    }
+    if (palette.size() == m_palette.size()) {
+        return;
+    }
+
+    if (palette.size() == 1) {
+        m_uniform = palette[0];
+        m_shift = -1;
+        std::vector<BlockType>().swap(m_palette);
+        std::vector<uint64_t>().swap(m_indices);
+        return;
+    }
+
+    int shift = 0;
+    while (palette.size() > size_t(1) << (1 << shift)) {
+        shift++;
+    }
+    repack(shift, &remap);
+    m_palette.swap(palette);
+    m_palette.shrink_to_fit();
+}
+
+size_t ChunkSection::memoryUsage() const {
+    return m_palette.capacity() * sizeof(BlockType) + m_indices.capacity() * sizeof(uint64_t);
+}
+
+void ChunkSection::write(std::vector<unsigned char> &out) const {
+    if (m_shift < 0) {
+        out.push_back(0xFF);
+        out.push_back(m_uniform);
+        return;
+    }
+
+    out.push_back(m_shift);
+    out.push_back(static_cast<unsigned char>(m_palette.size() - 1));
+    out.insert(out.end(), m_palette.begin(), m_palette.end());
+    for (uint64_t word : m_indices) {
+        for (int i = 0; i < 8; i++) {
+            out.push_back(static_cast<unsigned char>(word >> (8 * i)));
+        }
+    }
+}
+
+bool ChunkSection::read(const unsigned char *&data, const unsigned char *end) {
+    if (end - data < 2) {
+        return false;
+    }
+    if (data[0] == 0xFF) {
+        *this = ChunkSection(BlockType(data[1]));
+        data += 2;
+        return true;
+    }
+
+    int shift = data[0];
+    size_t paletteSize = size_t(data[1]) + 1;
+    if (shift > 3 || paletteSize < 2 || paletteSize > size_t(1) << (1 << shift)) {
+        return false;
+    }
+    size_t words = SECTION_BLOCKS >> (6 - shift);
+    if (size_t(end - data) < 2 + paletteSize + 8 * words) {
+        return false;
+    }
+
+    ChunkSection section;
+    section.m_shift = shift;
+    for (size_t i = 0; i < paletteSize; i++) {
+        section.m_palette.push_back(BlockType(data[2 + i]));
+    }
+    section.m_indices.assign(words, 0);
+    const unsigned char *bytes = data + 2 + paletteSize;
+    for (size_t w = 0; w < words; w++) {
+        for (int i = 0; i < 8; i++) {
+            section.m_indices[w] |= uint64_t(bytes[8 * w + i]) << (8 * i);
+        }
+    }
+    for (int i = 0; i < SECTION_BLOCKS; i++) {
+        if (size_t(section.paletteIndex(i)) >= paletteSize) {
+            return false;
+        }
+    }
+
+    *this = std::move(section);
+    data = bytes + 8 * words;
+    return true;
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include "chunkhelper.h"
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+// 16 x 16 x 16 blocks of a Chunk. A section of a single block type, as
+// most of the sky and the deep stone are, stores only that type. Any other
+// section stores a palette of the types it contains, and for each block an
+// index into the palette using as few bits as the palette needs: 1, 2, 4
+// or 8. Blocks are numbered x + 16 * y + 256 * z within the section.
+class ChunkSection {
+private:
+    // The type of every block while m_shift is -1
+    BlockType m_uniform;
+    // log2 of the bits per palette index, or -1 while uniform
+    signed char m_shift;
+    std::vector<BlockType> m_palette;
+    // The palette indices, packed from the low bits of each word up
+    std::vector<uint64_t> m_indices;
+
+    int paletteIndex(int index) const;
+    void setPaletteIndex(int index, int entry);
+    // Repacks the indices with 1 << shift bits each, through remap if given
+    void repack(int shift, const std::vector<int> *remap = nullptr);
+
+public:
+    explicit ChunkSection(BlockType t = EMPTY);
+
+    BlockType getBlock(int index) const;
+    void setBlock(int index, BlockType t);
+
+    // Forgets the types no block uses anymore, which setBlock never does,
+    // shrinking the indices or making the section uniform again
+    void compact();
+
+    bool isUniform() const;
+    // Bytes held on the heap
+    size_t memoryUsage() const;
+
+    // Appends the section to out as region files store it: 0xFF and the
+    // block type if uniform, otherwise the log2 of the index bits, the
+    // palette size minus one, the palette and the indices' 64-bit words,
+    // least significant byte first
+    void write(std::vector<unsigned char> &out) const;
+    // Reads a section written by write, advancing data past it. Returns
+    // false and leaves the section as it was if the bytes are not one.
+    bool read(const unsigned char *&data, const unsigned char *end);
+};
+
+inline int ChunkSection::paletteIndex(int index) const {
+    int perWord = 6 - m_shift;
+    int offset = (index & ((1 << perWord) - 1)) << m_shift;
+    return (m_indices[index >> perWord] >> offset) & ((1u << (1 << m_shift)) - 1);
+}
+
+// Inline since meshing reads every block through it
+inline BlockType ChunkSection::getBlock(int index) const {
+    return m_shift < 0 ? m_uniform : m_palette[paletteIndex(index)];
+}
+
+inline bool ChunkSection::isUniform() const {
+    return m_shift < 0;
+}
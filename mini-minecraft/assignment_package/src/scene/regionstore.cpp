@@ -0,0 +1,81 @@
+#include "regionstore.h"
+#include <QByteArray>
+#include <QDir>
+#include <QFile>
+#include <QtEndian>
+
+// Chunks along each side of a region
+static const int REGION_CHUNKS = 32;
+static const qint64 TABLE_SIZE = REGION_CHUNKS * REGION_CHUNKS * 8;
+
+RegionStore::RegionStore(const QString &directory) : m_directory(directory), m_lock()
+{}
+
+QString RegionStore::regionPath(int x, int z) const {
+    int regionX = static_cast<int>(glm::floor(x / 16.f / REGION_CHUNKS));
+    int regionZ = static_cast<int>(glm::floor(z / 16.f / REGION_CHUNKS));
+    return QDir(m_directory).filePath(QString("r.%1.%2.region").arg(regionX).arg(regionZ));
+}
+
+int RegionStore::tableIndex(int x, int z) {
+    int chunkX = static_cast<int>(glm::floor(x / 16.f));
+    int chunkZ = static_cast<int>(glm::floor(z / 16.f));
+    int localX = chunkX - static_cast<int>(glm::floor(chunkX / float(REGION_CHUNKS))) * REGION_CHUNKS;
+    int localZ = chunkZ - static_cast<int>(glm::floor(chunkZ / float(REGION_CHUNKS))) * REGION_CHUNKS;
+    return localX + REGION_CHUNKS * localZ;
+}
+
+bool RegionStore::load(int x, int z, Chunk &chunk) {
+    QMutexLocker locker(&m_lock);
+    QFile file(regionPath(x, z));
+    if (!file.open(QIODevice::ReadOnly) || !file.seek(tableIndex(x, z) * 8)) {
+        return false;
+    }
+
+    uchar entry[8];
+    if (file.read(reinterpret_cast<char*>(entry), 8) != 8) {
+        return false;
+    }
+    quint32 offset = qFromLittleEndian<quint32>(entry);
+    quint32 size = qFromLittleEndian<quint32>(entry + 4);
+    if (offset < TABLE_SIZE || !file.seek(offset)) {
+        return false;
+    }
+    QByteArray blocks = qUncompress(file.read(size));
+    return !blocks.isEmpty()
+        && chunk.readBlocks(reinterpret_cast<const unsigned char*>(blocks.constData()), blocks.size());
+}
+
+bool RegionStore::save(int x, int z, const Chunk &chunk) {
+    std::vector<unsigned char> blocks;
+    chunk.writeBlocks(blocks);
+    QByteArray record = qCompress(blocks.data(), static_cast<int>(blocks.size()));
+
+    QMutexLocker locker(&m_lock);
+    if (!QDir().mkpath(m_directory)) {
+        return false;
+    }
+    QFile file(regionPath(x, z));
+    if (!file.open(QIODevice::ReadWrite)) {
+        return false;
+    }
+    if (file.size() < TABLE_SIZE && !file.resize(TABLE_SIZE)) {
+        return false;
+    }
+
+    // Overwrite the chunk where it was if it still fits
+    qint64 entryPos = tableIndex(x, z) * 8;
+    uchar entry[8];
+    if (!file.seek(entryPos) || file.read(reinterpret_cast<char*>(entry), 8) != 8) {
+        return false;
+    }
+    qint64 offset = qFromLittleEndian<quint32>(entry);
+    if (offset < TABLE_SIZE || qFromLittleEndian<quint32>(entry + 4) < quint32(record.size())) {
+        offset = file.size();
+    }
+
+    qToLittleEndian<quint32>(quint32(offset), entry);
+    qToLittleEndian<quint32>(quint32(record.size()), entry + 4);
+    return file.seek(offset) && file.write(record) == record.size()
+        && file.seek(entryPos) && file.write(reinterpret_cast<const char*>(entry), 8) == 8;
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include "chunk.h"
+#include <QMutex>
+#include <QString>
+
+// Saves Chunks to disk and loads them back. The chunks of each 32 x 32
+// area of the world share one region file, named after the area's
+// position. A region file starts with a table of 32 x 32 entries, one per
+// chunk row by row along x, each a 32-bit offset into the file and a
+// 32-bit size, least significant byte first. Entries of chunks never saved
+// are zero. The chunks' blocks follow, compressed with qCompress.
+//
+// A chunk that outgrows its place is appended to the file, and the space
+// it leaves is not reused.
+class RegionStore {
+private:
+    QString m_directory;
+    // Saves come from the main thread while chunks load on workers
+    QMutex m_lock;
+
+    // The region file holding the chunk with its corner at (x, z), and
+    // where the chunk's entry is in its table
+    QString regionPath(int x, int z) const;
+    static int tableIndex(int x, int z);
+
+public:
+    // Region files are kept in directory, which is made on the first save
+    explicit RegionStore(const QString &directory);
+
+    // Loads the chunk with its corner at (x, z) into chunk. Returns false,
+    // leaving chunk as it was, if the chunk was never saved or its region
+    // file cannot be read.
+    bool load(int x, int z, Chunk &chunk);
+    // Returns false if the region file could not be written
+    bool save(int x, int z, const Chunk &chunk);
+};
@@ -2,15 +2,28 @@
 #include "cube.h"
 #include <stdexcept>
 #include <iostream>
+#include <algorithm>
+#include <QDir>
 
 #include "blocktypeworker.h"
 #include "vbowork.h"
 
 Terrain::Terrain(OpenGLContext *context)
-    : m_chunks(), m_chunkVBOs(), m_generatedTerrain(), mp_context(context), mp_thd_pool(QThreadPool::globalInstance())
+    : m_chunks(), m_chunkVBOs(), m_generatedTerrain(), m_evictRadius(EVICT_RADIUS),
+      m_regions(QDir::currentPath() + "/world"), m_saveRetries(), m_evictedChunks(),
+      mp_context(context), mp_thd_pool(QThreadPool::globalInstance())
 {}
 
-Terrain::~Terrain() {}
+Terrain::~Terrain() {
+    // Workers hold on to Chunks and to this Terrain
+    mp_thd_pool->waitForDone();
+    for (auto &chunk : m_chunks) {
+        glm::ivec2 pos = toCoords(chunk.first);
+        if (chunk.second->isEdited() && !m_regions.save(pos.x, pos.y, *chunk.second)) {
+            std::cerr << "Could not save the chunk at " << pos.x << " " << pos.y << std::endl;
+        }
+    }
+}
 
 // Combine two 32-bit ints into one 64-bit int
 // where the upper 32 bits are X and the lower 32 bits are Z
@@ -250,7 +263,9 @@ void Terrain::tryExpand(float player_x, float player_z, float pre_x, float pre_z
 
     newChunkLock.lock();
     for (Chunk *chunk : newChunks) {
-        mp_thd_pool->start(new VBOWork(chunk, *this));
+        if (m_evictedChunks.count(chunk) == 0) {
+            mp_thd_pool->start(new VBOWork(chunk, *this));
+        }
     }
     newChunks.clear();
     newChunkLock.unlock();
@@ -258,12 +273,107 @@ void Terrain::tryExpand(float player_x, float player_z, float pre_x, float pre_z
 
     m_VBOLock.lock();
     for(auto& data : m_chunkVBOs) {
+        if (m_evictedChunks.count(data.first) != 0) {
+            continue;
+        }
         data.first->createOpaVBOdata(data.second.opaqueVtxVBOdata, data.second.opaqueIdx);
         data.first->createTransVBOdata(data.second.transparentVtxVBOdata, data.second.transparentIdx);
     }
     m_chunkVBOs.clear();
     m_VBOLock.unlock();
 
+    evictChunks(player_x, player_z, half);
+}
+
+void Terrain::evictChunks(float playerX, float playerZ, int half) {
+    int playerChunkX = static_cast<int>(glm::floor(playerX / 16.f));
+    int playerChunkZ = static_cast<int>(glm::floor(playerZ / 16.f));
+    // A chunk evicted inside the loaded square would never come back
+    int radius = std::max(m_evictRadius, half + 1);
+
+    for (auto &retry : m_saveRetries) {
+        if (retry.second > 0) {
+            --retry.second;
+        }
+    }
+
+    std::vector<int64_t> farChunks;
+    for (auto &chunk : m_chunks) {
+        glm::ivec2 pos = toCoords(chunk.first) / 16;
+        if (std::max(std::abs(pos.x - playerChunkX), std::abs(pos.y - playerChunkZ)) > radius) {
+            farChunks.push_back(chunk.first);
+        }
+    }
+
+    for (int64_t key : farChunks) {
+        uPtr<Chunk> &chunk = m_chunks[key];
+        if (chunk->isEdited()) {
+            auto retry = m_saveRetries.find(key);
+            if (retry != m_saveRetries.end() && retry->second > 0) {
+                continue;
+            }
+            glm::ivec2 pos = toCoords(key);
+            if (!m_regions.save(pos.x, pos.y, *chunk)) {
+                // Keep the player's changes in memory rather than lose them
+                std::cerr << "Could not save the chunk at " << pos.x << " " << pos.y
+                          << ", trying again in " << SAVE_RETRY_TICKS << " ticks" << std::endl;
+                m_saveRetries[key] = SAVE_RETRY_TICKS;
+                continue;
+            }
+            chunk->setEdited(false);
+            m_saveRetries.erase(key);
+        }
+
+        m_chunksLock.lock();
+        chunk->unlinkNeighbors();
+        chunk->destroyVBOdata();
+        Chunk *cPtr = chunk.get();
+        m_evictedChunks[cPtr] = std::move(chunk);
+        m_chunks.erase(key);
+        m_chunksLock.unlock();
+    }
+
+    deleteEvictedChunks();
+}
+
+void Terrain::deleteEvictedChunks() {
+    // Unlinked Chunks cannot be picked up by another worker, so once one is
+    // not in use it stays that way
+    std::vector<Chunk*> unused;
+    for (auto &chunk : m_evictedChunks) {
+        if (!chunk.first->isInUse()) {
+            unused.push_back(chunk.first);
+        }
+    }
+    if (unused.empty()) {
+        return;
+    }
+
+    // Workers hand a Chunk in before they release it
+    newChunkLock.lock();
+    m_VBOLock.lock();
+    for (Chunk *chunk : unused) {
+        newChunks.erase(chunk);
+        m_chunkVBOs.erase(chunk);
+    }
+    m_VBOLock.unlock();
+    newChunkLock.unlock();
+
+    for (Chunk *chunk : unused) {
+        m_evictedChunks.erase(chunk);
+    }
+}
+
+void Terrain::setEvictRadius(int radius) {
+    m_evictRadius = radius;
+}
+
+int Terrain::getEvictRadius() const {
+    return m_evictRadius;
+}
+
+bool Terrain::loadChunk(Chunk *c, glm::ivec2 pos) {
+    return m_regions.load(pos.x, pos.y, *c);
 }
 
 
@@ -338,6 +448,7 @@ void Terrain::blockInteraction(int x, int y, int z, BlockType t) {
     int cx = static_cast<int>(glm::floor(x / 16.f)) * 16;
     int cz = static_cast<int>(glm::floor(z / 16.f)) * 16;
     const uPtr<Chunk> &chunk = getChunkAt(cx, cz);
+    chunk->setEdited(true);
     // ChunkVBOdata data = chunk->generateOpaData();
     ChunkVBOData vbo;
     chunk->generateTransData(vbo.transparentVtxVBOdata, vbo.transparentIdx);
@@ -8,12 +8,19 @@
 #include "shaderprogram.h"
 #include "cube.h"
 #include "procterraingen.h"
+#include "regionstore.h"
 
 #include <QThreadPool>
 #include <QMutex>
 
 #define DRAW_RADIUS 2
 #define GEN_RADIUS 3
+// How many chunks away from the player, along x or z, chunks are kept
+// loaded by default
+#define EVICT_RADIUS 12
+// How many ticks to wait before saving an evicted Chunk again after the
+// region file could not be written
+#define SAVE_RETRY_TICKS 300
 
 
 
@@ -22,9 +29,9 @@
 
 struct ChunkVBOData {
     Chunk* owner;
-    std::vector<float> opaqueVtxVBOdata;
+    std::vector<GLuint> opaqueVtxVBOdata;
     std::vector<GLuint> opaqueIdx;
-    std::vector<float> transparentVtxVBOdata;
+    std::vector<GLuint> transparentVtxVBOdata;
     std::vector<GLuint> transparentIdx;
     ChunkVBOData() : owner(), opaqueVtxVBOdata(), opaqueIdx(), transparentVtxVBOdata(), transparentIdx() {}
 };
@@ -34,9 +41,10 @@ int64_t toKey(int x, int z);
 glm::ivec2 toCoords(int64_t k);
 
 // The container class for all of the Chunks in the game.
-// Ultimately, while Terrain will always store all Chunks,
-// not all Chunks will be drawn at any given time as the world
-// expands.
+// Only the Chunks near the player are kept in memory. Farther
+// ones are freed, after saving them to region files if the
+// player changed them, and are loaded or generated again when
+// the player comes back.
 class Terrain {
 private:
     // Stores every Chunk according to the location of its lower-left corner
@@ -64,9 +72,21 @@ private:
     // world to add more "terrain generation zone" IDs to this set.
     // While only the 3 x 3 collection of terrain generation zones
     // surrounding the Player should be rendered, the Chunks
-    // in the Terrain will never be deleted until the program is terminated.
+    // in the Terrain are kept until the player moves away from them.
     std::unordered_set<int64_t> m_generatedTerrain;
 
+    // Chunks farther than this from the player, in chunks along x or z,
+    // are evicted
+    int m_evictRadius;
+    // Where edited Chunks go when they are evicted
+    RegionStore m_regions;
+    // Edited Chunks that could not be saved, by key, and the ticks left
+    // before trying again. They stay loaded until then.
+    std::unordered_map<int64_t, int> m_saveRetries;
+    // Evicted Chunks that workers may still be generating, meshing, or
+    // reading as neighbors. Each is deleted once it is no longer in use.
+    std::unordered_map<Chunk*, uPtr<Chunk>> m_evictedChunks;
+
     // TODO: DELETE ALL REFERENCES TO m_geomCube AS YOU WILL NOT USE
     // IT IN YOUR FINAL PROGRAM!
     // The instance of a unit cube we can use to render any cube.
@@ -86,6 +106,14 @@ private:
     OpenGLContext* mp_context;
     QThreadPool* mp_thd_pool;
 
+    // Saves the edited Chunks out of reach of the player at (playerX,
+    // playerZ), frees them and their VBOs. Chunks are only created as they
+    // enter the square of half chunks around the player, so nothing within
+    // half + 1 chunks is evicted whatever the radius.
+    void evictChunks(float playerX, float playerZ, int half);
+    // Deletes the evicted Chunks no worker is using any more
+    void deleteEvictedChunks();
+
 
 public:
     Terrain(OpenGLContext *context);
@@ -134,6 +162,14 @@ public:
 
     void blockInteraction(int x, int y, int z, BlockType t);
 
+    // At least one chunk more than tryExpand's half is kept regardless
+    void setEvictRadius(int radius);
+    int getEvictRadius() const;
+
+    // Loads the Chunk with its corner at pos from the region files, which
+    // it is in if the player edited it. Returns false if it is not.
+    bool loadChunk(Chunk* c, glm::ivec2 pos);
+
     //access thread
     void spawmBlockWorker(Chunk* c, int x, int z);
 
@@ -272,41 +272,10 @@ void ShaderProgram::drawInterleaved(Drawable &d)
         throw std::out_of_range("Attempting to draw a drawable with INDEX of " + std::to_string(d.elemCount(INDEX)) + "!");
     }
 
-    int size = 3 * sizeof(glm::vec4) + 2 * sizeof(glm::vec2) + 2 * sizeof(glm::vec3);
-
-    if (m_attribs["vs_Pos"] != -1 && d.bindBuffer(POSITION)) {
-        context->glEnableVertexAttribArray(m_attribs["vs_Pos"]);
-        context->glVertexAttribPointer(m_attribs["vs_Pos"], 4, GL_FLOAT, false, size, (void*)0);
-    }
-
-    if (m_attribs["vs_Nor"] != -1 && d.bindBuffer(NORMAL)) {
-        context->glEnableVertexAttribArray(m_attribs["vs_Nor"]);
-        context->glVertexAttribPointer(m_attribs["vs_Nor"], 4, GL_FLOAT, false, size, (void*)sizeof(glm::vec4));
-    }
-
-    if (m_attribs["vs_Col"] != -1 && d.bindBuffer(COLOR)) {
-        context->glEnableVertexAttribArray(m_attribs["vs_Col"]);
-        context->glVertexAttribPointer(m_attribs["vs_Col"], 4, GL_FLOAT, false, size, (void*)(2 * sizeof(glm::vec4)));
-    }
-
-    if (m_attribs["vs_UV"]  != -1 && d.bindBuffer(UV))  {
-        context->glEnableVertexAttribArray(m_attribs["vs_UV"]);
-        context->glVertexAttribPointer(m_attribs["vs_UV"], 2, GL_FLOAT, false, size, (void*)(3 * sizeof(glm::vec4)));
-    }
-
-    if (m_attribs["vs_Animated"]  != -1 && d.bindBuffer(ANIMATED))  {
-        context->glEnableVertexAttribArray(m_attribs["vs_Animated"]);
-        context->glVertexAttribPointer(m_attribs["vs_Animated"], 2, GL_FLOAT, false, size, (void*)(3 * sizeof(glm::vec4)+ sizeof(glm::vec2)));
-    }
-
-    if (m_attribs["vs_Tangent"]  != -1 && d.bindBuffer(TANGENT))  {
-        context->glEnableVertexAttribArray(m_attribs["vs_Tangent"]);
-        context->glVertexAttribPointer(m_attribs["vs_Tangent"], 3, GL_FLOAT, false, size, (void*)(3 * sizeof(glm::vec4)+ 2 * sizeof(glm::vec2)));
-    }
-
-    if (m_attribs["vs_Bitangent"]  != -1 && d.bindBuffer(BITANGENT))  {
-        context->glEnableVertexAttribArray(m_attribs["vs_Bitangent"]);
-        context->glVertexAttribPointer(m_attribs["vs_Bitangent"], 3, GL_FLOAT, false, size, (void*)(3 * sizeof(glm::vec4)+ 2 * sizeof(glm::vec2)+ sizeof(glm::vec3)));
+    // Chunk vertices are two packed GLuints each, see chunk.h
+    if (m_attribs["vs_Packed"] != -1 && d.bindBuffer(POSITION)) {
+        context->glEnableVertexAttribArray(m_attribs["vs_Packed"]);
+        context->glVertexAttribIPointer(m_attribs["vs_Packed"], 2, GL_UNSIGNED_INT, 2 * sizeof(GLuint), (void*)0);
     }
 
     // Bind the index buffer and then draw shapes from it.
@@ -314,13 +283,7 @@ void ShaderProgram::drawInterleaved(Drawable &d)
     d.bindBuffer(INDEX);
     context->glDrawElements(d.drawMode(), d.elemCount(INDEX), GL_UNSIGNED_INT, 0);
 
-    if (m_attribs["vs_Pos"] != -1) context->glDisableVertexAttribArray(m_attribs["vs_Pos"]);
-    if (m_attribs["vs_Nor"] != -1) context->glDisableVertexAttribArray(m_attribs["vs_Nor"]);
-    if (m_attribs["vs_Col"] != -1) context->glDisableVertexAttribArray(m_attribs["vs_Col"]);
-    if (m_attribs["vs_UV"] != -1) context->glDisableVertexAttribArray(m_attribs["vs_UV"]);
-    if (m_attribs["vs_Animated"] != -1) context->glDisableVertexAttribArray(m_attribs["vs_Animated"]);
-    if (m_attribs["vs_Tangent"] != -1) context->glDisableVertexAttribArray(m_attribs["vs_Tangent"]);
-    if (m_attribs["vs_Bitangent"] != -1) context->glDisableVertexAttribArray(m_attribs["vs_Bitangent"]);
+    if (m_attribs["vs_Packed"] != -1) context->glDisableVertexAttribArray(m_attribs["vs_Packed"]);
 
     context->printGLErrorLog();
 }
@@ -333,41 +296,10 @@ void ShaderProgram::drawTrans(Drawable &d)
         throw std::out_of_range("Attempting to draw a drawable with INDEX of " + std::to_string(d.elemCount(INDEX_TRAN)) + "!");
     }
 
-    int size = 3 * sizeof(glm::vec4) + 2 * sizeof(glm::vec2) + 2 * sizeof(glm::vec3);
-
-    if (m_attribs["vs_Pos"] != -1 && d.bindBuffer(POSITION2)) {
-        context->glEnableVertexAttribArray(m_attribs["vs_Pos"]);
-        context->glVertexAttribPointer(m_attribs["vs_Pos"], 4, GL_FLOAT, false, size, (void*)0);
-    }
-
-    if (m_attribs["vs_Nor"] != -1 && d.bindBuffer(NORMAL2)) {
-        context->glEnableVertexAttribArray(m_attribs["vs_Nor"]);
-        context->glVertexAttribPointer(m_attribs["vs_Nor"], 4, GL_FLOAT, false, size, (void*)sizeof(glm::vec4));
-    }
-
-    if (m_attribs["vs_Col"] != -1 && d.bindBuffer(COLOR2)) {
-        context->glEnableVertexAttribArray(m_attribs["vs_Col"]);
-        context->glVertexAttribPointer(m_attribs["vs_Col"], 4, GL_FLOAT, false, size, (void*)(2 * sizeof(glm::vec4)));
-    }
-
-    if (m_attribs["vs_UV"]  != -1 && d.bindBuffer(UV2))  {
-        context->glEnableVertexAttribArray(m_attribs["vs_UV"]);
-        context->glVertexAttribPointer(m_attribs["vs_UV"], 2, GL_FLOAT, false, size, (void*)(3 * sizeof(glm::vec4)));
-    }
-
-    if (m_attribs["vs_Animated"]  != -1 && d.bindBuffer(ANIMATED2))  {
-        context->glEnableVertexAttribArray(m_attribs["vs_Animated"]);
-        context->glVertexAttribPointer(m_attribs["vs_Animated"], 2, GL_FLOAT, false, size, (void*)(3 * sizeof(glm::vec4)+ sizeof(glm::vec2)));
-    }
-
-    if (m_attribs["vs_Tangent"]  != -1 && d.bindBuffer(TANGENT2))  {
-        context->glEnableVertexAttribArray(m_attribs["vs_Tangent"]);
-        context->glVertexAttribPointer(m_attribs["vs_Tangent"], 3, GL_FLOAT, false, size, (void*)(3 * sizeof(glm::vec4)+ 2 * sizeof(glm::vec2)));
-    }
-
-    if (m_attribs["vs_Bitangent"]  != -1 && d.bindBuffer(BITANGENT2))  {
-        context->glEnableVertexAttribArray(m_attribs["vs_Bitangent"]);
-        context->glVertexAttribPointer(m_attribs["vs_Bitangent"], 3, GL_FLOAT, false, size, (void*)(3 * sizeof(glm::vec4)+ 2 * sizeof(glm::vec2)+ sizeof(glm::vec3)));
+    // Chunk vertices are two packed GLuints each, see chunk.h
+    if (m_attribs["vs_Packed"] != -1 && d.bindBuffer(POSITION2)) {
+        context->glEnableVertexAttribArray(m_attribs["vs_Packed"]);
+        context->glVertexAttribIPointer(m_attribs["vs_Packed"], 2, GL_UNSIGNED_INT, 2 * sizeof(GLuint), (void*)0);
     }
 
     // Bind the index buffer and then draw shapes from it.
@@ -375,14 +307,7 @@ void ShaderProgram::drawTrans(Drawable &d)
     d.bindBuffer(INDEX_TRAN);
     context->glDrawElements(d.drawMode(), d.elemCount(INDEX_TRAN), GL_UNSIGNED_INT, 0);
 
-    if (m_attribs["vs_Pos"] != -1) context->glDisableVertexAttribArray(m_attribs["vs_Pos"]);
-    if (m_attribs["vs_Nor"] != -1) context->glDisableVertexAttribArray(m_attribs["vs_Nor"]);
-    if (m_attribs["vs_Col"] != -1) context->glDisableVertexAttribArray(m_attribs["vs_Col"]);
-    if (m_attribs["vs_UV"] != -1) context->glDisableVertexAttribArray(m_attribs["vs_UV"]);
-    if (m_attribs["vs_Animated"] != -1) context->glDisableVertexAttribArray(m_attribs["vs_Animated"]);
-    if (m_attribs["vs_Tangent"] != -1) context->glDisableVertexAttribArray(m_attribs["vs_Tangent"]);
-    if (m_attribs["vs_Bitangent"] != -1) context->glDisableVertexAttribArray(m_attribs["vs_Bitangent"]);
-
+    if (m_attribs["vs_Packed"] != -1) context->glDisableVertexAttribArray(m_attribs["vs_Packed"]);
 
     context->printGLErrorLog();
 }
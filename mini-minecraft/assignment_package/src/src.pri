@@ -22,6 +22,8 @@ SOURCES += \
     $$PWD/scene/camera.cpp \
     $$PWD/playerinfo.cpp \
     $$PWD/scene/chunk.cpp \
+    $$PWD/scene/chunksection.cpp \
+    $$PWD/scene/regionstore.cpp \
     $$PWD/texture.cpp \
     $$PWD/utils.cpp \
     $$PWD/vbowork.cpp
@@ -47,6 +49,8 @@ HEADERS += \
     $$PWD/scene/camera.h \
     $$PWD/playerinfo.h \
     $$PWD/scene/chunk.h \
+    $$PWD/scene/chunksection.h \
+    $$PWD/scene/regionstore.h \
     $$PWD/stb_image.h \
     $$PWD/stb_image_write.h \
     $$PWD/texture.h \
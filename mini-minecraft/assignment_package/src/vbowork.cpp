@@ -2,6 +2,7 @@
 
 VBOWork::VBOWork(Chunk* c, Terrain& t) : c(c), t(t), vbo() {
     vbo.owner = c;
+    c->acquire();
 }
 
 void VBOWork::run() {
@@ -9,5 +10,6 @@ void VBOWork::run() {
     c->generateOpaData(vbo.opaqueVtxVBOdata, vbo.opaqueIdx);
     c->generateTransData(vbo.transparentVtxVBOdata, vbo.transparentIdx);
     t.insertVBO(c, vbo);
+    c->release();
 }
 